@@ -0,0 +1,27 @@
+#include "Allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<long long> allocationCount(0);
+std::atomic<long long> allocationBytes(0);
+
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocationBytes.fetch_add((long long)size, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,12 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <atomic>
+
+// Every operator new in the benchmark binary counts itself here. The replacement
+// operators live in Allocations.cpp, away from the code that allocates, so the
+// compiler doesn't pair inlined news with the replaced deletes.
+extern std::atomic<long long> allocationCount;
+extern std::atomic<long long> allocationBytes;
+
+#endif
@@ -0,0 +1,630 @@
+// Microbenchmarks for the mesh generators, the colour helpers and the GL upload
+// paths, on Google Benchmark. Built by the CMakeLists.txt at the top of the repo:
+//
+//   cmake -S . -B build -DGLAD_DIR=/path/to/glad && cmake --build build
+//   build/sierpinski_bench [--benchmark_filter=Generate]
+//
+// Results are also written to sierpinski_bench.json (--benchmark_out=... to change
+// it), which keeps the machine and library details next to every number so runs of
+// two releases can be compared with benchmark's tools/compare.py. Every benchmark
+// reports allocs and alloc_bytes per iteration; the mesh ones add triangles/s and
+// bytes/s of vertex data. Generate and Upload also report IPC and cycles, LLC and
+// dTLB misses and page faults per triangle from the hardware counters, those the
+// machine lets us open (perf_event_paranoid 2 is enough). GL benchmarks run on the
+// headless EGL context and are skipped when there is none.
+
+#include <glad/glad.h>
+#include <benchmark/benchmark.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Allocations.h"
+#include "AnalyticRaster.h"
+#include "GLExt.h"
+#include "Headless.h"
+#include "MeshStream.h"
+#include "PerfCounters.h"
+#include "Renderer.h"
+#include "ShaderLibrary.h"
+#include "Sierpinski.h"
+#include "Simd.h"
+#include "SoftRaster.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// Allocations between construction and report(), per iteration
+class AllocationCounter
+{
+public:
+	AllocationCounter() : count(allocationCount.load()), bytes(allocationBytes.load()) {}
+
+	void report(benchmark::State &state) {
+		state.counters["allocs"] = benchmark::Counter((double)(allocationCount.load() - count), benchmark::Counter::kAvgIterations);
+		state.counters["alloc_bytes"] = benchmark::Counter((double)(allocationBytes.load() - bytes), benchmark::Counter::kAvgIterations);
+	}
+
+private:
+	long long count, bytes;
+};
+
+// Hardware counters between construction and report(), per triangle per iteration
+class CounterReport
+{
+public:
+	CounterReport() : scope(new PerfScope(&counters, total)) {}
+	~CounterReport() { delete scope; }
+
+	void report(benchmark::State &state, long long triangles) {
+		delete scope;
+		scope = NULL;
+		double items = (double)triangles * state.iterations();
+		if (total.valid[PERF_CYCLES] && total.valid[PERF_INSTRUCTIONS])
+			state.counters["IPC"] = total.ipc();
+		for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+			if (e != PERF_INSTRUCTIONS && total.valid[e])
+				state.counters[std::string(PerfCounters::name((PerfEvent)e)) + "/tri"] = total.per((PerfEvent)e, items);
+		}
+	}
+
+private:
+	PerfCounters counters;
+	PerfSample total;
+	PerfScope* scope;
+};
+
+// Original Points For Triangle
+static const glm::vec2 pA(0.0f, 0.5f), pB(0.5f, -0.5f), pC(-0.5f, -0.5f);
+static const int SCREEN_WIDTH = 800, SCREEN_HEIGHT = 600;
+// Meshes past this are skipped instead of pushing the machine into swap. drawTris
+// passes it at depth 15, instances at 17.
+static const double MAX_MESH_BYTES = 1024.0 * 1024.0 * 1024.0;
+
+// The CPU-generated vertex formats of ShaderVariant
+enum MeshFormat { MESH_POS_COLOR, MESH_POS2, MESH_INSTANCED };
+static const int FLOATS_PER_TRIANGLE[] = { 18, 6, 3 };
+
+static void generate(MeshFormat format, int depth, std::vector<float> &vertices)
+{
+	switch (format) {
+		case MESH_POS_COLOR: drawTris(pA, pB, pC, depth, vertices);
+			break;
+		case MESH_POS2: drawTrisPos2(pA, pB, pC, depth, vertices);
+			break;
+		case MESH_INSTANCED: drawTriInstances(pA, pB, pC, depth, glm::vec2(0.0f, 0.0f), 1.0f, vertices);
+			break;
+	}
+}
+
+static size_t meshBytes(MeshFormat format, int depth)
+{
+	return (size_t)triangleCount(depth) * FLOATS_PER_TRIANGLE[format] * sizeof(float);
+}
+
+static bool fits(benchmark::State &state, MeshFormat format, int depth)
+{
+	if ((double)meshBytes(format, depth) <= MAX_MESH_BYTES)
+		return true;
+	state.SkipWithError("mesh over 1 GiB");
+	return false;
+}
+
+static void setThroughput(benchmark::State &state, long long triangles, size_t bytes)
+{
+	state.counters["triangles/s"] = benchmark::Counter((double)triangles * state.iterations(), benchmark::Counter::kIsRate);
+	state.SetBytesProcessed((int64_t)bytes * state.iterations());
+}
+
+static ThreadPool &pool()
+{
+	static ThreadPool threads;
+	return threads;
+}
+
+// GENERATION //
+
+// A fresh mesh per iteration, like Renderer::generate() (reserve) or growing as it goes
+static void BM_Generate(benchmark::State &state, MeshFormat format, bool reserve)
+{
+	int depth = (int)state.range(0);
+	if (!fits(state, format, depth))
+		return;
+	AllocationCounter allocations;
+	CounterReport counters;
+	for (auto _ : state) {
+		std::vector<float> vertices;
+		if (reserve)
+			vertices.reserve(meshBytes(format, depth) / sizeof(float));
+		generate(format, depth, vertices);
+		benchmark::DoNotOptimize(vertices.data());
+	}
+	allocations.report(state);
+	counters.report(state, triangleCount(depth));
+	setThroughput(state, triangleCount(depth), meshBytes(format, depth));
+}
+BENCHMARK_CAPTURE(BM_Generate, pos_color, MESH_POS_COLOR, true)->DenseRange(1, 16)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Generate, pos_color_grow, MESH_POS_COLOR, false)->DenseRange(1, 16)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Generate, pos2, MESH_POS2, true)->DenseRange(1, 16)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Generate, instanced, MESH_INSTANCED, true)->DenseRange(1, 16)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+
+// The analytic engine generates nothing; a full frame of coverage stands in for the
+// mesh, and triangles/s counts the triangles that frame shows
+static void BM_GenerateAnalytic(benchmark::State &state)
+{
+	int depth = (int)state.range(0);
+	AnalyticRaster raster(SCREEN_WIDTH, SCREEN_HEIGHT, pool());
+	raster.setView(pA, pB, pC, depth, glm::mat4(1.0f));
+	std::vector<uint64_t> mask;
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		raster.drawMask(mask);
+		benchmark::DoNotOptimize(mask.data());
+	}
+	allocations.report(state);
+	setThroughput(state, triangleCount(depth), mask.size() * sizeof(uint64_t));
+}
+BENCHMARK(BM_GenerateAnalytic)->DenseRange(1, 16)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+
+// Full RGBA frames at a few widths. Spans of a width on a 64-pixel boundary end on a
+// coverage word edge, which is where an AVX2 group straddling two words must not
+// write past the row; build with -fsanitize=address to check that.
+static void BM_AnalyticDraw(benchmark::State &state)
+{
+	int width = (int)state.range(0);
+	AnalyticRaster raster(width, SCREEN_HEIGHT, pool());
+	// Zoomed in and moved right, so spans start all along the left edge and run
+	// to the end of the row
+	glm::mat4 zoom(1.0f);
+	zoom[0][0] = zoom[1][1] = 4.0f;
+	zoom[3][0] = 1.5f;
+	raster.setView(pA, pB, pC, 10, zoom);
+	Image image;
+	std::vector<uint64_t> mask;
+	for (auto _ : state) {
+		raster.draw(ColorVec3(1.0f, 1.0f, 1.0f), ColorVec3(0.0f, 0.0f, 0.0f), image);
+		raster.drawMask(mask);
+		benchmark::DoNotOptimize(image.rgba.data());
+		benchmark::DoNotOptimize(mask.data());
+	}
+}
+BENCHMARK(BM_AnalyticDraw)->Arg(64)->Arg(128)->Arg(SCREEN_WIDTH)->ArgName("width")->Unit(benchmark::kMicrosecond);
+
+// SoftRaster drawing an already generated drawTris() mesh
+static void BM_GenerateSoftRaster(benchmark::State &state)
+{
+	int depth = (int)state.range(0);
+	if (!fits(state, MESH_POS_COLOR, depth))
+		return;
+	std::vector<float> vertices;
+	drawTris(pA, pB, pC, depth, vertices);
+	SoftRaster raster(SCREEN_WIDTH, SCREEN_HEIGHT, pool());
+	std::vector<uint64_t> mask;
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		raster.setTriangles(&vertices[0], vertices.size() / 6, 6, glm::mat4(1.0f));
+		raster.drawMask(mask);
+		benchmark::DoNotOptimize(mask.data());
+	}
+	allocations.report(state);
+	setThroughput(state, triangleCount(depth), meshBytes(MESH_POS_COLOR, depth));
+}
+BENCHMARK(BM_GenerateSoftRaster)->DenseRange(1, 16)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+
+// VERTEX EMISSION //
+
+// Emission alone: one depth 7 mesh (3280 triangles) into a vector that keeps its
+// capacity, so no allocation should show up
+static void BM_Emit(benchmark::State &state, MeshFormat format)
+{
+	const int depth = 7;
+	std::vector<float> vertices;
+	vertices.reserve(meshBytes(format, depth) / sizeof(float));
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		vertices.clear();
+		generate(format, depth, vertices);
+		benchmark::DoNotOptimize(vertices.data());
+	}
+	allocations.report(state);
+	setThroughput(state, triangleCount(depth), meshBytes(format, depth));
+}
+BENCHMARK_CAPTURE(BM_Emit, pos_color, MESH_POS_COLOR);
+BENCHMARK_CAPTURE(BM_Emit, pos2, MESH_POS2);
+BENCHMARK_CAPTURE(BM_Emit, instanced, MESH_INSTANCED);
+
+// drawTri on its own, the leaf of drawTris
+static void BM_DrawTri(benchmark::State &state)
+{
+	std::vector<float> vertices;
+	vertices.reserve(1024 * 18);
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		vertices.clear();
+		for (int i = 0; i < 1024; i++)
+			drawTri(pA, pB, glm::vec2(pC.x, pC.y + i * 1e-4f), vertices);
+		benchmark::DoNotOptimize(vertices.data());
+	}
+	allocations.report(state);
+	setThroughput(state, 1024, 1024 * 18 * sizeof(float));
+}
+BENCHMARK(BM_DrawTri);
+
+// HELPERS //
+
+static void BM_Mid(benchmark::State &state)
+{
+	std::vector<glm::vec2> points(1024);
+	for (size_t i = 0; i < points.size(); i++)
+		points[i] = glm::vec2((float)i / points.size(), 1.0f - (float)i / points.size());
+	for (auto _ : state) {
+		glm::vec2 sum(0.0f, 0.0f);
+		for (size_t i = 0; i + 1 < points.size(); i++)
+			sum = sum + mid(points[i], points[i + 1]);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * (int64_t)(points.size() - 1));
+}
+BENCHMARK(BM_Mid);
+
+// Every whole degree, as ANIM_CPU sweeps through them
+static void BM_HSVColor(benchmark::State &state)
+{
+	for (auto _ : state) {
+		float sum = 0.0f;
+		for (int h = 0; h < 360; h++) {
+			ColorVec3 color = getHSVColor((float)h, 1.0f, 1.0f);
+			sum += color.r + color.g + color.b;
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * 360);
+}
+BENCHMARK(BM_HSVColor);
+
+static void BM_PackRGBA(benchmark::State &state)
+{
+	for (auto _ : state) {
+		uint32_t bits = 0;
+		for (int h = 0; h < 360; h++)
+			bits ^= packRGBA(ColorVec3(h / 360.0f, 0.5f, 1.0f - h / 360.0f));
+		benchmark::DoNotOptimize(bits);
+	}
+	state.SetItemsProcessed(state.iterations() * 360);
+}
+BENCHMARK(BM_PackRGBA);
+
+// GL UPLOADS AND UNIFORMS //
+
+static HeadlessContext* glContext = NULL;
+
+static bool hasGL(benchmark::State &state)
+{
+	if (glContext && glContext->ok)
+		return true;
+	state.SkipWithError("no GL context");
+	return false;
+}
+
+// BUFFER_DATA reallocates the storage every upload like Renderer::generate(),
+// SUB_DATA writes into storage of the right size, ORPHAN drops the old storage first
+// so the driver needn't wait for draws still reading it
+enum UploadPath { UPLOAD_BUFFER_DATA, UPLOAD_SUB_DATA, UPLOAD_ORPHAN };
+
+static void BM_Upload(benchmark::State &state, MeshFormat format, UploadPath path)
+{
+	int depth = (int)state.range(0);
+	if (!hasGL(state) || !fits(state, format, depth))
+		return;
+	std::vector<float> vertices;
+	generate(format, depth, vertices);
+	GLsizeiptr bytes = (GLsizeiptr)(vertices.size() * sizeof(float));
+	unsigned int VBO;
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+	AllocationCounter allocations;
+	CounterReport counters;
+	for (auto _ : state) {
+		switch (path) {
+			case UPLOAD_BUFFER_DATA: glBufferData(GL_ARRAY_BUFFER, bytes, &vertices[0], GL_STATIC_DRAW);
+				break;
+			case UPLOAD_SUB_DATA: glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &vertices[0]);
+				break;
+			case UPLOAD_ORPHAN: glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &vertices[0]);
+				break;
+		}
+		// Counts the copy, not just queueing it
+		glFinish();
+	}
+	allocations.report(state);
+	counters.report(state, triangleCount(depth));
+	setThroughput(state, triangleCount(depth), (size_t)bytes);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDeleteBuffers(1, &VBO);
+}
+BENCHMARK_CAPTURE(BM_Upload, pos_color_buffer_data, MESH_POS_COLOR, UPLOAD_BUFFER_DATA)->DenseRange(1, 13)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Upload, pos_color_sub_data, MESH_POS_COLOR, UPLOAD_SUB_DATA)->DenseRange(1, 13)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Upload, pos_color_orphan, MESH_POS_COLOR, UPLOAD_ORPHAN)->DenseRange(1, 13)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Upload, pos2_buffer_data, MESH_POS2, UPLOAD_BUFFER_DATA)->DenseRange(1, 13)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Upload, instanced_buffer_data, MESH_INSTANCED, UPLOAD_BUFFER_DATA)->DenseRange(1, 13)->ArgName("depth")->Unit(benchmark::kMicrosecond);
+
+// One animated frame of a depth 8-14 mesh from memory to pixels: SoftRaster with
+// the pool's threads against the GL context (llvmpipe on a machine without a GPU),
+// both from the position-only stream like --soft and --headless
+static void BM_Frame(benchmark::State &state, bool soft)
+{
+	int depth = (int)state.range(0);
+	if ((!soft && !hasGL(state)) || !fits(state, MESH_POS2, depth))
+		return;
+	float time = 0.0f;
+	if (soft) {
+		std::vector<float> vertices;
+		drawTrisPos2(pA, pB, pC, depth, vertices);
+		SoftRaster raster(SCREEN_WIDTH, SCREEN_HEIGHT, pool());
+		Image image(SCREEN_WIDTH, SCREEN_HEIGHT);
+		for (auto _ : state) {
+			time += 1.0f / 60.0f;
+			glm::mat4 trans = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0, 1.0, 0.0));
+			raster.setTriangles(&vertices[0], vertices.size() / 2, 2, trans);
+			raster.draw(getHSVColor(360.0f * ((sin(time) / 2.0f) + 0.5f), 1.0f, 1.0f), ColorVec3(0.2f, 0.3f, 0.3f), image);
+			benchmark::DoNotOptimize(image.rgba.data());
+		}
+	}
+	else {
+		ShaderLibrary shaders;
+		Renderer renderer(shaders, SHADER_STREAM_POS2 | SHADER_COLOR_UNIFORM, depth);
+		renderer.bind();
+		for (auto _ : state) {
+			time += 1.0f / 60.0f;
+			renderer.drawFrame(time);
+			glFinish();
+		}
+	}
+	setThroughput(state, triangleCount(depth), meshBytes(MESH_POS2, depth));
+}
+BENCHMARK_CAPTURE(BM_Frame, soft_raster, true)->DenseRange(8, 14)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Frame, gl, false)->DenseRange(8, 14)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Time until the whole mesh is on the GPU: Renderer::generate() builds it and then
+// uploads it in one glBufferData, MeshStream uploads chunks while generator threads
+// are still building the rest. Wall time, the generators' CPU time isn't this thread's.
+static void BM_MeshToGPU(benchmark::State &state, unsigned int stream, bool streamed)
+{
+	int depth = (int)state.range(0);
+	if (!hasGL(state))
+		return;
+	ShaderLibrary shaders;
+	RendererMesh empty = RendererMesh();
+	Renderer renderer(shaders, stream | SHADER_COLOR_UNIFORM, depth, false, NULL, &empty);
+	for (auto _ : state) {
+		if (streamed) {
+			MeshStream meshStream(renderer);
+			meshStream.finish();
+		}
+		else {
+			renderer.generate();
+		}
+		glFinish();
+	}
+	setThroughput(state, triangleCount(depth), renderer.bufferBytes);
+}
+BENCHMARK_CAPTURE(BM_MeshToGPU, pos_color, SHADER_STREAM_POS_COLOR, false)->DenseRange(8, 13)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_MeshToGPU, pos_color_streamed, SHADER_STREAM_POS_COLOR, true)->DenseRange(8, 13)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_MeshToGPU, instanced, SHADER_STREAM_INSTANCED, false)->DenseRange(8, 13)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_MeshToGPU, instanced_streamed, SHADER_STREAM_INSTANCED, true)->DenseRange(8, 13)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// MeshStream as the app drives it: one poll() with budgetMs a frame and the rest of
+// 1/60 s slept away as vsync would. The frame itself isn't drawn, on llvmpipe it would
+// take the cores the generators run on. frames counts the frames it took.
+static void BM_MeshToGPUPaced(benchmark::State &state, unsigned int stream, int budgetMs)
+{
+	int depth = (int)state.range(0);
+	if (!hasGL(state))
+		return;
+	ShaderLibrary shaders;
+	RendererMesh empty = RendererMesh();
+	Renderer renderer(shaders, stream | SHADER_COLOR_UNIFORM, depth, false, NULL, &empty);
+	int frames = 0;
+	for (auto _ : state) {
+		MeshStream meshStream(renderer);
+		bool done = false;
+		while (!done) {
+			std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+			done = meshStream.poll(budgetMs);
+			frames++;
+			std::this_thread::sleep_until(frameStart + std::chrono::microseconds(16667));
+		}
+	}
+	state.counters["frames"] = benchmark::Counter((double)frames, benchmark::Counter::kAvgIterations);
+	setThroughput(state, triangleCount(depth), renderer.bufferBytes);
+}
+BENCHMARK_CAPTURE(BM_MeshToGPUPaced, pos_color_one_pass, SHADER_STREAM_POS_COLOR, 0)->DenseRange(10, 13)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_MeshToGPUPaced, pos_color_budget, SHADER_STREAM_POS_COLOR, MeshStream::FRAME_BUDGET_MS)->DenseRange(10, 13)->ArgName("depth")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// RENDERER sets the ANIM_CPU uniforms (transform and colorOver) through hashed
+// handles with a new time every frame, RENDERER_UNCHANGED with the same time so the
+// value cache skips the GL calls, BY_NAME looks every location up by string first
+enum UniformPath { UNIFORMS_RENDERER, UNIFORMS_RENDERER_UNCHANGED, UNIFORMS_BY_NAME };
+
+static void BM_Uniforms(benchmark::State &state, UniformPath path)
+{
+	if (!hasGL(state))
+		return;
+	ShaderLibrary shaders;
+	Renderer renderer(shaders, SHADER_STREAM_POS_COLOR | SHADER_COLOR_UNIFORM, 1);
+	renderer.bind();
+	unsigned int program = renderer.shader.ID;
+	float time = 0.0f;
+	AllocationCounter allocations;
+	for (auto _ : state) {
+		if (path != UNIFORMS_RENDERER_UNCHANGED)
+			time += 1.0f / 60.0f;
+		if (path == UNIFORMS_BY_NAME) {
+			glm::mat4 trans = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0, 1.0, 0.0));
+			ColorVec3 color = getHSVColor(360.0f * ((sin(time) / 2.0f) + 0.5f), 1.0f, 1.0f);
+			glUniformMatrix4fv(glGetUniformLocation(program, "transform"), 1, GL_FALSE, &trans[0][0]);
+			glUniform3f(glGetUniformLocation(program, "colorOver"), color.r, color.g, color.b);
+		}
+		else {
+			renderer.setUniforms(time);
+		}
+	}
+	glFinish();
+	allocations.report(state);
+	state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK_CAPTURE(BM_Uniforms, renderer, UNIFORMS_RENDERER);
+BENCHMARK_CAPTURE(BM_Uniforms, renderer_unchanged, UNIFORMS_RENDERER_UNCHANGED);
+BENCHMARK_CAPTURE(BM_Uniforms, by_name, UNIFORMS_BY_NAME);
+
+// Every stream x colour variant drawn once from a fresh ShaderLibrary, through get()
+// (a program per variant) or pipeline() (a program per stage, paired up in
+// ProgramPipelines). compiles counts the shader stages compiled for all of them: 24
+// programs' worth for get(), the stage variants in use for pipeline(). Before timing,
+// every pipeline has to draw the same pixels as its program.
+static const unsigned int DRAWN_STREAMS[] = { SHADER_STREAM_POS_COLOR, SHADER_STREAM_POS2, SHADER_STREAM_VERTEX_ID, SHADER_STREAM_INSTANCED };
+static const unsigned int DRAWN_COLORS[] = { SHADER_COLOR_UNIFORM, SHADER_COLOR_HUE, SHADER_COLOR_VERTEX };
+
+static void setVariantUniforms(Shader &shader)
+{
+	shader.set(uniformName("pA"), pA);
+	shader.set(uniformName("pB"), pB);
+	shader.set(uniformName("pC"), pC);
+	shader.set(uniformName("time"), 0.5f);
+	shader.set(uniformName("transform"), glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0, 1.0, 0.0)));
+	shader.set(uniformName("colorOver"), glm::vec3(1.0f, 0.5f, 0.2f));
+}
+
+static void drawVariant(ShaderLibrary &shaders, Renderer &mesh, unsigned int variant, bool separate)
+{
+	glClear(GL_COLOR_BUFFER_BIT);
+	glBindVertexArray(mesh.VAO);
+	if (separate) {
+		ProgramPipeline &pipeline = shaders.pipeline(variant);
+		pipeline.bind();
+		pipeline.activate(pipeline.vertex);
+		setVariantUniforms(pipeline.vertex);
+		pipeline.activate(pipeline.fragment);
+		setVariantUniforms(pipeline.fragment);
+	}
+	else {
+		Shader &shader = shaders.get(variant);
+		shader.use();
+		setVariantUniforms(shader);
+	}
+	mesh.submit();
+	glBindProgramPipeline(0);
+}
+
+static uint32_t framebufferHash()
+{
+	std::vector<unsigned char> pixels((size_t)SCREEN_WIDTH * SCREEN_HEIGHT * 4);
+	glReadPixels(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < pixels.size(); i++)
+		hash = (hash ^ pixels[i]) * 16777619u;
+	return hash;
+}
+
+static void BM_ShaderVariants(benchmark::State &state, bool separate)
+{
+	if (!hasGL(state))
+		return;
+	if (separate && !GLExt.separateShaderObjects) {
+		state.SkipWithError("no separate shader objects");
+		return;
+	}
+	// The meshes come with programs of their own, from another library
+	ShaderLibrary meshShaders;
+	std::vector<Renderer*> meshes;
+	for (unsigned int stream : DRAWN_STREAMS)
+		meshes.push_back(new Renderer(meshShaders, stream | SHADER_COLOR_UNIFORM, 4));
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+
+	if (separate) {
+		ShaderLibrary programs, pipelines;
+		for (size_t s = 0; s < meshes.size(); s++) {
+			for (unsigned int color : DRAWN_COLORS) {
+				unsigned int variant = DRAWN_STREAMS[s] | color;
+				drawVariant(programs, *meshes[s], variant, false);
+				uint32_t expected = framebufferHash();
+				drawVariant(pipelines, *meshes[s], variant, true);
+				if (framebufferHash() != expected)
+					state.SkipWithError("a pipeline drew other pixels than its program");
+			}
+		}
+	}
+
+	int compiles = 0;
+	for (auto _ : state) {
+		ShaderLibrary shaders;
+		for (size_t s = 0; s < meshes.size(); s++) {
+			for (unsigned int color : DRAWN_COLORS)
+				drawVariant(shaders, *meshes[s], DRAWN_STREAMS[s] | color, separate);
+		}
+		glFinish();
+		compiles = shaders.compiles;
+	}
+	state.counters["compiles"] = compiles;
+	for (size_t i = 0; i < meshes.size(); i++)
+		delete meshes[i];
+}
+BENCHMARK_CAPTURE(BM_ShaderVariants, programs, false)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_ShaderVariants, pipelines, true)->Unit(benchmark::kMillisecond);
+
+// TRACING //
+
+// What a TRACE_SCOPE costs compiled in, recording into a ring that keeps wrapping or
+// not recording at all. Uses TraceScope directly, so it runs in any build.
+static void BM_TraceScope(benchmark::State &state, bool recording)
+{
+	if (recording)
+		traceStart();
+	for (auto _ : state) {
+		TraceScope scope("benchmark");
+		benchmark::ClobberMemory();
+	}
+	traceStop();
+}
+BENCHMARK_CAPTURE(BM_TraceScope, recording, true);
+BENCHMARK_CAPTURE(BM_TraceScope, idle, false);
+
+int main(int argc, char** argv)
+{
+	// JSON next to the console table unless told otherwise
+	std::vector<char*> args(argv, argv + argc);
+	bool hasOut = false;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--benchmark_out=", 16) == 0)
+			hasOut = true;
+	}
+	static char outArg[] = "--benchmark_out=sierpinski_bench.json";
+	static char formatArg[] = "--benchmark_out_format=json";
+	if (!hasOut) {
+		args.push_back(outArg);
+		args.push_back(formatArg);
+	}
+	int count = (int)args.size();
+	args.push_back(NULL);
+	benchmark::Initialize(&count, &args[0]);
+	if (benchmark::ReportUnrecognizedArguments(count, &args[0]))
+		return 1;
+
+	glContext = new HeadlessContext(SCREEN_WIDTH, SCREEN_HEIGHT);
+	benchmark::AddCustomContext("avx2", hasAVX2() ? "yes" : "no");
+	benchmark::AddCustomContext("threads", std::to_string(pool().size()));
+	if (glContext->ok)
+		benchmark::AddCustomContext("gl_renderer", (const char*)glGetString(GL_RENDERER));
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	delete glContext;
+	return 0;
+}
@@ -0,0 +1,245 @@
+#include "AnalyticRaster.h"
+#include "Headless.h"
+#include "PngWriter.h"
+#include "Simd.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Cell coordinates are fixed point with 32 fractional bits
+static const int FRACTION_BITS = 32;
+static const int64_t FRACTION_MASK = 0xFFFFFFFFll;
+// Edges of the middle triangles go through pixel centres at the default size. Stepping
+// error is far below this slack, so values within it of a cell edge count as on it and
+// ties are broken with GL's top-left rule: s is nudged up (the edges where s is constant
+// are right edges), t down (left edges) and a sum of a cell edge is the top edge of a
+// middle triangle but the bottom edge of the base triangle.
+static const int64_t TIE_SLACK = 1 << 12;
+static const int64_t HALF_CELL = FRACTION_MASK - TIE_SLACK;
+
+const int AnalyticRaster::MAX_LEVELS;
+
+AnalyticRaster::AnalyticRaster(int width, int height, ThreadPool & pool)
+	: fbWidth(width), fbHeight(height), pool(pool), visible(false), levels(1),
+	sx(0.0), sy(0.0), s0(0.0), tx(0.0), ty(0.0), t0(0.0)
+{
+}
+
+void AnalyticRaster::setView(glm::vec2 A, glm::vec2 B, glm::vec2 C, int depth, const glm::mat4 & transform)
+{
+	// drawTris(depth) draws the middle triangles of levels 0..depth, the smallest
+	// being the lower-right halves of the cells at 2^(depth + 1)
+	levels = std::max(1, std::min(depth + 1, MAX_LEVELS));
+
+	// pixel -> NDC -> object space (inverse of the x/y part of transform) -> (s, t)
+	double m00 = transform[0][0], m01 = transform[1][0], m02 = transform[3][0];
+	double m10 = transform[0][1], m11 = transform[1][1], m12 = transform[3][1];
+	double det = m00 * m11 - m01 * m10;
+	glm::vec2 e1 = B - A, e2 = C - A;
+	double basisDet = (double)e1.x * e2.y - (double)e1.y * e2.x;
+	visible = std::fabs(det) > 1e-9 && std::fabs(basisDet) > 1e-12;
+	if (!visible)
+		return; // edge-on, nothing covers a pixel centre
+
+	// ndc.x = 2 px / W - 1, ndc.y = 1 - 2 py / H
+	double nx_px = 2.0 / fbWidth, ny_py = -2.0 / fbHeight;
+	// object = Minv * (ndc - translation)
+	double i00 = m11 / det, i01 = -m01 / det, i10 = -m10 / det, i11 = m00 / det;
+	// object.x = ox_px * px + ox_py * py + ox0, likewise object.y
+	double ox_px = i00 * nx_px, ox_py = i01 * ny_py, ox0 = i00 * (-1.0 - m02) + i01 * (1.0 - m12);
+	double oy_px = i10 * nx_px, oy_py = i11 * ny_py, oy0 = i10 * (-1.0 - m02) + i11 * (1.0 - m12);
+	// (s, t) = inverse([e1 e2]) * (object - A)
+	double b00 = e2.y / basisDet, b01 = -e2.x / basisDet, b10 = -e1.y / basisDet, b11 = e1.x / basisDet;
+	sx = b00 * ox_px + b01 * oy_px;
+	sy = b00 * ox_py + b01 * oy_py;
+	s0 = b00 * (ox0 - A.x) + b01 * (oy0 - A.y);
+	tx = b10 * ox_px + b11 * oy_px;
+	ty = b10 * ox_py + b11 * oy_py;
+	t0 = b10 * (ox0 - A.x) + b11 * (oy0 - A.y);
+}
+
+// Narrows [lo, hi] to the x where a * x + b >= 0
+static void clipHalfLine(double a, double b, double &lo, double &hi)
+{
+	if (a > 0.0)
+		lo = std::max(lo, -b / a);
+	else if (a < 0.0)
+		hi = std::min(hi, -b / a);
+	else if (b < 0.0)
+		hi = lo - 1.0;
+}
+
+static inline bool coveredScalar(int64_t X, int64_t Y, int64_t limit)
+{
+	if (X < 0 || Y < 0 || X + Y > limit)
+		return false;
+	return ((X >> FRACTION_BITS) & (Y >> FRACTION_BITS)) != 0 || (X & FRACTION_MASK) + (Y & FRACTION_MASK) > HALF_CELL;
+}
+
+#ifdef SIMD_X86
+// Coverage bits for pixels [first, last] of a span, 4 pixels per step
+AVX2_TARGET static void coverAVX2(int64_t X, int64_t Y, int64_t dX, int64_t dY, int64_t limit, int first, int last, uint64_t* words)
+{
+	const __m256i fraction = _mm256_set1_epi64x(FRACTION_MASK);
+	const __m256i halfCell = _mm256_set1_epi64x(HALF_CELL);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i minusOne = _mm256_set1_epi64x(-1);
+	const __m256i limits = _mm256_set1_epi64x(limit);
+	// X + k * dX for lanes k = 0..3
+	__m256i x = _mm256_setr_epi64x(X, X + dX, X + 2 * dX, X + 3 * dX);
+	__m256i y = _mm256_setr_epi64x(Y, Y + dY, Y + 2 * dY, Y + 3 * dY);
+	const __m256i stepX = _mm256_set1_epi64x(4 * dX), stepY = _mm256_set1_epi64x(4 * dY);
+	for (int px = first; px <= last; px += 4) {
+		__m256i inside = _mm256_and_si256(_mm256_cmpgt_epi64(x, minusOne), _mm256_cmpgt_epi64(y, minusOne));
+		inside = _mm256_andnot_si256(_mm256_cmpgt_epi64(_mm256_add_epi64(x, y), limits), inside);
+		__m256i cells = _mm256_and_si256(_mm256_srli_epi64(x, FRACTION_BITS), _mm256_srli_epi64(y, FRACTION_BITS));
+		__m256i lowerHalf = _mm256_cmpgt_epi64(_mm256_add_epi64(_mm256_and_si256(x, fraction), _mm256_and_si256(y, fraction)), halfCell);
+		// covered = inside && (cells != 0 || lowerHalf)
+		__m256i covered = _mm256_andnot_si256(_mm256_andnot_si256(lowerHalf, _mm256_cmpeq_epi64(cells, zero)), inside);
+		unsigned int bits = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(covered));
+		if (px + 3 > last)
+			bits &= 0xFu >> (px + 3 - last);
+		if (bits) {
+			// The 4 pixels can straddle two words when the span starts unaligned
+			// (the carry is only non-zero for pixels <= last, so it never touches the
+			// word past the span when the span ends on a word boundary)
+			int shift = px & 63;
+			words[px >> 6] |= (uint64_t)bits << shift;
+			uint64_t carry = shift > 60 ? (uint64_t)bits >> (64 - shift) : 0;
+			if (carry)
+				words[(px >> 6) + 1] |= carry;
+		}
+		x = _mm256_add_epi64(x, stepX);
+		y = _mm256_add_epi64(y, stepY);
+	}
+}
+#endif
+
+void AnalyticRaster::coverSpan(int y, int x0, int count, uint64_t * words) const
+{
+	static const bool avx2 = hasAVX2();
+	memset(words, 0, sizeof(uint64_t) * ((count + 63) / 64));
+	if (!visible || count <= 0)
+		return;
+
+	// Pixels of this row whose centre can be in the base triangle, found in double so
+	// the fixed point values below stay in range: s >= 0, t >= 0, 1 - s - t >= 0
+	double py = y + 0.5;
+	double sRow = sy * py + s0, tRow = ty * py + t0;
+	double lo = x0 + 0.5, hi = x0 + count - 0.5;
+	clipHalfLine(sx, sRow, lo, hi);
+	clipHalfLine(tx, tRow, lo, hi);
+	clipHalfLine(-sx - tx, 1.0 - sRow - tRow, lo, hi);
+	// One pixel of slack either way, the exact test happens in fixed point
+	int first = std::max(x0, (int)std::floor(lo - 0.5) - 1);
+	int last = std::min(x0 + count - 1, (int)std::ceil(hi - 0.5) + 1);
+	if (first > last)
+		return;
+
+	double scale = std::ldexp(1.0, levels + FRACTION_BITS);
+	int64_t limit = ((int64_t)1 << (levels + FRACTION_BITS)) - TIE_SLACK;
+	double pxFirst = first + 0.5;
+	int64_t X = (int64_t)std::floor((sx * pxFirst + sRow) * scale);
+	int64_t Y = (int64_t)std::floor((tx * pxFirst + tRow) * scale);
+	int64_t dX = (int64_t)std::floor(sx * scale + 0.5);
+	int64_t dY = (int64_t)std::floor(tx * scale + 0.5);
+
+	X += TIE_SLACK;
+	Y -= TIE_SLACK;
+	int begin = first - x0, end = last - x0;
+#ifdef SIMD_X86
+	if (avx2) {
+		coverAVX2(X, Y, dX, dY, limit, begin, end, words);
+		return;
+	}
+#endif
+	for (int px = begin; px <= end; px++, X += dX, Y += dY) {
+		if (coveredScalar(X, Y, limit))
+			words[px >> 6] |= (uint64_t)1 << (px & 63);
+	}
+}
+
+void expandCoverage(const uint64_t * words, int count, uint32_t color, uint32_t background, uint32_t * pixels)
+{
+	for (int base = 0; base < count; base += 64) {
+		uint64_t word = words[base >> 6];
+		int n = std::min(64, count - base);
+		uint32_t* out = pixels + base;
+		// Mostly-empty and mostly-solid words are the common case
+		if (word == 0) {
+			std::fill(out, out + n, background);
+			continue;
+		}
+		if (word == ~0ull) {
+			std::fill(out, out + n, color);
+			continue;
+		}
+		for (int i = 0; i < n; i++)
+			out[i] = (word >> i) & 1 ? color : background;
+	}
+}
+
+void AnalyticRaster::draw(ColorVec3 color, ColorVec3 clearColor, Image & out)
+{
+	if (out.width != fbWidth || out.height != fbHeight)
+		out = Image(fbWidth, fbHeight);
+	uint32_t fill = packRGBA(color), clear = packRGBA(clearColor);
+	const int ROWS = 16;
+	pool.parallelFor((fbHeight + ROWS - 1) / ROWS, [&](int band) {
+		std::vector<uint64_t> words(wordsPerRow());
+		for (int y = band * ROWS; y < std::min(fbHeight, (band + 1) * ROWS); y++) {
+			coverSpan(y, 0, fbWidth, &words[0]);
+			expandCoverage(&words[0], fbWidth, fill, clear, (uint32_t*)out.row(y));
+		}
+	});
+}
+
+void AnalyticRaster::drawMask(std::vector<uint64_t> & bits)
+{
+	int words = wordsPerRow();
+	bits.resize((size_t)words * fbHeight);
+	const int ROWS = 16;
+	pool.parallelFor((fbHeight + ROWS - 1) / ROWS, [&](int band) {
+		for (int y = band * ROWS; y < std::min(fbHeight, (band + 1) * ROWS); y++)
+			coverSpan(y, 0, fbWidth, &bits[(size_t)y * words]);
+	});
+}
+
+int runAnalyticRaster(const HeadlessOptions & options)
+{
+	ThreadPool pool;
+	AnalyticRaster raster(options.width, options.height, pool);
+	glm::vec2 pA(0.0f, 0.5f), pB(0.5f, -0.5f), pC(-0.5f, -0.5f); // Original Points For Triangle
+
+	Image image;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < options.frames; frame++) {
+		float time = frame * options.timeStep;
+		glm::mat4 trans = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0, 1.0, 0.0));
+		float h = 360.0f * ((sin(time) / 2.0f) + 0.5f);
+		raster.setView(pA, pB, pC, options.depth, trans);
+		raster.draw(getHSVColor(h, 1.0f, 1.0f), ColorVec3(0.2f, 0.3f, 0.3f), image);
+		if (options.outputPrefix) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s%04d.png", options.outputPrefix, frame);
+			if (!writePNG(path, image, &pool)) {
+				std::cout << "ERROR::ANALYTIC::WRITE_FAILED " << path << std::endl;
+				return -1;
+			}
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Analytically rendered " << options.frames << " frames at " << options.width << "x" << options.height
+		<< " (depth " << options.depth << ", " << pool.size() << " threads, " << (hasAVX2() ? "AVX2" : "scalar")
+		<< ") in " << seconds * 1000.0 << " ms";
+	if (options.frames > 0 && seconds > 0.0)
+		std::cout << ", " << options.frames / seconds << " fps";
+	std::cout << std::endl;
+	return 0;
+}
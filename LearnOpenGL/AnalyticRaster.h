@@ -0,0 +1,62 @@
+#ifndef ANALYTICRASTER_H
+#define ANALYTICRASTER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Image.h"
+#include "Sierpinski.h"
+#include "ThreadPool.h"
+
+struct HeadlessOptions;
+
+// Draws exactly what drawTris() + the GL pipeline would, without generating a single
+// triangle. In the skewed basis of the base triangle (origin A, axes B - A and C - A)
+// scaled by 2^N, a pixel centre falls in grid cell (i, j); the pixel is drawn when it
+// lies in the base triangle and is either in the lower-right half of its cell (the
+// depth-N middle triangles) or in a cell with (i & j) != 0 (Pascal's triangle mod 2:
+// every bigger middle triangle). That costs a handful of integer ops per pixel at any
+// depth, done 4 pixels at a time with AVX2 into 64-pixel coverage words, and rows are
+// spread over the thread pool.
+class AnalyticRaster
+{
+public:
+	// Deeper levels than this are far below pixel size for any image we can store
+	static const int MAX_LEVELS = 24;
+
+	AnalyticRaster(int width, int height, ThreadPool &pool);
+
+	int width() const { return fbWidth; }
+	int height() const { return fbHeight; }
+	int wordsPerRow() const { return (fbWidth + 63) / 64; }
+
+	// Base triangle, drawTris depth and the transform shader.vert applies. The
+	// transform has to be affine in x/y (the y-axis spin is).
+	void setView(glm::vec2 A, glm::vec2 B, glm::vec2 C, int depth, const glm::mat4 &transform);
+
+	// Coverage of pixels [x0, x0 + count) of row y, bit k of words[k >> 6] is pixel
+	// x0 + k. Thread safe, the tiled exporter calls it for pieces of huge images.
+	void coverSpan(int y, int x0, int count, uint64_t* words) const;
+
+	void draw(ColorVec3 color, ColorVec3 clearColor, Image &out);
+	void drawMask(std::vector<uint64_t> &bits);
+
+private:
+	int fbWidth, fbHeight;
+	ThreadPool &pool;
+	bool visible;
+	int levels;
+	// s and t of the pixel centre (x + 0.5, y + 0.5) are
+	// s = sx * (x + 0.5) + sy * (y + 0.5) + s0, t likewise
+	double sx, sy, s0, tx, ty, t0;
+};
+
+// Expand a coverage span into RGBA pixels
+void expandCoverage(const uint64_t* words, int count, uint32_t color, uint32_t background, uint32_t* pixels);
+
+// Same frames as runHeadless, drawn analytically
+int runAnalyticRaster(const HeadlessOptions &options);
+
+#endif
@@ -0,0 +1,215 @@
+#include "AppConfig.h"
+#include "Renderer.h"
+#include "Trace.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static bool parseInt(const std::string &text, int minimum, int &value)
+{
+	char* end = NULL;
+	long parsed = strtol(text.c_str(), &end, 10);
+	if (text.empty() || *end != '\0' || parsed < minimum || parsed > 1 << 30)
+		return false;
+	value = (int)parsed;
+	return true;
+}
+
+static bool parseSwitch(const std::string &text, bool &value)
+{
+	if (text == "on" || text == "true" || text == "1")
+		value = true;
+	else if (text == "off" || text == "false" || text == "0")
+		value = false;
+	else
+		return false;
+	return true;
+}
+
+// Keys that may be given without a value
+static bool valueOptional(const std::string &key)
+{
+	return key == "capture" || key == "profile" || key == "benchmark";
+}
+
+bool setOption(AppConfig & config, const std::string & key, const std::string & value)
+{
+	bool ok = true;
+	if (key == "depth") {
+		// How deep the strategy can go is checked once all options are in
+		ok = parseInt(value, 0, config.depth) && config.depth <= MAX_ANALYTIC_DEPTH;
+	}
+	else if (key == "size") {
+		size_t x = value.find('x');
+		ok = x != std::string::npos && parseInt(value.substr(0, x), 1, config.width) && parseInt(value.substr(x + 1), 1, config.height);
+	}
+	else if (key == "width") {
+		ok = parseInt(value, 1, config.width);
+	}
+	else if (key == "height") {
+		ok = parseInt(value, 1, config.height);
+	}
+	else if (key == "strategy") {
+		ok = findRenderStrategy(value.c_str()) != NULL;
+		if (ok)
+			config.strategy = value;
+	}
+	else if (key == "anim") {
+		ok = value == "gpu" || value == "cpu";
+		config.gpuAnim = value != "cpu";
+	}
+	else if (key == "frames") {
+		ok = parseInt(value, 0, config.frames);
+	}
+	else if (key == "vsync") {
+		ok = parseSwitch(value, config.vsync);
+	}
+	else if (key == "trace") {
+		if (!traceCompiledIn()) {
+			std::cout << "ERROR::CONFIG::TRACE_NOT_COMPILED_IN (build with SIERPINSKI_TRACE defined)" << std::endl;
+			return false;
+		}
+		config.tracePath = value;
+	}
+	else if (key == "gltrace") {
+		config.glTracePath = value;
+	}
+	else if (key == "glcalls") {
+		ok = parseSwitch(value, config.glCalls);
+	}
+	else if (key == "statecache") {
+		ok = parseSwitch(value, config.stateCache);
+	}
+	else if (key == "overlap") {
+		ok = parseSwitch(value, config.overlapInit);
+	}
+	else if (key == "stream") {
+		ok = parseSwitch(value, config.streamMesh);
+	}
+	else if (key == "counters") {
+		ok = parseSwitch(value, config.counters);
+	}
+	else if (key == "timestep") {
+		char* end = NULL;
+		config.timeStep = strtof(value.c_str(), &end);
+		ok = !value.empty() && *end == '\0' && config.timeStep >= 0.0f;
+	}
+	else if (key == "capture") {
+		config.capturePrefix = value.empty() ? "capture_" : value;
+	}
+	else if (key == "profile") {
+		config.profilePrefix = value.empty() ? "profile" : value;
+	}
+	else if (key == "benchmark") {
+		// Its defaults are filled in once all options are in (see parseArguments)
+		config.benchmark = true;
+		config.benchmarkPath = value.empty() ? "benchmark.json" : value;
+	}
+	else if (key == "config") {
+		return loadConfig(value.c_str(), config);
+	}
+	else {
+		std::cout << "ERROR::CONFIG::UNKNOWN_OPTION " << key << std::endl;
+		return false;
+	}
+	if (ok)
+		config.given.insert(key);
+	else
+		std::cout << "ERROR::CONFIG::BAD_VALUE " << key << " " << value << std::endl;
+	return ok;
+}
+
+static std::string trim(const std::string &text)
+{
+	size_t first = text.find_first_not_of(" \t\r");
+	if (first == std::string::npos)
+		return "";
+	return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+// Config files including each other, a file that includes itself stops here
+static const int MAX_CONFIG_NESTING = 8;
+static int configNesting = 0;
+
+static bool readConfig(const char* path, AppConfig &config);
+
+bool loadConfig(const char * path, AppConfig & config)
+{
+	if (configNesting >= MAX_CONFIG_NESTING) {
+		std::cout << "ERROR::CONFIG::NESTED_TOO_DEEP " << path << std::endl;
+		return false;
+	}
+	configNesting++;
+	bool ok = readConfig(path, config);
+	configNesting--;
+	return ok;
+}
+
+static bool readConfig(const char* path, AppConfig &config)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::CONFIG::FILE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	int number = 0;
+	while (std::getline(file, line)) {
+		number++;
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+		size_t equals = line.find('=');
+		std::string key = trim(line.substr(0, equals));
+		std::string value = equals == std::string::npos ? "" : trim(line.substr(equals + 1));
+		if (value.empty() && !valueOptional(key)) {
+			std::cout << "ERROR::CONFIG::MISSING_VALUE " << path << ":" << number << std::endl;
+			return false;
+		}
+		if (!setOption(config, key, value))
+			return false;
+	}
+	return true;
+}
+
+bool parseArguments(int argc, char ** argv, int first, AppConfig & config)
+{
+	for (int i = first; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0) {
+			std::cout << "ERROR::CONFIG::UNEXPECTED_ARGUMENT " << arg << std::endl;
+			return false;
+		}
+		std::string key = arg.substr(2);
+		std::string value;
+		bool hasValue = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0;
+		if (hasValue)
+			value = argv[++i];
+		else if (!valueOptional(key)) {
+			std::cout << "ERROR::CONFIG::MISSING_VALUE " << arg << std::endl;
+			return false;
+		}
+		if (!setOption(config, key, value))
+			return false;
+	}
+	// Whatever a benchmark would otherwise wait for or measure badly goes, unless it
+	// was set, before or after
+	if (config.benchmark) {
+		if (!config.given.count("vsync"))
+			config.vsync = false;
+		if (!config.given.count("timestep"))
+			config.timeStep = 1.0f / 60.0f;
+		if (!config.given.count("frames"))
+			config.frames = 1000;
+	}
+	// The strategy may come after the depth
+	const RenderStrategy* strategy = findRenderStrategy(config.strategy.c_str());
+	int maxDepth = strategy != NULL && strategy->stream == SHADER_ANALYTIC ? MAX_ANALYTIC_DEPTH : MAX_MESH_DEPTH;
+	if (config.depth > maxDepth) {
+		std::cout << "ERROR::CONFIG::DEPTH_TOO_DEEP " << config.depth << " (" << config.strategy << " goes to " << maxDepth << ")" << std::endl;
+		return false;
+	}
+	return true;
+}
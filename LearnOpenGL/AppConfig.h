@@ -0,0 +1,67 @@
+#ifndef APPCONFIG_H
+#define APPCONFIG_H
+
+#include <set>
+#include <string>
+
+// Settings of the windowed app, from the command line or a config file. Both take
+// the same keys, "--depth 7" on the command line is "depth = 7" in a file (# starts
+// a comment) and whatever comes later wins.
+//
+//   depth N           drawTris depth, to MAX_MESH_DEPTH (MAX_ANALYTIC_DEPTH for
+//                     impostor)
+//   size WxH          window size, or width N / height N
+//   strategy NAME     a RenderStrategy: vbo, vbo_pos2, indexed, instanced,
+//                     vertex_id or impostor
+//   anim gpu|cpu      where the hue and the spin are computed
+//   frames N          exit after N frames, 0 runs until ESC
+//   vsync on|off
+//   timestep S        animation advances S seconds every frame, 0 follows the clock
+//   capture [PREFIX]  dump every frame as PREFIX0000.png...
+//   profile [PREFIX]  timing overlay, PREFIX.csv and PREFIX.json
+//   trace PATH        Chrome trace JSON of the whole run (SIERPINSKI_TRACE builds)
+//   gltrace PATH      record every GL call into PATH for sierpinski_replay (GLTrace)
+//   glcalls on|off    count GL calls, redundant binds and uploads (GLAccounting),
+//                     printed per frame on exit
+//   statecache on|off drop redundant program/VAO/buffer binds, on in release builds
+//   counters on|off   hardware counters (PerfCounters) around generation, upload
+//                     and the frame loop, printed on exit
+//   overlap on|off    build the mesh on a worker while the window and context are
+//                     created and look up only the GL calls used (on by default)
+//   stream on|off     upload the mesh in chunks while generator threads build it,
+//                     drawing what is in so far (MeshStream; vbo, vbo_pos2 and
+//                     instanced)
+//   benchmark [PATH]  vsync off, 1/60 s timestep and 1000 frames unless set, then
+//                     print throughput and write it to PATH (benchmark.json)
+//   config PATH       read PATH here
+struct AppConfig {
+	int width;
+	int height;
+	int depth;
+	std::string strategy;
+	bool gpuAnim;
+	int frames;
+	bool vsync;
+	float timeStep;
+	std::string capturePrefix; // empty for none
+	std::string profilePrefix; // empty for none
+	bool counters;
+	bool glCalls;
+	bool stateCache;
+	std::string tracePath; // empty for none
+	std::string glTracePath; // empty for none
+	bool overlapInit;
+	bool streamMesh;
+	bool benchmark;
+	std::string benchmarkPath;
+	// Keys set so far, defaults filled in later leave them alone
+	std::set<std::string> given;
+};
+
+// Applies one key, printing what is wrong with it and returning false if anything is
+bool setOption(AppConfig &config, const std::string &key, const std::string &value);
+bool loadConfig(const char* path, AppConfig &config);
+// Applies argv[first] onwards in order
+bool parseArguments(int argc, char** argv, int first, AppConfig &config);
+
+#endif
@@ -0,0 +1,167 @@
+#include "BigTiff.h"
+
+#include <iostream>
+#include <vector>
+
+// TIFF field types
+static const uint16_t TIFF_SHORT = 3;
+static const uint16_t TIFF_LONG = 4;
+static const uint16_t TIFF_LONG8 = 16;
+
+static const int HEADER_BYTES = 16;
+static const int ENTRY_COUNT = 11;
+// Entry count, entries, next IFD offset
+static const int IFD_BYTES = 8 + ENTRY_COUNT * 20 + 8;
+
+static int seek64(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static void put16(std::vector<unsigned char> &out, uint16_t value)
+{
+	out.push_back((unsigned char)value);
+	out.push_back((unsigned char)(value >> 8));
+}
+
+static void put64(std::vector<unsigned char> &out, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+		out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+// One IFD entry. Values of up to 8 bytes sit in the entry itself, left aligned.
+static void putEntry(std::vector<unsigned char> &out, uint16_t tag, uint16_t type, uint64_t count, const uint16_t* shorts, uint64_t value)
+{
+	put16(out, tag);
+	put16(out, type);
+	put64(out, count);
+	if (shorts) {
+		for (uint64_t i = 0; i < 4; i++)
+			put16(out, i < count ? shorts[i] : 0);
+	}
+	else {
+		put64(out, value);
+	}
+}
+
+BigTiffWriter::BigTiffWriter() : width(0), height(0), tilesAcross(0), tilesDown(0), file(NULL), nextRow(0)
+{
+}
+
+BigTiffWriter::~BigTiffWriter()
+{
+	close();
+}
+
+uint64_t BigTiffWriter::dataOffset() const
+{
+	uint64_t tiles = (uint64_t)tilesAcross * tilesDown;
+	uint64_t tables = tiles > 1 ? 2 * tiles * 8 : 0;
+	return HEADER_BYTES + IFD_BYTES + tables;
+}
+
+bool BigTiffWriter::open(const char * path, int width, int height, int resumeRow)
+{
+	close();
+	this->width = width;
+	this->height = height;
+	tilesAcross = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesDown = (height + TILE_SIZE - 1) / TILE_SIZE;
+	nextRow = resumeRow;
+
+	if (resumeRow > 0) {
+		// Header and tables are already there, they only depend on the size
+		file = fopen(path, "r+b");
+		if (!file || seek64(file, dataOffset() + (uint64_t)resumeRow * tilesAcross * TILE_BYTES) != 0) {
+			std::cout << "ERROR::BIGTIFF::RESUME_FAILED " << path << std::endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	file = fopen(path, "wb");
+	if (!file) {
+		std::cout << "ERROR::BIGTIFF::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+
+	uint64_t tiles = (uint64_t)tilesAcross * tilesDown;
+	uint64_t offsetsAt = HEADER_BYTES + IFD_BYTES, countsAt = offsetsAt + tiles * 8;
+	std::vector<unsigned char> out;
+	out.push_back('I');
+	out.push_back('I');
+	put16(out, 43); // BigTIFF
+	put16(out, 8);  // offset size
+	put16(out, 0);
+	put64(out, HEADER_BYTES);
+
+	static const uint16_t bitsPerSample[3] = { 8, 8, 8 };
+	static const uint16_t one = 1, rgb = 2, three = 3;
+	put64(out, ENTRY_COUNT);
+	putEntry(out, 256, TIFF_LONG, 1, NULL, (uint64_t)width);      // ImageWidth
+	putEntry(out, 257, TIFF_LONG, 1, NULL, (uint64_t)height);     // ImageLength
+	putEntry(out, 258, TIFF_SHORT, 3, bitsPerSample, 0);          // BitsPerSample
+	putEntry(out, 259, TIFF_SHORT, 1, &one, 0);                   // Compression: none
+	putEntry(out, 262, TIFF_SHORT, 1, &rgb, 0);                   // PhotometricInterpretation: RGB
+	putEntry(out, 277, TIFF_SHORT, 1, &three, 0);                 // SamplesPerPixel
+	putEntry(out, 284, TIFF_SHORT, 1, &one, 0);                   // PlanarConfiguration: chunky
+	putEntry(out, 322, TIFF_LONG, 1, NULL, TILE_SIZE);            // TileWidth
+	putEntry(out, 323, TIFF_LONG, 1, NULL, TILE_SIZE);            // TileLength
+	// A single tile's offset and byte count fit in the entries
+	putEntry(out, 324, TIFF_LONG8, tiles, NULL, tiles > 1 ? offsetsAt : dataOffset()); // TileOffsets
+	putEntry(out, 325, TIFF_LONG8, tiles, NULL, tiles > 1 ? countsAt : TILE_BYTES);    // TileByteCounts
+	put64(out, 0); // no further IFDs
+
+	bool ok = fwrite(&out[0], 1, out.size(), file) == out.size();
+	if (tiles > 1) {
+		// Offsets then byte counts, written a tile row at a time to keep memory flat
+		for (int pass = 0; pass < 2 && ok; pass++) {
+			for (int row = 0; row < tilesDown && ok; row++) {
+				out.clear();
+				for (int col = 0; col < tilesAcross; col++) {
+					uint64_t tile = (uint64_t)row * tilesAcross + col;
+					put64(out, pass == 0 ? dataOffset() + tile * TILE_BYTES : TILE_BYTES);
+				}
+				ok = fwrite(&out[0], 1, out.size(), file) == out.size();
+			}
+		}
+	}
+	if (!ok) {
+		std::cout << "ERROR::BIGTIFF::WRITE_FAILED " << path << std::endl;
+		close();
+	}
+	return ok;
+}
+
+bool BigTiffWriter::writeTileRow(int row, const unsigned char * tiles)
+{
+	if (!file || row != nextRow)
+		return false;
+	size_t bytes = (size_t)tilesAcross * TILE_BYTES;
+	if (fwrite(tiles, 1, bytes, file) != bytes) {
+		std::cout << "ERROR::BIGTIFF::WRITE_FAILED tile row " << row << std::endl;
+		return false;
+	}
+	nextRow++;
+	return true;
+}
+
+bool BigTiffWriter::flush()
+{
+	return file && fflush(file) == 0;
+}
+
+bool BigTiffWriter::close()
+{
+	if (!file)
+		return true;
+	bool ok = fclose(file) == 0;
+	file = NULL;
+	return ok;
+}
@@ -0,0 +1,42 @@
+#ifndef BIGTIFF_H
+#define BIGTIFF_H
+
+#include <cstdint>
+#include <cstdio>
+
+// Streams an uncompressed, tiled, 8-bit RGB BigTIFF to disk. Everything is at a
+// fixed offset (header, one IFD, tile offset/byte count tables, then the tiles in
+// row-major order), so the file is written front to back, only one row of tiles
+// has to be in memory, and an interrupted export can pick up at any tile row.
+class BigTiffWriter
+{
+public:
+	static const int TILE_SIZE = 256;
+	static const int TILE_BYTES = TILE_SIZE * TILE_SIZE * 3;
+
+	int width, height;
+	int tilesAcross, tilesDown;
+
+	BigTiffWriter();
+	~BigTiffWriter();
+
+	// Creates path and writes the header and tables. With resumeRow > 0 the file
+	// has to exist from an earlier run with the same size, it is reopened and
+	// writing carries on at that tile row.
+	bool open(const char* path, int width, int height, int resumeRow = 0);
+	// Tile row rows[TILE_SIZE * row, TILE_SIZE * (row + 1)), as tilesAcross tiles of
+	// TILE_BYTES each. Rows must come in order.
+	bool writeTileRow(int row, const unsigned char* tiles);
+	// Flushes what was written to the OS, so a progress record can trust it
+	bool flush();
+	bool close();
+
+	// Byte offset of tile row 0
+	uint64_t dataOffset() const;
+
+private:
+	FILE* file;
+	int nextRow;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "FrameCapture.h"
+#include "Image.h"
+#include "PngWriter.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::FrameCapture(FrameSink * sink)
+	: framesCaptured(0), stalls(0), sink(sink), next(0), worker(1), failed(0), finished(false)
+{
+	for (int i = 0; i < RING_SIZE; i++) {
+		glGenBuffers(1, &slots[i].PBO);
+		slots[i].fence = NULL;
+		slots[i].frame = -1;
+		slots[i].width = slots[i].height = 0;
+		slots[i].mapped = NULL;
+		slots[i].inUse = false;
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	finish();
+	for (int i = 0; i < RING_SIZE; i++)
+		glDeleteBuffers(1, &slots[i].PBO);
+}
+
+void FrameCapture::capture(int width, int height)
+{
+	TRACE_SCOPE("capture");
+	Slot &slot = slots[next];
+	if (slot.fence)
+		collect(slot);
+	release(slot);
+	finished = false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+	if (slot.width != width || slot.height != height) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+		slot.width = width;
+		slot.height = height;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	// Into the PBO, returns as soon as the copy is queued
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = framesCaptured++;
+
+	next = (next + 1) % RING_SIZE;
+	Slot &ready = slots[(next + RING_SIZE - 1 - MAP_LAG) % RING_SIZE];
+	if (ready.fence)
+		collect(ready);
+}
+
+void FrameCapture::collect(Slot & slot)
+{
+	// Normally signalled long ago, the flush bit makes sure a wait can't hang
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		stalls++;
+		status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = NULL;
+	if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) {
+		std::cout << "ERROR::CAPTURE::FENCE_FAILED frame " << slot.frame << std::endl;
+		std::lock_guard<std::mutex> lock(mutex);
+		failed++;
+		return;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+	slot.mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)slot.width * slot.height * 4, GL_MAP_READ_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (!slot.mapped) {
+		std::cout << "ERROR::CAPTURE::MAP_FAILED frame " << slot.frame << std::endl;
+		std::lock_guard<std::mutex> lock(mutex);
+		failed++;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.inUse = true;
+	}
+	Slot* held = &slot;
+	worker.submit([this, held] {
+		bool ok = sink->consume((const unsigned char*)held->mapped, held->width, held->height, held->frame);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!ok)
+			failed++;
+		held->inUse = false;
+		released.notify_all();
+	});
+}
+
+void FrameCapture::release(Slot & slot)
+{
+	if (!slot.mapped)
+		return;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (slot.inUse) {
+			stalls++;
+			released.wait(lock, [&slot] { return !slot.inUse; });
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.PBO);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.mapped = NULL;
+}
+
+void FrameCapture::finish()
+{
+	if (finished)
+		return;
+	// Oldest first, so the sink gets them in order
+	for (int i = 0; i < RING_SIZE; i++) {
+		Slot &slot = slots[(next + i) % RING_SIZE];
+		if (slot.fence)
+			collect(slot);
+	}
+	worker.wait();
+	for (int i = 0; i < RING_SIZE; i++)
+		release(slots[i]);
+	if (!sink->finish()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		failed++;
+	}
+	finished = true;
+}
+
+int FrameCapture::failures()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed;
+}
+
+PngSequence::PngSequence(const char * outputPrefix, int encoderThreads)
+	: prefix(outputPrefix), encoders(encoderThreads), queued(0), failed(0)
+{
+}
+
+PngSequence::~PngSequence()
+{
+	encoders.wait();
+}
+
+bool PngSequence::consume(const unsigned char * rgba, int width, int height, int frame)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		encoded.wait(lock, [this] { return queued < 2 * encoders.size(); });
+		queued++;
+	}
+	// Copied out, flipping to top-down rows, so the buffer goes back to GL right away
+	Image* image = new Image(width, height);
+	size_t stride = (size_t)width * 4;
+	for (int y = 0; y < height; y++)
+		memcpy(image->row(y), rgba + (size_t)(height - 1 - y) * stride, stride);
+
+	char path[1024];
+	snprintf(path, sizeof(path), "%s%04d.png", prefix.c_str(), frame);
+	std::string target = path;
+	encoders.submit([this, image, target] {
+		TRACE_SCOPE("encode png");
+		bool ok = writePNG(target.c_str(), *image);
+		delete image;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!ok) {
+			std::cout << "ERROR::CAPTURE::WRITE_FAILED " << target << std::endl;
+			failed++;
+		}
+		queued--;
+		encoded.notify_all();
+	});
+	return true;
+}
+
+bool PngSequence::finish()
+{
+	encoders.wait();
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed == 0;
+}
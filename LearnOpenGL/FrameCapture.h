@@ -0,0 +1,100 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "ThreadPool.h"
+
+// Receives captured frames on FrameCapture's worker thread, one at a time and in
+// frame order. rgba is the mapped pixel buffer itself, bottom row first, and is
+// only valid during the call.
+class FrameSink
+{
+public:
+	virtual ~FrameSink() {}
+	// Returns false if the frame could not be written
+	virtual bool consume(const unsigned char* rgba, int width, int height, int frame) = 0;
+	// Called once after the last frame, from the thread calling FrameCapture::finish()
+	virtual bool finish() { return true; }
+};
+
+// Hands rendered frames to a FrameSink without stalling the GL pipeline.
+// capture() only queues a glReadPixels into one of RING_SIZE pixel buffer objects
+// and fences it. Two frames later, by which time the copy is long done, the buffer
+// is mapped and the sink reads straight out of it on a worker thread while the
+// next frames render; it is unmapped when its slot comes round again.
+class FrameCapture
+{
+public:
+	static const int RING_SIZE = 4;
+	// Frames between a readback and mapping it
+	static const int MAP_LAG = 2;
+
+	int framesCaptured;
+	// Times a fence was not signalled yet, or the sink still held the slot, and
+	// capture() had to wait
+	int stalls;
+
+	// Needs a current context. sink has to outlive the capture.
+	FrameCapture(FrameSink* sink);
+	~FrameCapture();
+
+	// Reads back the bound read framebuffer, width x height from the lower left.
+	// Call after drawing and before swapping.
+	void capture(int width, int height);
+	// Hands every frame still in the ring to the sink and waits for it
+	void finish();
+	// Frames the sink failed to write
+	int failures();
+
+private:
+	struct Slot {
+		unsigned int PBO;
+		GLsync fence;
+		int frame;
+		int width, height;
+		void* mapped;
+		bool inUse; // the sink is reading mapped
+	};
+
+	FrameSink* sink;
+	Slot slots[RING_SIZE];
+	int next;
+	// One thread, so the sink sees frames in order
+	ThreadPool worker;
+	std::mutex mutex;
+	std::condition_variable released;
+	int failed;
+	bool finished;
+
+	void collect(Slot &slot);
+	void release(Slot &slot);
+};
+
+// FrameSink writing <prefix>0000.png... The frame is copied out of the mapped
+// buffer and encoded on a pool of encoder threads, several frames at a time.
+class PngSequence : public FrameSink
+{
+public:
+	// encoderThreads 0 means one per hardware thread
+	PngSequence(const char* outputPrefix, int encoderThreads = 0);
+	~PngSequence();
+
+	bool consume(const unsigned char* rgba, int width, int height, int frame);
+	bool finish();
+
+private:
+	std::string prefix;
+	ThreadPool encoders;
+	// Frames waiting for an encoder, capped so a slow disk can't pile them up in memory
+	std::mutex mutex;
+	std::condition_variable encoded;
+	int queued;
+	int failed;
+};
+
+#endif
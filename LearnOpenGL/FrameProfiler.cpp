@@ -0,0 +1,275 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+static const char* SECTION_NAMES[PROFILE_SECTION_COUNT] = {
+	"input", "uniforms", "submit", "swap", "frame", "gpu_clear", "gpu_draw"
+};
+
+TimingHistogram::TimingHistogram() : count(0), sum(0.0), min(0.0), max(0.0), buckets(BUCKETS, 0)
+{
+}
+
+void TimingHistogram::add(double ms)
+{
+	double ns = std::max(ms * 1e6, 1.0);
+	int bucket = std::min((int)(std::log2(ns) * BUCKETS_PER_OCTAVE), BUCKETS - 1);
+	buckets[bucket]++;
+	min = count == 0 ? ms : std::min(min, ms);
+	max = count == 0 ? ms : std::max(max, ms);
+	sum += ms;
+	count++;
+}
+
+double TimingHistogram::percentile(double p) const
+{
+	if (count == 0)
+		return 0.0;
+	long long rank = std::max(1LL, (long long)std::ceil(p * count));
+	long long seen = 0;
+	for (int bucket = 0; bucket < BUCKETS; bucket++) {
+		seen += buckets[bucket];
+		if (seen >= rank) {
+			// Geometric middle of the bucket, kept inside the values actually seen
+			double ms = std::exp2((bucket + 0.5) / BUCKETS_PER_OCTAVE) / 1e6;
+			return std::min(std::max(ms, min), max);
+		}
+	}
+	return max;
+}
+
+FrameProfiler::FrameProfiler(const char * csvPath) : frames(0), gpuDropped(0), current(NULL), csv(NULL)
+{
+	for (int i = 0; i < GPU_LATENCY; i++) {
+		ring[i].pending = false;
+		glGenQueries(PROFILE_GPU_COUNT, ring[i].queries);
+	}
+	for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+		window[s].reserve(ROLLING_FRAMES);
+		windowNext[s] = 0;
+	}
+	if (csvPath) {
+		csv = fopen(csvPath, "w");
+		if (!csv) {
+			std::cout << "ERROR::PROFILER::OPEN_FAILED " << csvPath << std::endl;
+		}
+		else {
+			// A row is ~60 bytes, this flushes every thousand frames or so
+			setvbuf(csv, NULL, _IOFBF, 1 << 16);
+			fprintf(csv, "frame");
+			for (int s = 0; s < PROFILE_SECTION_COUNT; s++)
+				fprintf(csv, ",%s_ms", SECTION_NAMES[s]);
+			fprintf(csv, "\n");
+		}
+	}
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	finish();
+	for (int i = 0; i < GPU_LATENCY; i++)
+		glDeleteQueries(PROFILE_GPU_COUNT, ring[i].queries);
+	if (csv)
+		fclose(csv);
+}
+
+void FrameProfiler::beginFrame()
+{
+	current = &ring[frames % GPU_LATENCY];
+	if (current->pending)
+		resolve(*current, false);
+	current->frame = frames;
+	for (int s = 0; s < PROFILE_FIRST_GPU; s++)
+		current->cpu[s] = -1.0;
+	for (int i = 0; i < PROFILE_GPU_COUNT; i++)
+		current->issued[i] = false;
+	frameStart = std::chrono::steady_clock::now();
+}
+
+void FrameProfiler::endFrame()
+{
+	if (!current)
+		return;
+	current->cpu[PROFILE_FRAME] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+	current->pending = true;
+	current = NULL;
+	frames++;
+}
+
+void FrameProfiler::begin(ProfileSection section)
+{
+	if (!current)
+		return;
+	if (section >= PROFILE_FIRST_GPU) {
+		// GL_TIME_ELAPSED queries can't nest, GPU sections must not overlap
+		glBeginQuery(GL_TIME_ELAPSED, current->queries[section - PROFILE_FIRST_GPU]);
+		current->issued[section - PROFILE_FIRST_GPU] = true;
+	}
+	else {
+		sectionStart[section] = std::chrono::steady_clock::now();
+	}
+}
+
+void FrameProfiler::end(ProfileSection section)
+{
+	if (!current)
+		return;
+	if (section >= PROFILE_FIRST_GPU)
+		glEndQuery(GL_TIME_ELAPSED);
+	else
+		current->cpu[section] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sectionStart[section]).count();
+}
+
+void FrameProfiler::finish()
+{
+	// Oldest first, so the CSV stays in frame order
+	for (int i = 0; i < GPU_LATENCY; i++) {
+		Frame &frame = ring[(frames + i) % GPU_LATENCY];
+		if (frame.pending)
+			resolve(frame, true);
+	}
+	if (csv)
+		fflush(csv);
+}
+
+void FrameProfiler::resolve(Frame & frame, bool wait)
+{
+	double gpu[PROFILE_GPU_COUNT];
+	for (int i = 0; i < PROFILE_GPU_COUNT; i++) {
+		gpu[i] = -1.0;
+		if (!frame.issued[i])
+			continue;
+		GLint available = GL_TRUE;
+		if (!wait)
+			glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			gpuDropped++;
+			continue;
+		}
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+		gpu[i] = ns / 1e6;
+	}
+	frame.pending = false;
+
+	for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+		double ms = s < PROFILE_FIRST_GPU ? frame.cpu[s] : gpu[s - PROFILE_FIRST_GPU];
+		if (ms >= 0.0)
+			record((ProfileSection)s, ms);
+	}
+	if (csv) {
+		// Sections not timed this frame are left empty
+		fprintf(csv, "%lld", frame.frame);
+		for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+			double ms = s < PROFILE_FIRST_GPU ? frame.cpu[s] : gpu[s - PROFILE_FIRST_GPU];
+			if (ms >= 0.0)
+				fprintf(csv, ",%.4f", ms);
+			else
+				fputc(',', csv);
+		}
+		fputc('\n', csv);
+	}
+}
+
+void FrameProfiler::record(ProfileSection section, double ms)
+{
+	histograms[section].add(ms);
+	std::vector<float> &samples = window[section];
+	if ((int)samples.size() < ROLLING_FRAMES)
+		samples.push_back((float)ms);
+	else
+		samples[windowNext[section]] = (float)ms;
+	windowNext[section] = (windowNext[section] + 1) % ROLLING_FRAMES;
+}
+
+double FrameProfiler::rolling(ProfileSection section, double p) const
+{
+	const std::vector<float> &samples = window[section];
+	if (samples.empty())
+		return 0.0;
+	std::vector<float> sorted(samples);
+	size_t rank = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+std::string FrameProfiler::summary() const
+{
+	std::ostringstream text;
+	text.precision(2);
+	text << std::fixed << "frame " << rolling(PROFILE_FRAME, 0.5) << "/" << rolling(PROFILE_FRAME, 0.99) << " ms"
+		<< "  submit " << rolling(PROFILE_SUBMIT, 0.5) << "/" << rolling(PROFILE_SUBMIT, 0.99)
+		<< "  swap " << rolling(PROFILE_SWAP, 0.5) << "/" << rolling(PROFILE_SWAP, 0.99)
+		<< "  gpu draw " << rolling(PROFILE_GPU_DRAW, 0.5) << "/" << rolling(PROFILE_GPU_DRAW, 0.99)
+		<< "  (p50/p99)";
+	return text.str();
+}
+
+static void fillRect(int x, int y, int width, int height, float r, float g, float b)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	glScissor(x, y, width, height);
+	glClearColor(r, g, b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void FrameProfiler::drawOverlay(int width, int height)
+{
+	const int PANEL = 256, ROW = 8, BAR = 6, MARGIN = 8;
+	const double FULL_MS = 20.0, BUDGET_MS = 1000.0 / 60.0;
+	// CPU sections warm, GPU sections cool
+	static const float COLORS[PROFILE_SECTION_COUNT][3] = {
+		{ 0.9f, 0.8f, 0.2f }, { 0.9f, 0.5f, 0.1f }, { 0.9f, 0.2f, 0.2f }, { 0.7f, 0.3f, 0.8f },
+		{ 1.0f, 1.0f, 1.0f }, { 0.2f, 0.7f, 0.9f }, { 0.2f, 0.9f, 0.4f }
+	};
+	int top = height - MARGIN;
+	int panelHeight = PROFILE_SECTION_COUNT * ROW + 2;
+	if (width < PANEL + 2 * MARGIN || top - panelHeight < 0)
+		return;
+
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	glEnable(GL_SCISSOR_TEST);
+	fillRect(MARGIN - 1, top - panelHeight, PANEL + 2, panelHeight + 1, 0.05f, 0.05f, 0.05f);
+	for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+		int y = top - (s + 1) * ROW;
+		const float* c = COLORS[s];
+		// p99 faint, p95 half, p50 full, each drawn over the longer one
+		const double ps[3] = { 0.99, 0.95, 0.5 };
+		const float shades[3] = { 0.3f, 0.6f, 1.0f };
+		for (int i = 0; i < 3; i++) {
+			int length = (int)(std::min(rolling((ProfileSection)s, ps[i]) / FULL_MS, 1.0) * PANEL);
+			fillRect(MARGIN, y, length, BAR, c[0] * shades[i], c[1] * shades[i], c[2] * shades[i]);
+		}
+	}
+	fillRect(MARGIN + (int)(BUDGET_MS / FULL_MS * PANEL), top - panelHeight, 1, panelHeight + 1, 1.0f, 1.0f, 1.0f);
+	glDisable(GL_SCISSOR_TEST);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
+
+bool FrameProfiler::writeJSON(const char * path, const std::string & header) const
+{
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		std::cout << "ERROR::PROFILER::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	fprintf(file, "{\n%s  \"frames\": %lld,\n  \"gpu_dropped\": %d,\n  \"unit\": \"ms\",\n  \"sections\": {\n", header.c_str(), frames, gpuDropped);
+	for (int s = 0; s < PROFILE_SECTION_COUNT; s++) {
+		const TimingHistogram &h = histograms[s];
+		fprintf(file, "    \"%s\": { \"samples\": %lld, \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			SECTION_NAMES[s], h.count, h.mean(), h.min, h.percentile(0.5), h.percentile(0.95), h.percentile(0.99), h.max,
+			s + 1 < PROFILE_SECTION_COUNT ? "," : "");
+	}
+	fprintf(file, "  }\n}\n");
+	return fclose(file) == 0;
+}
+
+const char* FrameProfiler::name(ProfileSection section)
+{
+	return SECTION_NAMES[section];
+}
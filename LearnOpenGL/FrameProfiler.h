@@ -0,0 +1,127 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// What a frame is broken into. CPU sections are steady_clock time around the call,
+// GPU sections GL_TIME_ELAPSED queries around the commands.
+enum ProfileSection {
+	PROFILE_INPUT,
+	PROFILE_UNIFORMS,
+	PROFILE_SUBMIT,
+	PROFILE_SWAP,
+	PROFILE_FRAME,     // beginFrame() to endFrame(), the whole loop iteration
+	PROFILE_GPU_CLEAR,
+	PROFILE_GPU_DRAW,
+	PROFILE_SECTION_COUNT
+};
+const int PROFILE_FIRST_GPU = PROFILE_GPU_CLEAR;
+const int PROFILE_GPU_COUNT = PROFILE_SECTION_COUNT - PROFILE_FIRST_GPU;
+
+// Whole-run distribution of one section: 8 log-spaced buckets per octave of
+// nanoseconds, so a percentile is within 5% of the exact value at any scale
+class TimingHistogram
+{
+public:
+	long long count;
+	double sum, min, max; // milliseconds
+
+	TimingHistogram();
+	void add(double ms);
+	double percentile(double p) const;
+	double mean() const { return count > 0 ? sum / count : 0.0; }
+
+private:
+	static const int BUCKETS_PER_OCTAVE = 8;
+	static const int BUCKETS = 40 * BUCKETS_PER_OCTAVE; // up to 2^40 ns, 18 minutes
+	std::vector<uint32_t> buckets;
+};
+
+// Per-frame timings of the render loop. GPU queries are read GPU_LATENCY frames
+// after they were issued, when the results are there without a stall; a query
+// still not done by then is dropped rather than waited on. Each completed frame
+// is added to a whole-run histogram and a rolling window per section, and
+// optionally appended to a CSV file.
+class FrameProfiler
+{
+public:
+	static const int GPU_LATENCY = 4;
+	// Frames the rolling percentiles cover
+	static const int ROLLING_FRAMES = 256;
+
+	long long frames;
+	// GPU samples whose query was not done after GPU_LATENCY frames
+	int gpuDropped;
+	TimingHistogram histograms[PROFILE_SECTION_COUNT];
+
+	// Needs a current context. csvPath NULL writes no CSV.
+	FrameProfiler(const char* csvPath = NULL);
+	~FrameProfiler();
+
+	void beginFrame();
+	void endFrame();
+	void begin(ProfileSection section);
+	void end(ProfileSection section);
+	// Reads back every query still in flight, waiting for the GPU
+	void finish();
+
+	// p in [0, 1] over the last ROLLING_FRAMES frames, in milliseconds
+	double rolling(ProfileSection section, double p) const;
+	// One line of rolling p50/p99s, e.g. for the window title
+	std::string summary() const;
+	// Bars of the rolling p50/p95/p99 of every section in the top left corner,
+	// drawn with scissored clears so no shader or buffer state is touched. Full
+	// width is 20 ms, the white mark is the 60 Hz frame budget.
+	void drawOverlay(int width, int height);
+	// Whole-run histogram percentiles of every section. header goes at the top of
+	// the object as is, e.g. "  \"depth\": 5,\n", to say what was measured.
+	bool writeJSON(const char* path, const std::string &header = "") const;
+
+	static const char* name(ProfileSection section);
+
+private:
+	struct Frame {
+		long long frame;
+		bool pending;
+		double cpu[PROFILE_FIRST_GPU];
+		unsigned int queries[PROFILE_GPU_COUNT];
+		bool issued[PROFILE_GPU_COUNT];
+	};
+
+	Frame ring[GPU_LATENCY];
+	Frame* current;
+	std::chrono::steady_clock::time_point frameStart;
+	std::chrono::steady_clock::time_point sectionStart[PROFILE_FIRST_GPU];
+	std::vector<float> window[PROFILE_SECTION_COUNT];
+	int windowNext[PROFILE_SECTION_COUNT];
+	FILE* csv;
+
+	void resolve(Frame &frame, bool wait);
+	void record(ProfileSection section, double ms);
+};
+
+// Times the enclosing block as section, nothing when profiler is NULL
+class ProfileScope
+{
+public:
+	ProfileScope(FrameProfiler* profiler, ProfileSection section) : profiler(profiler), section(section) {
+		if (profiler)
+			profiler->begin(section);
+	}
+	~ProfileScope() {
+		if (profiler)
+			profiler->end(section);
+	}
+
+private:
+	FrameProfiler* profiler;
+	ProfileSection section;
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include "GLAccounting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+static const char* CALL_NAMES[GL_CALL_COUNT] = {
+#define GL_CALL_NAME(ret, name, params, args) "gl" #name,
+	GL_TRACKED_CALLS(GL_CALL_NAME)
+	GL_COUNTED_CALLS(GL_CALL_NAME)
+#undef GL_CALL_NAME
+};
+
+// Relaxed atomics: any thread with a context may call GL
+static std::atomic<long long> callCounts[GL_CALL_COUNT];
+static std::atomic<long long> redundantBinds(0), filteredBinds(0), uploadBytes(0);
+static bool counting = false;
+static bool filtering = false;
+
+// The drivers' entry points, as glad had them before the wrappers went in
+#define GL_REAL_POINTER(ret, name, params, args) static decltype(glad_gl##name) real_##name = NULL;
+GL_TRACKED_CALLS(GL_REAL_POINTER)
+GL_COUNTED_CALLS(GL_REAL_POINTER)
+#undef GL_REAL_POINTER
+
+static inline void countCall(GLCall call)
+{
+	if (counting)
+		callCounts[call].fetch_add(1, std::memory_order_relaxed);
+}
+
+// STATE CACHE //
+
+// Bindings are context state and a context is current on one thread at a time
+static const GLuint UNKNOWN = 0xFFFFFFFFu;
+enum CachedTarget { CACHED_ARRAY, CACHED_ELEMENT_ARRAY, CACHED_PIXEL_PACK, CACHED_PIXEL_UNPACK, CACHED_COPY_READ, CACHED_COPY_WRITE, CACHED_UNIFORM, CACHED_TARGET_COUNT };
+
+struct StateCache {
+	GLuint program;
+	GLuint vertexArray;
+	GLuint buffers[CACHED_TARGET_COUNT];
+};
+static thread_local StateCache cache = { UNKNOWN, UNKNOWN, { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN } };
+
+// -1 for targets the cache leaves alone
+static int cachedTarget(GLenum target)
+{
+	switch (target) {
+		case GL_ARRAY_BUFFER: return CACHED_ARRAY;
+		case GL_ELEMENT_ARRAY_BUFFER: return CACHED_ELEMENT_ARRAY;
+		case GL_PIXEL_PACK_BUFFER: return CACHED_PIXEL_PACK;
+		case GL_PIXEL_UNPACK_BUFFER: return CACHED_PIXEL_UNPACK;
+		case GL_COPY_READ_BUFFER: return CACHED_COPY_READ;
+		case GL_COPY_WRITE_BUFFER: return CACHED_COPY_WRITE;
+		case GL_UNIFORM_BUFFER: return CACHED_UNIFORM;
+		default: return -1;
+	}
+}
+
+// Counts a bind of what is already bound, and says whether to skip it
+static bool redundant(GLuint &cached, GLuint value)
+{
+	if (cached != value) {
+		cached = value;
+		return false;
+	}
+	if (counting)
+		redundantBinds.fetch_add(1, std::memory_order_relaxed);
+	if (!filtering)
+		return false;
+	if (counting)
+		filteredBinds.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void invalidateGLStateCache()
+{
+	cache.program = UNKNOWN;
+	cache.vertexArray = UNKNOWN;
+	for (int i = 0; i < CACHED_TARGET_COUNT; i++)
+		cache.buffers[i] = UNKNOWN;
+}
+
+// TRACKED CALLS //
+
+static void APIENTRY tracked_UseProgram(GLuint program)
+{
+	countCall(GL_CALL_UseProgram);
+	if (!redundant(cache.program, program))
+		real_UseProgram(program);
+}
+
+static void APIENTRY tracked_BindVertexArray(GLuint array)
+{
+	countCall(GL_CALL_BindVertexArray);
+	if (redundant(cache.vertexArray, array))
+		return;
+	// The element array binding belongs to the VAO
+	cache.buffers[CACHED_ELEMENT_ARRAY] = UNKNOWN;
+	real_BindVertexArray(array);
+}
+
+static void APIENTRY tracked_BindBuffer(GLenum target, GLuint buffer)
+{
+	countCall(GL_CALL_BindBuffer);
+	int slot = cachedTarget(target);
+	if (slot >= 0 && redundant(cache.buffers[slot], buffer))
+		return;
+	real_BindBuffer(target, buffer);
+}
+
+static void APIENTRY tracked_DeleteProgram(GLuint program)
+{
+	countCall(GL_CALL_DeleteProgram);
+	// The name may come back for a new program, which then has to be bound for real
+	if (cache.program == program)
+		cache.program = UNKNOWN;
+	real_DeleteProgram(program);
+}
+
+static void APIENTRY tracked_DeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+	countCall(GL_CALL_DeleteVertexArrays);
+	// Deleting the bound VAO binds 0
+	for (GLsizei i = 0; i < n; i++) {
+		if (arrays[i] != 0 && cache.vertexArray == arrays[i]) {
+			cache.vertexArray = 0;
+			cache.buffers[CACHED_ELEMENT_ARRAY] = UNKNOWN;
+		}
+	}
+	real_DeleteVertexArrays(n, arrays);
+}
+
+static void APIENTRY tracked_DeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	countCall(GL_CALL_DeleteBuffers);
+	// Deleting a bound buffer binds 0 in its place
+	for (GLsizei i = 0; i < n; i++)
+		for (int t = 0; t < CACHED_TARGET_COUNT; t++)
+			if (buffers[i] != 0 && cache.buffers[t] == buffers[i])
+				cache.buffers[t] = 0;
+	real_DeleteBuffers(n, buffers);
+}
+
+static void APIENTRY tracked_BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	countCall(GL_CALL_BufferData);
+	if (counting && data)
+		uploadBytes.fetch_add((long long)size, std::memory_order_relaxed);
+	real_BufferData(target, size, data, usage);
+}
+
+static void APIENTRY tracked_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	countCall(GL_CALL_BufferSubData);
+	if (counting)
+		uploadBytes.fetch_add((long long)size, std::memory_order_relaxed);
+	real_BufferSubData(target, offset, size, data);
+}
+
+static void* APIENTRY tracked_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	countCall(GL_CALL_MapBufferRange);
+	// Whatever is written through the mapping is taken as written in full
+	if (counting && (access & GL_MAP_WRITE_BIT))
+		uploadBytes.fetch_add((long long)length, std::memory_order_relaxed);
+	return real_MapBufferRange(target, offset, length, access);
+}
+
+// COUNTED CALLS //
+
+#define GL_COUNTED_WRAPPER(ret, name, params, args) \
+	static ret APIENTRY counted_##name params \
+	{ \
+		countCall(GL_CALL_##name); \
+		return real_##name args; \
+	}
+GL_COUNTED_CALLS(GL_COUNTED_WRAPPER)
+#undef GL_COUNTED_WRAPPER
+
+// Swaps one glad pointer for its wrapper, unless it already is the wrapper
+#define GL_INSTALL(prefix, name) \
+	if (glad_gl##name != prefix##name) { \
+		real_##name = glad_gl##name; \
+		glad_gl##name = prefix##name; \
+	}
+
+void installGLAccounting(bool count, bool filter)
+{
+	counting = count;
+	filtering = filter;
+	invalidateGLStateCache();
+	if (!count && !filter)
+		return;
+	// The state cache needs every call that moves the bindings
+#define GL_INSTALL_TRACKED(ret, name, params, args) GL_INSTALL(tracked_, name)
+	GL_TRACKED_CALLS(GL_INSTALL_TRACKED)
+#undef GL_INSTALL_TRACKED
+	if (!count)
+		return;
+#define GL_INSTALL_COUNTED(ret, name, params, args) GL_INSTALL(counted_, name)
+	GL_COUNTED_CALLS(GL_INSTALL_COUNTED)
+#undef GL_INSTALL_COUNTED
+}
+
+GLCallStats::GLCallStats() : redundantBinds(0), filteredBinds(0), uploadBytes(0)
+{
+	for (int i = 0; i < GL_CALL_COUNT; i++)
+		calls[i] = 0;
+}
+
+long long GLCallStats::totalCalls() const
+{
+	long long total = 0;
+	for (int i = 0; i < GL_CALL_COUNT; i++)
+		total += calls[i];
+	return total;
+}
+
+GLCallStats GLCallStats::since(const GLCallStats & other) const
+{
+	GLCallStats delta;
+	for (int i = 0; i < GL_CALL_COUNT; i++)
+		delta.calls[i] = calls[i] - other.calls[i];
+	delta.redundantBinds = redundantBinds - other.redundantBinds;
+	delta.filteredBinds = filteredBinds - other.filteredBinds;
+	delta.uploadBytes = uploadBytes - other.uploadBytes;
+	return delta;
+}
+
+GLCallStats glCallStats()
+{
+	GLCallStats stats;
+	for (int i = 0; i < GL_CALL_COUNT; i++)
+		stats.calls[i] = callCounts[i].load(std::memory_order_relaxed);
+	stats.redundantBinds = redundantBinds.load(std::memory_order_relaxed);
+	stats.filteredBinds = filteredBinds.load(std::memory_order_relaxed);
+	stats.uploadBytes = uploadBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+const char* glCallName(GLCall call)
+{
+	return CALL_NAMES[call];
+}
+
+std::string formatGLCalls(const GLCallStats & stats, long long frames)
+{
+	double n = frames > 0 ? (double)frames : 1.0;
+	char line[256];
+	snprintf(line, sizeof(line), "GL per frame: %.1f calls, %.1f redundant binds (%.1f filtered), %.0f bytes uploaded",
+		stats.totalCalls() / n, stats.redundantBinds / n, stats.filteredBinds / n, stats.uploadBytes / n);
+	std::string text = line;
+
+	// The busiest entry points, most calls first
+	int order[GL_CALL_COUNT];
+	for (int i = 0; i < GL_CALL_COUNT; i++)
+		order[i] = i;
+	std::sort(order, order + GL_CALL_COUNT, [&](int a, int b) { return stats.calls[a] > stats.calls[b]; });
+	for (int i = 0; i < GL_CALL_COUNT && i < 8 && stats.calls[order[i]] > 0; i++) {
+		snprintf(line, sizeof(line), "\n  %-24s %.2f", CALL_NAMES[order[i]], stats.calls[order[i]] / n);
+		text += line;
+	}
+	return text;
+}
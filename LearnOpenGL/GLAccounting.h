@@ -0,0 +1,105 @@
+#ifndef GLACCOUNTING_H
+#define GLACCOUNTING_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+// An interception layer over glad: installGLAccounting() swaps glad's function
+// pointers for wrappers that count calls by entry point, binds of what was already
+// bound and bytes uploaded, and can drop those redundant binds.
+//
+// Every entry point the renderer uses is listed once, as X(return type, name
+// without the gl prefix, parameters, arguments). GL_COUNTED_CALLS get a generated
+// wrapper that only counts; GL_TRACKED_CALLS have hand-written ones in
+// GLAccounting.cpp because they change or depend on the cached bindings.
+#define GL_TRACKED_CALLS(X) \
+	X(void, UseProgram, (GLuint program), (program)) \
+	X(void, BindVertexArray, (GLuint array), (array)) \
+	X(void, BindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+	X(void, DeleteProgram, (GLuint program), (program)) \
+	X(void, DeleteVertexArrays, (GLsizei n, const GLuint *arrays), (n, arrays)) \
+	X(void, DeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers)) \
+	X(void, BufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage)) \
+	X(void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data)) \
+	X(void*, MapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access))
+
+#define GL_COUNTED_CALLS(X) \
+	X(void, Clear, (GLbitfield mask), (mask)) \
+	X(void, ClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha)) \
+	X(void, DrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count)) \
+	X(void, DrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount)) \
+	X(void, DrawElements, (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices)) \
+	X(GLint, GetUniformLocation, (GLuint program, const GLchar *name), (program, name)) \
+	X(void, Uniform1f, (GLint location, GLfloat v0), (location, v0)) \
+	X(void, Uniform1i, (GLint location, GLint v0), (location, v0)) \
+	X(void, Uniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2)) \
+	X(void, Uniform2fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+	X(void, Uniform3fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+	X(void, Uniform4fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+	X(void, UniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value)) \
+	X(void, UniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value)) \
+	X(void, Enable, (GLenum cap), (cap)) \
+	X(void, Disable, (GLenum cap), (cap)) \
+	X(void, BlendFuncSeparate, (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha), (sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha)) \
+	X(void, Viewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+	X(void, Scissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+	X(void, PixelStorei, (GLenum pname, GLint param), (pname, param)) \
+	X(void, VertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer)) \
+	X(void, EnableVertexAttribArray, (GLuint index), (index)) \
+	X(void, VertexAttribDivisor, (GLuint index, GLuint divisor), (index, divisor)) \
+	X(GLboolean, UnmapBuffer, (GLenum target), (target)) \
+	X(void, GenBuffers, (GLsizei n, GLuint *buffers), (n, buffers)) \
+	X(void, GenVertexArrays, (GLsizei n, GLuint *arrays), (n, arrays)) \
+	X(void, CompileShader, (GLuint shader), (shader)) \
+	X(void, LinkProgram, (GLuint program), (program)) \
+	X(void, ReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels), (x, y, width, height, format, type, pixels)) \
+	X(GLsync, FenceSync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+	X(GLenum, ClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout)) \
+	X(void, DeleteSync, (GLsync sync), (sync)) \
+	X(void, BeginQuery, (GLenum target, GLuint id), (target, id)) \
+	X(void, EndQuery, (GLenum target), (target)) \
+	X(void, GetQueryObjectiv, (GLuint id, GLenum pname, GLint *params), (id, pname, params)) \
+	X(void, GetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64 *params), (id, pname, params)) \
+	X(void, GetIntegerv, (GLenum pname, GLint *data), (pname, data)) \
+	X(GLenum, GetError, (void), ()) \
+	X(void, Finish, (void), ()) \
+	X(void, Flush, (void), ())
+
+enum GLCall {
+#define GL_CALL_ENUM(ret, name, params, args) GL_CALL_##name,
+	GL_TRACKED_CALLS(GL_CALL_ENUM)
+	GL_COUNTED_CALLS(GL_CALL_ENUM)
+#undef GL_CALL_ENUM
+	GL_CALL_COUNT
+};
+
+struct GLCallStats {
+	long long calls[GL_CALL_COUNT]; // made by the application, filtered ones included
+	long long redundantBinds;       // glUseProgram/glBindVertexArray/glBindBuffer of what was bound
+	long long filteredBinds;        // of those, dropped by the state cache
+	long long uploadBytes;          // glBufferData/glBufferSubData data and write-mapped ranges
+
+	GLCallStats();
+	long long totalCalls() const;
+	// Counts since other was taken
+	GLCallStats since(const GLCallStats &other) const;
+};
+
+// Call once glad is loaded and the context is current, and again after any later
+// gladLoadGLLoader. count counts every listed call; filter drops binds of what is
+// already bound (the per-thread state cache, so one context per thread). Either
+// may be off, and with both off nothing is installed.
+void installGLAccounting(bool count, bool filter);
+// The calling thread's cached bindings are forgotten, for when something changed
+// them behind the wrappers' back, e.g. another context was made current
+void invalidateGLStateCache();
+// Totals since installGLAccounting(), from every thread
+GLCallStats glCallStats();
+// "glDrawArrays" for GL_CALL_DrawArrays
+const char* glCallName(GLCall call);
+// Per frame averages: calls, redundant and filtered binds, uploaded bytes and the
+// busiest entry points
+std::string formatGLCalls(const GLCallStats &stats, long long frames);
+
+#endif
@@ -0,0 +1,97 @@
+#include "GLExt.h"
+
+#include <cstdio>
+#include <cstring>
+
+PFNGLEXTGETPROGRAMBINARYPROC glext_glGetProgramBinary = NULL;
+PFNGLEXTPROGRAMBINARYPROC glext_glProgramBinary = NULL;
+PFNGLEXTPROGRAMPARAMETERIPROC glext_glProgramParameteri = NULL;
+PFNGLEXTMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = NULL;
+PFNGLEXTCREATESHADERPROGRAMVPROC glext_glCreateShaderProgramv = NULL;
+PFNGLEXTGENPROGRAMPIPELINESPROC glext_glGenProgramPipelines = NULL;
+PFNGLEXTDELETEPROGRAMPIPELINESPROC glext_glDeleteProgramPipelines = NULL;
+PFNGLEXTBINDPROGRAMPIPELINEPROC glext_glBindProgramPipeline = NULL;
+PFNGLEXTUSEPROGRAMSTAGESPROC glext_glUseProgramStages = NULL;
+PFNGLEXTACTIVESHADERPROGRAMPROC glext_glActiveShaderProgram = NULL;
+PFNGLEXTVALIDATEPROGRAMPIPELINEPROC glext_glValidateProgramPipeline = NULL;
+PFNGLEXTGETPROGRAMPIPELINEIVPROC glext_glGetProgramPipelineiv = NULL;
+PFNGLEXTGETPROGRAMPIPELINEINFOLOGPROC glext_glGetProgramPipelineInfoLog = NULL;
+
+GLExtensions GLExt = {};
+
+static bool hasVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// Every GL 3.3 entry point anything in LearnOpenGL/ calls, the glext ones aside
+#define GL_USED_CALLS(X) \
+	X(AttachShader) X(BeginQuery) X(BindBuffer) X(BindFramebuffer) X(BindRenderbuffer) X(BindVertexArray) \
+	X(BlendFuncSeparate) X(BufferData) X(BufferSubData) X(CheckFramebufferStatus) X(Clear) X(ClearColor) \
+	X(ClientWaitSync) X(CompileShader) X(CreateProgram) X(CreateShader) X(DeleteBuffers) X(DeleteFramebuffers) \
+	X(DeleteProgram) X(DeleteQueries) X(DeleteRenderbuffers) X(DeleteShader) X(DeleteSync) X(DeleteVertexArrays) \
+	X(Disable) X(DrawArrays) X(DrawArraysInstanced) X(DrawElements) X(Enable) X(EnableVertexAttribArray) \
+	X(EndQuery) X(FenceSync) X(Finish) X(Flush) X(FramebufferRenderbuffer) X(GenBuffers) X(GenFramebuffers) \
+	X(GenQueries) X(GenRenderbuffers) X(GenVertexArrays) X(GetActiveUniform) X(GetError) X(GetFloatv) \
+	X(GetIntegerv) X(GetProgramInfoLog) X(GetProgramiv) X(GetQueryObjectiv) X(GetQueryObjectui64v) X(GetShaderInfoLog) \
+	X(GetShaderiv) X(GetString) X(GetStringi) X(GetUniformLocation) X(LinkProgram) X(MapBufferRange) \
+	X(PixelStorei) X(PolygonMode) X(ReadPixels) X(RenderbufferStorage) X(Scissor) X(ShaderSource) \
+	X(Uniform1f) X(Uniform1i) X(Uniform2fv) X(Uniform3fv) X(Uniform4fv) X(UniformMatrix3fv) \
+	X(UniformMatrix4fv) X(UnmapBuffer) X(UseProgram) X(VertexAttribDivisor) X(VertexAttribPointer) X(Viewport)
+
+bool loadGLCalls(GLADloadproc load)
+{
+#define GL_LOAD_CALL(name) glad_gl##name = (decltype(glad_gl##name))load("gl" #name);
+	GL_USED_CALLS(GL_LOAD_CALL)
+#undef GL_LOAD_CALL
+	// What gladLoadGLLoader would have found, e.g. "4.5 (Core Profile) Mesa 22.3.6"
+	const char* version = glad_glGetString ? (const char*)glGetString(GL_VERSION) : NULL;
+	if (!version || sscanf(version, "%d.%d", &GLVersion.major, &GLVersion.minor) != 2)
+		return false;
+	return hasVersion(3, 3);
+}
+
+bool hasGLExtension(const char * name)
+{
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext && strcmp(ext, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+void loadGLExtensions(GLADloadproc load)
+{
+	if (hasVersion(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+		glext_glGetProgramBinary = (PFNGLEXTGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+		glext_glProgramBinary = (PFNGLEXTPROGRAMBINARYPROC)load("glProgramBinary");
+		glext_glProgramParameteri = (PFNGLEXTPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+		// A driver may expose the entry points but offer no formats to save in
+		int formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		GLExt.programBinary = glext_glGetProgramBinary && glext_glProgramBinary && glext_glProgramParameteri && formats > 0;
+	}
+
+	if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLEXTMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+		GLExt.parallelShaderCompile = glext_glMaxShaderCompilerThreadsKHR != NULL;
+	}
+
+	if (hasVersion(4, 1) || hasGLExtension("GL_ARB_separate_shader_objects")) {
+		glext_glProgramParameteri = (PFNGLEXTPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+		glext_glCreateShaderProgramv = (PFNGLEXTCREATESHADERPROGRAMVPROC)load("glCreateShaderProgramv");
+		glext_glGenProgramPipelines = (PFNGLEXTGENPROGRAMPIPELINESPROC)load("glGenProgramPipelines");
+		glext_glDeleteProgramPipelines = (PFNGLEXTDELETEPROGRAMPIPELINESPROC)load("glDeleteProgramPipelines");
+		glext_glBindProgramPipeline = (PFNGLEXTBINDPROGRAMPIPELINEPROC)load("glBindProgramPipeline");
+		glext_glUseProgramStages = (PFNGLEXTUSEPROGRAMSTAGESPROC)load("glUseProgramStages");
+		glext_glActiveShaderProgram = (PFNGLEXTACTIVESHADERPROGRAMPROC)load("glActiveShaderProgram");
+		glext_glValidateProgramPipeline = (PFNGLEXTVALIDATEPROGRAMPIPELINEPROC)load("glValidateProgramPipeline");
+		glext_glGetProgramPipelineiv = (PFNGLEXTGETPROGRAMPIPELINEIVPROC)load("glGetProgramPipelineiv");
+		glext_glGetProgramPipelineInfoLog = (PFNGLEXTGETPROGRAMPIPELINEINFOLOGPROC)load("glGetProgramPipelineInfoLog");
+		GLExt.separateShaderObjects = glext_glCreateShaderProgramv && glext_glGenProgramPipelines && glext_glBindProgramPipeline
+			&& glext_glUseProgramStages && glext_glActiveShaderProgram && glext_glValidateProgramPipeline;
+	}
+}
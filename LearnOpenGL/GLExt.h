@@ -0,0 +1,88 @@
+#ifndef GLEXT_H
+#define GLEXT_H
+
+#include <glad/glad.h>
+
+// glad was generated for plain GL 3.3 core. Anything newer we can take advantage of
+// is resolved here, glad style, after gladLoadGLLoader. Pointers stay NULL and the
+// matching GLExt flag stays false when the driver does not expose the feature.
+
+// GL_ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+typedef void (APIENTRYP PFNGLEXTGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLEXTPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLEXTPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+extern PFNGLEXTGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLEXTPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLEXTPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+
+// GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLEXTMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+extern PFNGLEXTMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glext_glMaxShaderCompilerThreadsKHR
+
+// GL_ARB_separate_shader_objects (core in 4.1), glProgramParameteri is shared with the above
+#ifndef GL_PROGRAM_SEPARABLE
+#define GL_VERTEX_SHADER_BIT 0x00000001
+#define GL_FRAGMENT_SHADER_BIT 0x00000002
+#define GL_PROGRAM_SEPARABLE 0x8258
+#define GL_ACTIVE_PROGRAM 0x8259
+#define GL_PROGRAM_PIPELINE_BINDING 0x825A
+#endif
+typedef GLuint (APIENTRYP PFNGLEXTCREATESHADERPROGRAMVPROC)(GLenum type, GLsizei count, const GLchar *const*strings);
+typedef void (APIENTRYP PFNGLEXTGENPROGRAMPIPELINESPROC)(GLsizei n, GLuint *pipelines);
+typedef void (APIENTRYP PFNGLEXTDELETEPROGRAMPIPELINESPROC)(GLsizei n, const GLuint *pipelines);
+typedef void (APIENTRYP PFNGLEXTBINDPROGRAMPIPELINEPROC)(GLuint pipeline);
+typedef void (APIENTRYP PFNGLEXTUSEPROGRAMSTAGESPROC)(GLuint pipeline, GLbitfield stages, GLuint program);
+typedef void (APIENTRYP PFNGLEXTACTIVESHADERPROGRAMPROC)(GLuint pipeline, GLuint program);
+typedef void (APIENTRYP PFNGLEXTVALIDATEPROGRAMPIPELINEPROC)(GLuint pipeline);
+typedef void (APIENTRYP PFNGLEXTGETPROGRAMPIPELINEIVPROC)(GLuint pipeline, GLenum pname, GLint *params);
+typedef void (APIENTRYP PFNGLEXTGETPROGRAMPIPELINEINFOLOGPROC)(GLuint pipeline, GLsizei bufSize, GLsizei *length, GLchar *infoLog);
+extern PFNGLEXTCREATESHADERPROGRAMVPROC glext_glCreateShaderProgramv;
+extern PFNGLEXTGENPROGRAMPIPELINESPROC glext_glGenProgramPipelines;
+extern PFNGLEXTDELETEPROGRAMPIPELINESPROC glext_glDeleteProgramPipelines;
+extern PFNGLEXTBINDPROGRAMPIPELINEPROC glext_glBindProgramPipeline;
+extern PFNGLEXTUSEPROGRAMSTAGESPROC glext_glUseProgramStages;
+extern PFNGLEXTACTIVESHADERPROGRAMPROC glext_glActiveShaderProgram;
+extern PFNGLEXTVALIDATEPROGRAMPIPELINEPROC glext_glValidateProgramPipeline;
+extern PFNGLEXTGETPROGRAMPIPELINEIVPROC glext_glGetProgramPipelineiv;
+extern PFNGLEXTGETPROGRAMPIPELINEINFOLOGPROC glext_glGetProgramPipelineInfoLog;
+#define glCreateShaderProgramv glext_glCreateShaderProgramv
+#define glGenProgramPipelines glext_glGenProgramPipelines
+#define glDeleteProgramPipelines glext_glDeleteProgramPipelines
+#define glBindProgramPipeline glext_glBindProgramPipeline
+#define glUseProgramStages glext_glUseProgramStages
+#define glActiveShaderProgram glext_glActiveShaderProgram
+#define glValidateProgramPipeline glext_glValidateProgramPipeline
+#define glGetProgramPipelineiv glext_glGetProgramPipelineiv
+#define glGetProgramPipelineInfoLog glext_glGetProgramPipelineInfoLog
+
+struct GLExtensions {
+	bool programBinary;
+	bool parallelShaderCompile;
+	bool separateShaderObjects;
+};
+extern GLExtensions GLExt;
+
+// Instead of gladLoadGLLoader: resolves only the core entry points the app calls
+// (GL_USED_CALLS in GLExt.cpp) and sets GLVersion, leaving the rest of glad's
+// pointers NULL. False without a GL 3.3 context. A call missing from the list
+// crashes on its NULL pointer, so anything new the app calls goes in the list.
+bool loadGLCalls(GLADloadproc load);
+// Call once the context is current and glad (or loadGLCalls) is loaded
+void loadGLExtensions(GLADloadproc load);
+bool hasGLExtension(const char* name);
+
+#endif
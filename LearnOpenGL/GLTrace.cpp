@@ -0,0 +1,812 @@
+#include "GLTrace.h"
+#include "FrameProfiler.h"
+#include "GLExt.h"
+#include "Headless.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Every call a trace can hold. GL_TRACE_GENERIC calls are recorded argument by
+// argument and replayed from the types of glad's pointer, with one letter per
+// parameter saying how to replay it: upper case letters are object names, mapped
+// to the replaying driver's (P program, S shader, V vertex array, B buffer,
+// F framebuffer, R renderbuffer, Q query, Y fence), L is a uniform location of
+// the current program and o an output pointer, pointed at scratch memory on
+// replay. Other letters go through as recorded, pointers as buffer offsets.
+// GL_TRACE_SPECIAL calls carry payloads or create names and are written by hand.
+// New calls go at the end of a list, and TRACE_VERSION goes up.
+#define GL_TRACE_GENERIC(X) \
+	X(void, BindVertexArray, (GLuint array), (array), "V") \
+	X(void, BindBuffer, (GLenum target, GLuint buffer), (target, buffer), "eB") \
+	X(void, BindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer), "eF") \
+	X(void, BindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer), "eR") \
+	X(void, DeleteProgram, (GLuint program), (program), "P") \
+	X(void, DeleteShader, (GLuint shader), (shader), "S") \
+	X(void, AttachShader, (GLuint program, GLuint shader), (program, shader), "PS") \
+	X(void, CompileShader, (GLuint shader), (shader), "S") \
+	X(void, LinkProgram, (GLuint program), (program), "P") \
+	X(void, GetShaderiv, (GLuint shader, GLenum pname, GLint *params), (shader, pname, params), "Seo") \
+	X(void, GetProgramiv, (GLuint program, GLenum pname, GLint *params), (program, pname, params), "Peo") \
+	X(void, GetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (shader, bufSize, length, infoLog), "Sioo") \
+	X(void, GetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (program, bufSize, length, infoLog), "Pioo") \
+	X(void, GetActiveUniform, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name), (program, index, bufSize, length, size, type, name), "Puioooo") \
+	X(void, Clear, (GLbitfield mask), (mask), "e") \
+	X(void, ClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha), "ffff") \
+	X(void, DrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count), "eii") \
+	X(void, DrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount), "eiii") \
+	X(void, DrawElements, (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices), "eiep") \
+	X(void, Uniform1f, (GLint location, GLfloat v0), (location, v0), "Lf") \
+	X(void, Uniform1i, (GLint location, GLint v0), (location, v0), "Li") \
+	X(void, Uniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2), "Lfff") \
+	X(void, Enable, (GLenum cap), (cap), "e") \
+	X(void, Disable, (GLenum cap), (cap), "e") \
+	X(void, PolygonMode, (GLenum face, GLenum mode), (face, mode), "ee") \
+	X(void, BlendFuncSeparate, (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha), (sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha), "eeee") \
+	X(void, Viewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), "iiii") \
+	X(void, Scissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), "iiii") \
+	X(void, PixelStorei, (GLenum pname, GLint param), (pname, param), "ei") \
+	X(void, VertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer), "uiebip") \
+	X(void, EnableVertexAttribArray, (GLuint index), (index), "u") \
+	X(void, VertexAttribDivisor, (GLuint index, GLuint divisor), (index, divisor), "uu") \
+	X(void, RenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), (target, internalformat, width, height), "eeii") \
+	X(void, FramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), (target, attachment, renderbuffertarget, renderbuffer), "eeeR") \
+	X(GLenum, CheckFramebufferStatus, (GLenum target), (target), "e") \
+	X(GLenum, ClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout), "Yet") \
+	X(void, DeleteSync, (GLsync sync), (sync), "Y") \
+	X(void, BeginQuery, (GLenum target, GLuint id), (target, id), "eQ") \
+	X(void, EndQuery, (GLenum target), (target), "e") \
+	X(void, GetQueryObjectiv, (GLuint id, GLenum pname, GLint *params), (id, pname, params), "Qeo") \
+	X(void, GetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64 *params), (id, pname, params), "Qeo") \
+	X(void, GetIntegerv, (GLenum pname, GLint *data), (pname, data), "eo") \
+	X(void, GetFloatv, (GLenum pname, GLfloat *data), (pname, data), "eo") \
+	X(GLenum, GetError, (void), (), "") \
+	X(void, Finish, (void), (), "") \
+	X(void, Flush, (void), (), "")
+
+#define GL_TRACE_SPECIAL(X) \
+	X(void, UseProgram, (GLuint program), (program)) \
+	X(void, GenBuffers, (GLsizei n, GLuint *buffers), (n, buffers)) \
+	X(void, GenVertexArrays, (GLsizei n, GLuint *arrays), (n, arrays)) \
+	X(void, GenFramebuffers, (GLsizei n, GLuint *framebuffers), (n, framebuffers)) \
+	X(void, GenRenderbuffers, (GLsizei n, GLuint *renderbuffers), (n, renderbuffers)) \
+	X(void, GenQueries, (GLsizei n, GLuint *ids), (n, ids)) \
+	X(void, DeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers)) \
+	X(void, DeleteVertexArrays, (GLsizei n, const GLuint *arrays), (n, arrays)) \
+	X(void, DeleteFramebuffers, (GLsizei n, const GLuint *framebuffers), (n, framebuffers)) \
+	X(void, DeleteRenderbuffers, (GLsizei n, const GLuint *renderbuffers), (n, renderbuffers)) \
+	X(void, DeleteQueries, (GLsizei n, const GLuint *ids), (n, ids)) \
+	X(GLuint, CreateShader, (GLenum type), (type)) \
+	X(GLuint, CreateProgram, (void), ()) \
+	X(void, ShaderSource, (GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length), (shader, count, string, length)) \
+	X(GLint, GetUniformLocation, (GLuint program, const GLchar *name), (program, name)) \
+	X(void, Uniform2fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+	X(void, Uniform3fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+	X(void, Uniform4fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+	X(void, UniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value)) \
+	X(void, UniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value)) \
+	X(void, BufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage)) \
+	X(void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data)) \
+	X(void*, MapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+	X(GLboolean, UnmapBuffer, (GLenum target), (target)) \
+	X(GLsync, FenceSync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+	X(void, ReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels), (x, y, width, height, format, type, pixels))
+
+enum TraceCall {
+#define TRACE_CALL_GENERIC(ret, name, params, args, sig) TRACE_##name,
+#define TRACE_CALL_SPECIAL(ret, name, params, args) TRACE_##name,
+	GL_TRACE_GENERIC(TRACE_CALL_GENERIC)
+	GL_TRACE_SPECIAL(TRACE_CALL_SPECIAL)
+#undef TRACE_CALL_GENERIC
+#undef TRACE_CALL_SPECIAL
+	TRACE_FRAME,
+	TRACE_CALL_COUNT
+};
+
+static const char TRACE_MAGIC[8] = { 'S', 'G', 'L', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t TRACE_VERSION = 2;
+
+// RECORDING //
+
+// Only the thread that started the recording sees the file, calls from other
+// threads' contexts (the hot reload's compile context) pass through unrecorded
+static thread_local FILE* traceFile = NULL;
+
+// What glad pointed at before the recording wrappers went in
+#define TRACE_REAL_GENERIC(ret, name, params, args, sig) static decltype(glad_gl##name) traceReal_##name = NULL;
+#define TRACE_REAL_SPECIAL(ret, name, params, args) static decltype(glad_gl##name) traceReal_##name = NULL;
+GL_TRACE_GENERIC(TRACE_REAL_GENERIC)
+GL_TRACE_SPECIAL(TRACE_REAL_SPECIAL)
+#undef TRACE_REAL_GENERIC
+#undef TRACE_REAL_SPECIAL
+
+// Values as their bytes, pointers as 64-bit numbers
+template<typename T> static void put(T value)
+{
+	static_assert(std::is_arithmetic<T>::value, "only numbers and pointers are recorded as they are");
+	if (traceFile)
+		fwrite(&value, sizeof(T), 1, traceFile);
+}
+
+template<typename T> static void put(T* value)
+{
+	uint64_t number = (uint64_t)(uintptr_t)value;
+	if (traceFile)
+		fwrite(&number, sizeof(number), 1, traceFile);
+}
+
+static void putArgs()
+{
+}
+
+template<typename T, typename... Rest> static void putArgs(T first, Rest... rest)
+{
+	put(first);
+	putArgs(rest...);
+}
+
+static void putCall(TraceCall call)
+{
+	put((uint16_t)call);
+}
+
+static void putBytes(const void* data, size_t size)
+{
+	put((uint64_t)size);
+	if (traceFile && size > 0)
+		fwrite(data, 1, size, traceFile);
+}
+
+static void putNames(GLsizei n, const GLuint* names)
+{
+	put(n);
+	if (traceFile)
+		fwrite(names, sizeof(GLuint), n, traceFile);
+}
+
+#define TRACE_GENERIC_WRAPPER(ret, name, params, args, sig) \
+	static ret APIENTRY traced_##name params \
+	{ \
+		putCall(TRACE_##name); \
+		putArgs args; \
+		return traceReal_##name args; \
+	}
+GL_TRACE_GENERIC(TRACE_GENERIC_WRAPPER)
+#undef TRACE_GENERIC_WRAPPER
+
+static void APIENTRY traced_UseProgram(GLuint program)
+{
+	putCall(TRACE_UseProgram);
+	put(program);
+	traceReal_UseProgram(program);
+}
+
+// Names are recorded after the driver made them
+#define TRACE_GEN_WRAPPER(name) \
+	static void APIENTRY traced_##name(GLsizei n, GLuint *names) \
+	{ \
+		traceReal_##name(n, names); \
+		putCall(TRACE_##name); \
+		putNames(n, names); \
+	}
+TRACE_GEN_WRAPPER(GenBuffers)
+TRACE_GEN_WRAPPER(GenVertexArrays)
+TRACE_GEN_WRAPPER(GenFramebuffers)
+TRACE_GEN_WRAPPER(GenRenderbuffers)
+TRACE_GEN_WRAPPER(GenQueries)
+#undef TRACE_GEN_WRAPPER
+
+#define TRACE_DELETE_WRAPPER(name) \
+	static void APIENTRY traced_##name(GLsizei n, const GLuint *names) \
+	{ \
+		putCall(TRACE_##name); \
+		putNames(n, names); \
+		traceReal_##name(n, names); \
+	}
+TRACE_DELETE_WRAPPER(DeleteBuffers)
+TRACE_DELETE_WRAPPER(DeleteVertexArrays)
+TRACE_DELETE_WRAPPER(DeleteFramebuffers)
+TRACE_DELETE_WRAPPER(DeleteRenderbuffers)
+TRACE_DELETE_WRAPPER(DeleteQueries)
+#undef TRACE_DELETE_WRAPPER
+
+static GLuint APIENTRY traced_CreateShader(GLenum type)
+{
+	GLuint shader = traceReal_CreateShader(type);
+	putCall(TRACE_CreateShader);
+	putArgs(type, shader);
+	return shader;
+}
+
+static GLuint APIENTRY traced_CreateProgram()
+{
+	GLuint program = traceReal_CreateProgram();
+	putCall(TRACE_CreateProgram);
+	put(program);
+	return program;
+}
+
+static void APIENTRY traced_ShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length)
+{
+	putCall(TRACE_ShaderSource);
+	putArgs(shader, count);
+	for (GLsizei i = 0; i < count; i++)
+		putBytes(string[i], length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]));
+	traceReal_ShaderSource(shader, count, string, length);
+}
+
+static GLint APIENTRY traced_GetUniformLocation(GLuint program, const GLchar *name)
+{
+	GLint location = traceReal_GetUniformLocation(program, name);
+	putCall(TRACE_GetUniformLocation);
+	put(program);
+	putBytes(name, strlen(name));
+	put(location);
+	return location;
+}
+
+#define TRACE_UNIFORM_VECTOR_WRAPPER(name, components) \
+	static void APIENTRY traced_##name(GLint location, GLsizei count, const GLfloat *value) \
+	{ \
+		putCall(TRACE_##name); \
+		putArgs(location, count); \
+		putBytes(value, (size_t)count * components * sizeof(GLfloat)); \
+		traceReal_##name(location, count, value); \
+	}
+TRACE_UNIFORM_VECTOR_WRAPPER(Uniform2fv, 2)
+TRACE_UNIFORM_VECTOR_WRAPPER(Uniform3fv, 3)
+TRACE_UNIFORM_VECTOR_WRAPPER(Uniform4fv, 4)
+#undef TRACE_UNIFORM_VECTOR_WRAPPER
+
+#define TRACE_UNIFORM_MATRIX_WRAPPER(name, components) \
+	static void APIENTRY traced_##name(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) \
+	{ \
+		putCall(TRACE_##name); \
+		putArgs(location, count, transpose); \
+		putBytes(value, (size_t)count * components * sizeof(GLfloat)); \
+		traceReal_##name(location, count, transpose, value); \
+	}
+TRACE_UNIFORM_MATRIX_WRAPPER(UniformMatrix3fv, 9)
+TRACE_UNIFORM_MATRIX_WRAPPER(UniformMatrix4fv, 16)
+#undef TRACE_UNIFORM_MATRIX_WRAPPER
+
+static void APIENTRY traced_BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	putCall(TRACE_BufferData);
+	putArgs(target, size, usage, (uint8_t)(data != NULL));
+	if (data)
+		putBytes(data, (size_t)size);
+	traceReal_BufferData(target, size, data, usage);
+}
+
+static void APIENTRY traced_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	putCall(TRACE_BufferSubData);
+	putArgs(target, offset);
+	putBytes(data, (size_t)size);
+	traceReal_BufferSubData(target, offset, size, data);
+}
+
+// Write mappings by target: what the app wrote is recorded when it unmaps
+struct RecordedMapping {
+	void* pointer;
+	size_t length;
+};
+static thread_local std::unordered_map<GLenum, RecordedMapping> recordedMappings;
+
+static void* APIENTRY traced_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	putCall(TRACE_MapBufferRange);
+	putArgs(target, offset, length, access);
+	void* pointer = traceReal_MapBufferRange(target, offset, length, access);
+	RecordedMapping mapping = { (access & GL_MAP_WRITE_BIT) ? pointer : NULL, (size_t)length };
+	recordedMappings[target] = mapping;
+	return pointer;
+}
+
+static GLboolean APIENTRY traced_UnmapBuffer(GLenum target)
+{
+	RecordedMapping mapping = recordedMappings[target];
+	recordedMappings.erase(target);
+	putCall(TRACE_UnmapBuffer);
+	put(target);
+	put((uint8_t)(mapping.pointer != NULL));
+	if (mapping.pointer)
+		putBytes(mapping.pointer, mapping.length);
+	return traceReal_UnmapBuffer(target);
+}
+
+static GLsync APIENTRY traced_FenceSync(GLenum condition, GLbitfield flags)
+{
+	GLsync sync = traceReal_FenceSync(condition, flags);
+	putCall(TRACE_FenceSync);
+	putArgs(condition, flags, sync);
+	return sync;
+}
+
+static void APIENTRY traced_ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+{
+	// Into a pack buffer pixels is an offset, into memory the replay needs room
+	GLint packBuffer = 0;
+	if (traceFile)
+		traceReal_GetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+	putCall(TRACE_ReadPixels);
+	putArgs(x, y, width, height, format, type, pixels, (uint8_t)(packBuffer != 0));
+	traceReal_ReadPixels(x, y, width, height, format, type, pixels);
+}
+
+bool startGLTrace(const char * path, int width, int height)
+{
+	traceFile = fopen(path, "wb");
+	if (!traceFile) {
+		std::cout << "ERROR::GLTRACE::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	setvbuf(traceFile, NULL, _IOFBF, 1 << 20);
+	fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), traceFile);
+	putArgs(TRACE_VERSION, (uint32_t)TRACE_CALL_COUNT, width, height);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	putBytes(renderer ? renderer : "", renderer ? strlen(renderer) : 0);
+
+	// Core 3.3 only, nothing a different driver might not load
+	GLExt.programBinary = false;
+	GLExt.separateShaderObjects = false;
+	GLExt.parallelShaderCompile = false;
+
+#define TRACE_INSTALL(ret, name, ...) \
+	if (glad_gl##name != traced_##name) { \
+		traceReal_##name = glad_gl##name; \
+		glad_gl##name = traced_##name; \
+	}
+	GL_TRACE_GENERIC(TRACE_INSTALL)
+	GL_TRACE_SPECIAL(TRACE_INSTALL)
+#undef TRACE_INSTALL
+	return true;
+}
+
+void glTraceFrame()
+{
+	if (traceFile)
+		putCall(TRACE_FRAME);
+}
+
+void stopGLTrace()
+{
+	if (!traceFile)
+		return;
+#define TRACE_UNINSTALL(ret, name, ...) \
+	if (glad_gl##name == traced_##name) \
+		glad_gl##name = traceReal_##name;
+	GL_TRACE_GENERIC(TRACE_UNINSTALL)
+	GL_TRACE_SPECIAL(TRACE_UNINSTALL)
+#undef TRACE_UNINSTALL
+	if (fclose(traceFile) != 0)
+		std::cout << "ERROR::GLTRACE::WRITE_FAILED" << std::endl;
+	traceFile = NULL;
+}
+
+// REPLAY //
+
+class TraceReader
+{
+public:
+	bool ok;
+
+	TraceReader(FILE* file) : ok(true), file(file) {}
+
+	bool read(void* data, size_t size) {
+		if (size > 0 && fread(data, 1, size, file) != size)
+			ok = false;
+		return ok;
+	}
+	template<typename T> T get() {
+		return get<T>(std::is_pointer<T>());
+	}
+	// Into bytes, which stays valid until the next call
+	const char* getBytes(std::vector<char> &bytes, uint64_t* size = NULL) {
+		uint64_t length = get<uint64_t>();
+		if (!ok || length > (1ull << 40)) {
+			ok = false;
+			return NULL;
+		}
+		bytes.resize((size_t)length + 1);
+		read(&bytes[0], (size_t)length);
+		bytes[(size_t)length] = '\0';
+		if (size)
+			*size = length;
+		return &bytes[0];
+	}
+
+private:
+	FILE* file;
+
+	template<typename T> T get(std::false_type) {
+		T value = T();
+		read(&value, sizeof(T));
+		return value;
+	}
+	template<typename T> T get(std::true_type) {
+		uint64_t number = 0;
+		read(&number, sizeof(number));
+		return (T)(uintptr_t)number;
+	}
+};
+
+enum NameKind { NAME_PROGRAM, NAME_SHADER, NAME_VERTEX_ARRAY, NAME_BUFFER, NAME_FRAMEBUFFER, NAME_RENDERBUFFER, NAME_QUERY, NAME_KIND_COUNT };
+
+// Recorded names and handles to the replaying driver's
+class ReplayState
+{
+public:
+	GLuint program;            // current, replay name
+	GLuint defaultFramebuffer; // what framebuffer 0 draws to
+	std::vector<char> scratch, bytes;
+	std::unordered_map<GLenum, void*> mappings;
+
+	ReplayState(GLuint defaultFramebuffer) : program(0), defaultFramebuffer(defaultFramebuffer), scratch(1 << 20) {}
+
+	GLuint name(NameKind kind, GLuint recorded) {
+		if (recorded == 0)
+			return kind == NAME_FRAMEBUFFER ? defaultFramebuffer : 0;
+		std::unordered_map<GLuint, GLuint>::iterator it = names[kind].find(recorded);
+		return it == names[kind].end() ? recorded : it->second;
+	}
+	void setName(NameKind kind, GLuint recorded, GLuint replayed) {
+		names[kind][recorded] = replayed;
+	}
+	void forgetName(NameKind kind, GLuint recorded) {
+		names[kind].erase(recorded);
+	}
+	GLint location(GLint recorded) {
+		if (recorded < 0)
+			return recorded;
+		std::unordered_map<uint64_t, GLint>::iterator it = locations.find(locationKey(program, recorded));
+		return it == locations.end() ? recorded : it->second;
+	}
+	void setLocation(GLuint replayProgram, GLint recorded, GLint replayed) {
+		locations[locationKey(replayProgram, recorded)] = replayed;
+	}
+	GLsync sync(GLsync recorded) {
+		std::unordered_map<uint64_t, GLsync>::iterator it = syncs.find((uint64_t)(uintptr_t)recorded);
+		return it == syncs.end() ? NULL : it->second;
+	}
+	void setSync(GLsync recorded, GLsync replayed) {
+		syncs[(uint64_t)(uintptr_t)recorded] = replayed;
+	}
+
+	// One recorded argument as the replay passes it, by its signature letter
+	template<typename T> T map(T value, char) {
+		return value;
+	}
+	GLuint map(GLuint value, char kind) {
+		switch (kind) {
+			case 'P': return name(NAME_PROGRAM, value);
+			case 'S': return name(NAME_SHADER, value);
+			case 'V': return name(NAME_VERTEX_ARRAY, value);
+			case 'B': return name(NAME_BUFFER, value);
+			case 'F': return name(NAME_FRAMEBUFFER, value);
+			case 'R': return name(NAME_RENDERBUFFER, value);
+			case 'Q': return name(NAME_QUERY, value);
+			default: return value;
+		}
+	}
+	GLint map(GLint value, char kind) {
+		return kind == 'L' ? location(value) : value;
+	}
+	GLsync map(GLsync value, char kind) {
+		return kind == 'Y' ? sync(value) : value;
+	}
+	template<typename T> T* map(T* value, char kind) {
+		return kind == 'o' ? (T*)&scratch[0] : value;
+	}
+
+private:
+	std::unordered_map<GLuint, GLuint> names[NAME_KIND_COUNT];
+	std::unordered_map<uint64_t, GLint> locations;
+	std::unordered_map<uint64_t, GLsync> syncs;
+
+	static uint64_t locationKey(GLuint program, GLint location) {
+		return ((uint64_t)program << 32) | (uint32_t)location;
+	}
+};
+
+// Reads fn's arguments by their types and calls it with them mapped. A braced list
+// evaluates left to right, so the arguments are read in order.
+template<typename R, typename... A, size_t... I>
+static void replayCall(R (APIENTRYP fn)(A...), const char* signature, TraceReader &in, ReplayState &state, std::index_sequence<I...>)
+{
+	std::tuple<A...> args{ in.get<A>()... };
+	if (in.ok)
+		fn(state.map(std::get<I>(args), signature[I])...);
+}
+
+template<typename R, typename... A>
+static void replayCall(R (APIENTRYP fn)(A...), const char* signature, TraceReader &in, ReplayState &state)
+{
+	replayCall(fn, signature, in, state, std::index_sequence_for<A...>());
+}
+
+static void replayGen(void (APIENTRYP gen)(GLsizei, GLuint*), NameKind kind, TraceReader &in, ReplayState &state)
+{
+	GLsizei n = in.get<GLsizei>();
+	if (!in.ok || n < 0)
+		return;
+	std::vector<GLuint> recorded(n), replayed(n);
+	in.read(recorded.data(), n * sizeof(GLuint));
+	gen(n, replayed.data());
+	for (GLsizei i = 0; i < n; i++)
+		state.setName(kind, recorded[i], replayed[i]);
+}
+
+static void replayDelete(void (APIENTRYP destroy)(GLsizei, const GLuint*), NameKind kind, TraceReader &in, ReplayState &state)
+{
+	GLsizei n = in.get<GLsizei>();
+	if (!in.ok || n < 0)
+		return;
+	std::vector<GLuint> names(n);
+	in.read(names.data(), n * sizeof(GLuint));
+	for (GLsizei i = 0; i < n; i++) {
+		GLuint recorded = names[i];
+		names[i] = state.name(kind, recorded);
+		state.forgetName(kind, recorded);
+	}
+	destroy(n, names.data());
+}
+
+// Replays one special call, false when id is not one
+static bool replaySpecial(uint16_t id, TraceReader &in, ReplayState &state)
+{
+	switch (id) {
+		case TRACE_UseProgram:
+			state.program = state.name(NAME_PROGRAM, in.get<GLuint>());
+			glUseProgram(state.program);
+			break;
+		case TRACE_GenBuffers: replayGen(glad_glGenBuffers, NAME_BUFFER, in, state);
+			break;
+		case TRACE_GenVertexArrays: replayGen(glad_glGenVertexArrays, NAME_VERTEX_ARRAY, in, state);
+			break;
+		case TRACE_GenFramebuffers: replayGen(glad_glGenFramebuffers, NAME_FRAMEBUFFER, in, state);
+			break;
+		case TRACE_GenRenderbuffers: replayGen(glad_glGenRenderbuffers, NAME_RENDERBUFFER, in, state);
+			break;
+		case TRACE_GenQueries: replayGen(glad_glGenQueries, NAME_QUERY, in, state);
+			break;
+		case TRACE_DeleteBuffers: replayDelete(glad_glDeleteBuffers, NAME_BUFFER, in, state);
+			break;
+		case TRACE_DeleteVertexArrays: replayDelete(glad_glDeleteVertexArrays, NAME_VERTEX_ARRAY, in, state);
+			break;
+		case TRACE_DeleteFramebuffers: replayDelete(glad_glDeleteFramebuffers, NAME_FRAMEBUFFER, in, state);
+			break;
+		case TRACE_DeleteRenderbuffers: replayDelete(glad_glDeleteRenderbuffers, NAME_RENDERBUFFER, in, state);
+			break;
+		case TRACE_DeleteQueries: replayDelete(glad_glDeleteQueries, NAME_QUERY, in, state);
+			break;
+		case TRACE_CreateShader: {
+			GLenum type = in.get<GLenum>();
+			GLuint recorded = in.get<GLuint>();
+			state.setName(NAME_SHADER, recorded, glCreateShader(type));
+			break;
+		}
+		case TRACE_CreateProgram:
+			state.setName(NAME_PROGRAM, in.get<GLuint>(), glCreateProgram());
+			break;
+		case TRACE_ShaderSource: {
+			GLuint shader = state.name(NAME_SHADER, in.get<GLuint>());
+			GLsizei count = in.get<GLsizei>();
+			if (!in.ok || count < 0)
+				break;
+			std::vector<std::vector<char> > sources(count);
+			std::vector<const GLchar*> strings(count);
+			std::vector<GLint> lengths(count);
+			for (GLsizei i = 0; i < count; i++) {
+				uint64_t length = 0;
+				strings[i] = in.getBytes(sources[i], &length);
+				lengths[i] = (GLint)length;
+			}
+			if (in.ok)
+				glShaderSource(shader, count, strings.data(), lengths.data());
+			break;
+		}
+		case TRACE_GetUniformLocation: {
+			GLuint program = state.name(NAME_PROGRAM, in.get<GLuint>());
+			const char* name = in.getBytes(state.bytes);
+			GLint recorded = in.get<GLint>();
+			if (in.ok)
+				state.setLocation(program, recorded, glGetUniformLocation(program, name));
+			break;
+		}
+		case TRACE_Uniform2fv:
+		case TRACE_Uniform3fv:
+		case TRACE_Uniform4fv: {
+			GLint location = state.location(in.get<GLint>());
+			GLsizei count = in.get<GLsizei>();
+			const GLfloat* value = (const GLfloat*)in.getBytes(state.bytes);
+			if (!in.ok)
+				break;
+			if (id == TRACE_Uniform2fv)
+				glUniform2fv(location, count, value);
+			else if (id == TRACE_Uniform3fv)
+				glUniform3fv(location, count, value);
+			else
+				glUniform4fv(location, count, value);
+			break;
+		}
+		case TRACE_UniformMatrix3fv:
+		case TRACE_UniformMatrix4fv: {
+			GLint location = state.location(in.get<GLint>());
+			GLsizei count = in.get<GLsizei>();
+			GLboolean transpose = in.get<GLboolean>();
+			const GLfloat* value = (const GLfloat*)in.getBytes(state.bytes);
+			if (!in.ok)
+				break;
+			if (id == TRACE_UniformMatrix3fv)
+				glUniformMatrix3fv(location, count, transpose, value);
+			else
+				glUniformMatrix4fv(location, count, transpose, value);
+			break;
+		}
+		case TRACE_BufferData: {
+			GLenum target = in.get<GLenum>();
+			GLsizeiptr size = in.get<GLsizeiptr>();
+			GLenum usage = in.get<GLenum>();
+			bool hasData = in.get<uint8_t>() != 0;
+			const void* data = hasData ? in.getBytes(state.bytes) : NULL;
+			if (in.ok)
+				glBufferData(target, size, data, usage);
+			break;
+		}
+		case TRACE_BufferSubData: {
+			GLenum target = in.get<GLenum>();
+			GLintptr offset = in.get<GLintptr>();
+			uint64_t size = 0;
+			const void* data = in.getBytes(state.bytes, &size);
+			if (in.ok)
+				glBufferSubData(target, offset, (GLsizeiptr)size, data);
+			break;
+		}
+		case TRACE_MapBufferRange: {
+			GLenum target = in.get<GLenum>();
+			GLintptr offset = in.get<GLintptr>();
+			GLsizeiptr length = in.get<GLsizeiptr>();
+			GLbitfield access = in.get<GLbitfield>();
+			if (in.ok)
+				state.mappings[target] = glMapBufferRange(target, offset, length, access);
+			break;
+		}
+		case TRACE_UnmapBuffer: {
+			GLenum target = in.get<GLenum>();
+			bool written = in.get<uint8_t>() != 0;
+			uint64_t size = 0;
+			const void* data = written ? in.getBytes(state.bytes, &size) : NULL;
+			if (!in.ok)
+				break;
+			void* pointer = state.mappings[target];
+			if (pointer && data)
+				memcpy(pointer, data, (size_t)size);
+			state.mappings.erase(target);
+			glUnmapBuffer(target);
+			break;
+		}
+		case TRACE_FenceSync: {
+			GLenum condition = in.get<GLenum>();
+			GLbitfield flags = in.get<GLbitfield>();
+			GLsync recorded = in.get<GLsync>();
+			if (in.ok)
+				state.setSync(recorded, glFenceSync(condition, flags));
+			break;
+		}
+		case TRACE_ReadPixels: {
+			GLint x = in.get<GLint>(), y = in.get<GLint>();
+			GLsizei width = in.get<GLsizei>(), height = in.get<GLsizei>();
+			GLenum format = in.get<GLenum>(), type = in.get<GLenum>();
+			void* pixels = in.get<void*>();
+			bool toBuffer = in.get<uint8_t>() != 0;
+			if (!in.ok || width < 0 || height < 0)
+				break;
+			if (!toBuffer) {
+				// Room for 4 floats a pixel, the most any format here needs
+				state.bytes.resize((size_t)width * height * 16 + 1);
+				pixels = &state.bytes[0];
+			}
+			glReadPixels(x, y, width, height, format, type, pixels);
+			break;
+		}
+		default:
+			return false;
+	}
+	return true;
+}
+
+int runGLReplay(const char * path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		std::cout << "ERROR::GLTRACE::FILE_NOT_FOUND " << path << std::endl;
+		return 1;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+	TraceReader in(file);
+	char magic[sizeof(TRACE_MAGIC)];
+	in.read(magic, sizeof(magic));
+	uint32_t version = in.get<uint32_t>();
+	uint32_t callCount = in.get<uint32_t>();
+	int width = in.get<int>();
+	int height = in.get<int>();
+	std::vector<char> rendererBytes;
+	const char* recordedOn = in.ok ? in.getBytes(rendererBytes) : NULL;
+	if (!in.ok || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || version != TRACE_VERSION || callCount != TRACE_CALL_COUNT) {
+		std::cout << "ERROR::GLTRACE::INCOMPATIBLE_TRACE " << path << " (not a trace, or from another build)" << std::endl;
+		fclose(file);
+		return 1;
+	}
+
+	HeadlessContext context(width, height);
+	if (!context.ok) {
+		fclose(file);
+		return 1;
+	}
+	ReplayState state(context.FBO);
+	TimingHistogram frameTimes;
+	long long calls = 0;
+	double setupMs = -1.0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(), frameStart = start;
+	for (;;) {
+		uint16_t id;
+		if (fread(&id, sizeof(id), 1, file) != 1)
+			break;
+		if (id == TRACE_FRAME) {
+			// The frame is done when the GPU is
+			glFinish();
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(now - frameStart).count();
+			// The first frame creates the shaders and buffers, it is setup and not a frame
+			if (setupMs < 0.0)
+				setupMs = ms;
+			else
+				frameTimes.add(ms);
+			frameStart = now;
+			continue;
+		}
+		switch (id) {
+#define TRACE_REPLAY_GENERIC(ret, name, params, args, sig) \
+			case TRACE_##name: replayCall(glad_gl##name, sig, in, state); \
+				break;
+			GL_TRACE_GENERIC(TRACE_REPLAY_GENERIC)
+#undef TRACE_REPLAY_GENERIC
+			default:
+				if (!replaySpecial(id, in, state)) {
+					std::cout << "ERROR::GLTRACE::BAD_RECORD " << id << " after " << calls << " calls" << std::endl;
+					fclose(file);
+					return 1;
+				}
+				break;
+		}
+		if (!in.ok) {
+			std::cout << "ERROR::GLTRACE::TRUNCATED after " << calls << " calls" << std::endl;
+			fclose(file);
+			return 1;
+		}
+		calls++;
+	}
+	glFinish();
+	fclose(file);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Replayed " << calls << " calls and " << frameTimes.count + (setupMs < 0.0 ? 0 : 1) << " frames of " << path << " (" << width << "x" << height
+		<< ") in " << seconds << " s" << std::endl
+		<< "  recorded on: " << recordedOn << std::endl
+		<< "  replayed on: " << (const char*)glGetString(GL_RENDERER) << ", " << (const char*)glGetString(GL_VERSION) << std::endl;
+	if (frameTimes.count > 0) {
+		std::cout << "  setup and first frame " << setupMs << " ms, then frame mean " << frameTimes.mean() << " ms, p50/p95/p99 "
+			<< frameTimes.percentile(0.5) << "/" << frameTimes.percentile(0.95) << "/" << frameTimes.percentile(0.99) << " ms, "
+			<< 1000.0 / frameTimes.mean() << " fps" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef GLTRACE_H
+#define GLTRACE_H
+
+// Records every GL call the renderer makes through glad into a compact binary trace,
+// buffer and uniform payloads included, and replays it on the headless context, so a
+// performance problem can be reproduced and timed without the app: bisecting a Mesa
+// regression, or one llvmpipe against another on exactly the same commands.
+//
+// Recording swaps glad's pointers for recording wrappers, like GLAccounting (the
+// two chain). A trace holds core GL 3.3 only, so program binaries, separable programs
+// and parallel compile are turned off in GLExt while recording. Object names, uniform
+// locations and fences are mapped to what the replaying driver hands out, and the
+// default framebuffer becomes the headless FBO. Only the thread that starts the
+// recording is recorded, and it has to stop it too: whatever would make GL calls on a
+// shared context elsewhere (shader reloads, mesh uploads) has to stay on that thread.
+// Traces are tied to the build's list of calls and to 64-bit pointers.
+//
+//   Sierpinski --gltrace frames.gltrace --frames 300
+//   sierpinski_replay frames.gltrace
+
+// Starts recording into path, for a window of width x height. Needs the context
+// current and glad loaded.
+bool startGLTrace(const char* path, int width, int height);
+// Marks the end of a frame, after the swap. Nothing when not recording.
+void glTraceFrame();
+// Puts the drivers' entry points back and closes the trace
+void stopGLTrace();
+
+// Replays a trace as fast as it goes, glFinish() ending every frame, and prints the
+// first frame's time (which creates everything) and the other frames' percentiles.
+// Returns the process exit code.
+int runGLReplay(const char* path);
+
+#endif
@@ -0,0 +1,207 @@
+#include "Headless.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include "FrameCapture.h"
+#include "VideoStream.h"
+#include "GLExt.h"
+#include "Renderer.h"
+#include "ShaderLibrary.h"
+
+#ifdef __linux__
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+
+static bool hasEGLExtension(EGLDisplay display, const char* name)
+{
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (!extensions)
+		return false;
+	size_t length = strlen(name);
+	for (const char* p = strstr(extensions, name); p; p = strstr(p + length, name)) {
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+			return true;
+	}
+	return false;
+}
+
+static EGLDisplay openDisplay()
+{
+	// Surfaceless needs no X/Wayland/GBM device at all, which is what a farm node has
+	if (hasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay) {
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+				return display;
+		}
+	}
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+		return display;
+	return EGL_NO_DISPLAY;
+}
+
+HeadlessContext::HeadlessContext(int width, int height)
+	: ok(false), width(width), height(height), FBO(0), colorBuffer(0), display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE)
+{
+	display = openDisplay();
+	if (display == EGL_NO_DISPLAY) {
+		std::cout << "Failed to open an EGL display" << std::endl;
+		return;
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &configs) || configs == 0) {
+		std::cout << "Failed to find an EGL config" << std::endl;
+		return;
+	}
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT) {
+		std::cout << "Failed to create EGL context" << std::endl;
+		return;
+	}
+
+	// We only ever draw into the FBO, so skip the surface when EGL lets us
+	if (!hasEGLExtension(display, "EGL_KHR_surfaceless_context")) {
+		const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+	}
+	if (!eglMakeCurrent(display, surface, surface, context)) {
+		std::cout << "Failed to make the EGL context current" << std::endl;
+		return;
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return;
+	}
+	loadGLExtensions((GLADloadproc)eglGetProcAddress);
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		return;
+	}
+	glViewport(0, 0, width, height);
+	ok = true;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	if (display == EGL_NO_DISPLAY)
+		return;
+	if (FBO) {
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(1, &colorBuffer);
+	}
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != EGL_NO_SURFACE)
+		eglDestroySurface(display, surface);
+	if (context != EGL_NO_CONTEXT)
+		eglDestroyContext(display, context);
+	eglTerminate(display);
+}
+#else
+HeadlessContext::HeadlessContext(int width, int height)
+	: ok(false), width(width), height(height), FBO(0), colorBuffer(0), display(NULL), context(NULL), surface(NULL)
+{
+	std::cout << "Headless rendering needs EGL and is only built on Linux" << std::endl;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+}
+#endif
+
+void HeadlessContext::readPixels(Image & image)
+{
+	if (image.width != width || image.height != height)
+		image = Image(width, height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &image.rgba[0]);
+	image.flipRows();
+}
+
+int runHeadless(const HeadlessOptions & options)
+{
+	HeadlessContext headless(options.width, options.height);
+	if (!headless.ok)
+		return -1;
+
+	ShaderLibrary shaders;
+	Renderer renderer(shaders, options.variant, options.depth);
+	renderer.bind();
+
+	// Frames are read back through a PBO ring and encoded off this thread. Animation
+	// time is frame * timeStep whatever the frame took, so recordings play at speed.
+	int fps = options.timeStep > 0.0f ? (int)(1.0f / options.timeStep + 0.5f) : 60;
+	FrameSink* sink = NULL;
+	if (options.videoPath) {
+		VideoStream* video = new VideoStream(options.videoPath, (VideoFormat)options.videoFormat, fps);
+		if (!video->ok()) {
+			delete video;
+			return -1;
+		}
+		sink = video;
+	}
+	else if (options.outputPrefix) {
+		sink = new PngSequence(options.outputPrefix);
+	}
+	FrameCapture* capture = sink ? new FrameCapture(sink) : NULL;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < options.frames; frame++) {
+		renderer.drawFrame(frame * options.timeStep);
+		if (capture)
+			capture->capture(options.width, options.height);
+	}
+	if (capture)
+		capture->finish();
+	glFinish();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << options.frames << " frames at " << options.width << "x" << options.height
+		<< " (depth " << options.depth << ") in " << seconds * 1000.0 << " ms";
+	if (options.frames > 0 && seconds > 0.0)
+		std::cout << ", " << options.frames / seconds << " fps";
+	std::cout << std::endl;
+	if (capture) {
+		int failures = capture->failures();
+		std::cout << "Captured " << capture->framesCaptured << " frames, " << capture->stalls << " capture stalls";
+		// Too fast to time counts as keeping up
+		if (options.videoPath)
+			std::cout << (seconds <= 0.0 || options.frames / seconds >= fps ? ", kept up with " : ", fell behind ") << fps << " fps";
+		std::cout << std::endl;
+		delete capture;
+		delete sink;
+		if (failures > 0)
+			return -1;
+	}
+	return 0;
+}
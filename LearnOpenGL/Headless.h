@@ -0,0 +1,46 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "Image.h"
+
+// Offscreen GL 3.3 core context for machines without a display or GPU (Mesa llvmpipe
+// on a render farm node). The context comes from EGL, surfaceless when the driver
+// allows it and through a 1x1 pbuffer otherwise, and renders into an FBO of the
+// requested size. Linux only, elsewhere ok stays false.
+class HeadlessContext
+{
+public:
+	bool ok;
+	int width, height;
+	unsigned int FBO, colorBuffer;
+
+	// Creates the context, makes it current, loads glad/GLExt and binds the FBO
+	HeadlessContext(int width, int height);
+	~HeadlessContext();
+
+	// glReadPixels of the FBO, flipped to top-down rows
+	void readPixels(Image &image);
+
+private:
+	void* display;
+	void* context;
+	void* surface;
+};
+
+struct HeadlessOptions {
+	int frames;
+	int width;
+	int height;
+	int depth;
+	unsigned int variant;   // ShaderVariant bits
+	float timeStep;         // seconds of animation per frame
+	const char* outputPrefix; // frames are written to <prefix>0000.png..., NULL to skip
+	const char* videoPath;  // or streamed here as one video ("-" is stdout), NULL for none
+	int videoFormat;        // VideoFormat of videoPath
+};
+
+// Renders options.frames frames of the regular scene offscreen. Returns the
+// process exit code.
+int runHeadless(const HeadlessOptions &options);
+
+#endif
@@ -0,0 +1,29 @@
+#include "Image.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void Image::flipRows()
+{
+	for (int y = 0; y < height / 2; y++)
+		std::swap_ranges(row(y), row(y) + (size_t)width * 4, row(height - 1 - y));
+}
+
+bool writePPM(const char * path, const Image & image)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+	fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+	std::vector<unsigned char> rgb((size_t)image.width * 3);
+	for (int y = 0; y < image.height; y++) {
+		const unsigned char* src = image.row(y);
+		for (int x = 0; x < image.width; x++) {
+			rgb[x * 3 + 0] = src[x * 4 + 0];
+			rgb[x * 3 + 1] = src[x * 4 + 1];
+			rgb[x * 3 + 2] = src[x * 4 + 2];
+		}
+		fwrite(&rgb[0], 1, rgb.size(), file);
+	}
+	return fclose(file) == 0;
+}
@@ -0,0 +1,25 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstddef>
+#include <vector>
+
+// Tightly packed 8-bit RGBA pixels, first row at the top
+struct Image {
+	int width;
+	int height;
+	std::vector<unsigned char> rgba;
+
+	Image() : width(0), height(0) {}
+	Image(int width, int height) : width(width), height(height), rgba((size_t)width * height * 4) {}
+
+	unsigned char* row(int y) { return &rgba[(size_t)y * width * 4]; }
+	const unsigned char* row(int y) const { return &rgba[(size_t)y * width * 4]; }
+	// GL hands pixels over bottom row first
+	void flipRows();
+};
+
+// Binary PPM (P6), alpha dropped
+bool writePPM(const char* path, const Image &image);
+
+#endif
@@ -0,0 +1,146 @@
+#include "MeshRegenerator.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <utility>
+
+MeshRegenerator::MeshRegenerator(Renderer & renderer, std::function<bool(bool)> uploadContext)
+	: renderer(renderer), uploadContext(uploadContext), running(true), requestSerial(0), takenSerial(0),
+	depth(renderer.depth), cancel(false), cancelledBuilds(0), writing(false), ready(false), readyDepth(0), readyMs(0.0),
+	fence(NULL), buildMs(0.0)
+{
+	// VAOs are not shared between contexts, so the back one is made here
+	back = renderer.createMeshBuffers();
+	worker = std::thread(&MeshRegenerator::buildLoop, this);
+}
+
+MeshRegenerator::~MeshRegenerator()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+		cancel = true;
+	}
+	requested.notify_all();
+	if (worker.joinable())
+		worker.join();
+	if (fence)
+		glDeleteSync(fence);
+	renderer.deleteMeshBuffers(back);
+}
+
+void MeshRegenerator::request(int depth)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->depth = depth;
+		a = renderer.pA;
+		b = renderer.pB;
+		c = renderer.pC;
+		requestSerial++;
+		cancel = true;
+	}
+	requested.notify_one();
+}
+
+int MeshRegenerator::requestedDepth()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return depth;
+}
+
+void MeshRegenerator::buildLoop()
+{
+	TRACE_THREAD_NAME("mesh");
+	bool shared = uploadContext && uploadContext(true);
+	for (;;) {
+		unsigned long long serial;
+		int buildDepth;
+		glm::vec2 buildA, buildB, buildC;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			requested.wait(lock, [this] { return requestSerial != takenSerial || !running; });
+			if (!running)
+				break;
+			serial = takenSerial = requestSerial;
+			buildDepth = depth;
+			buildA = a;
+			buildB = b;
+			buildC = c;
+			cancel = false;
+		}
+
+		TRACE_SCOPE_ARG("regenerate", "depth", buildDepth);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RendererMesh mesh;
+		if (!Renderer::buildMesh(renderer.variant, buildDepth, renderer.indexed, buildA, buildB, buildC, mesh, &cancel)) {
+			cancelledBuilds++;
+			continue;
+		}
+
+		if (!shared) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (serial != requestSerial) {
+				cancelledBuilds++;
+				continue;
+			}
+			readyMesh = std::move(mesh);
+			readyDepth = buildDepth;
+			readyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			ready = true;
+			continue;
+		}
+
+		// A finished mesh nobody swapped in yet is overwritten, it is older anyway
+		MeshBuffers target;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (serial != requestSerial) {
+				cancelledBuilds++;
+				continue;
+			}
+			ready = false;
+			writing = true;
+			target = back;
+		}
+		Renderer::writeMesh(mesh, target);
+		GLsync written = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		// The render thread waits on the fence, so it has to reach the GPU
+		glFlush();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (fence)
+				glDeleteSync(fence);
+			fence = written;
+			back = target;
+			writing = false;
+			readyDepth = buildDepth;
+			readyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			ready = true;
+		}
+	}
+	if (shared)
+		uploadContext(false);
+}
+
+bool MeshRegenerator::poll()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!ready || writing)
+		return false;
+	if (fence) {
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+			return false;
+		glDeleteSync(fence);
+		fence = NULL;
+	}
+	else {
+		Renderer::writeMesh(readyMesh, back);
+		readyMesh = RendererMesh();
+	}
+	renderer.swapMesh(back, readyDepth);
+	buildMs = readyMs;
+	ready = false;
+	return true;
+}
@@ -0,0 +1,72 @@
+#ifndef MESHREGENERATOR_H
+#define MESHREGENERATOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Renderer.h"
+
+// Rebuilds a Renderer's mesh for a new depth in the background while the old one
+// keeps drawing. A worker thread builds the mesh, giving up as soon as a newer depth
+// is requested, and writes it into a second set of buffers; poll() swaps them in at
+// the frame boundary once the GPU has them.
+//
+// The upload happens on the worker too when it is given a context sharing objects
+// with the render thread's, with a fence telling poll() when it is done. Without one
+// the finished mesh is uploaded by poll() on the render thread.
+class MeshRegenerator
+{
+public:
+	// Must be created on the render thread with renderer's context current.
+	// uploadContext(true) makes the worker's shared context current on the calling
+	// thread and returns false when there is none, uploadContext(false) releases it.
+	// May be empty.
+	MeshRegenerator(Renderer &renderer, std::function<bool(bool)> uploadContext = std::function<bool(bool)>());
+	~MeshRegenerator();
+
+	// Start building depth, abandoning whatever was being built before
+	void request(int depth);
+	// Call once per frame, at the frame boundary. Returns true when the renderer now
+	// draws a new mesh, the caller should then bind() it again.
+	bool poll();
+
+	// Depth of the newest request, what the renderer will draw once it catches up
+	int requestedDepth();
+	// Builds abandoned for a newer request
+	int cancelled() const { return cancelledBuilds.load(); }
+	// Generate and upload time of the mesh poll() last swapped in
+	double lastBuildMs() const { return buildMs; }
+
+private:
+	Renderer &renderer;
+	std::function<bool(bool)> uploadContext;
+
+	std::mutex mutex;
+	std::condition_variable requested;
+	bool running;
+	// Newest request, and the request the worker last took
+	unsigned long long requestSerial, takenSerial;
+	int depth;
+	glm::vec2 a, b, c;
+	std::atomic<bool> cancel;
+	std::atomic<int> cancelledBuilds;
+
+	// Buffers the next mesh goes into, swapped with the renderer's by poll()
+	MeshBuffers back;
+	bool writing; // the worker is uploading into back
+	bool ready;   // back (or readyMesh, without an upload context) holds readyDepth
+	int readyDepth;
+	double readyMs;
+	GLsync fence;
+	RendererMesh readyMesh;
+	double buildMs;
+
+	std::thread worker;
+
+	void buildLoop();
+};
+
+#endif
@@ -0,0 +1,220 @@
+#include "MeshStream.h"
+#include "Sierpinski.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+static long long microsecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int powerOf3(int n)
+{
+	int power = 1;
+	for (int i = 0; i < n; i++)
+		power *= 3;
+	return power;
+}
+
+bool MeshStream::supports(unsigned int variant, bool indexed)
+{
+	if (indexed || (variant & SHADER_ANALYTIC))
+		return false;
+	unsigned int stream = variant & SHADER_STREAM_MASK;
+	return stream == SHADER_STREAM_POS_COLOR || stream == SHADER_STREAM_POS2 || stream == SHADER_STREAM_INSTANCED;
+}
+
+MeshStream::MeshStream(Renderer & renderer, int generators)
+	: renderer(renderer), stream(renderer.variant & SHADER_STREAM_MASK), depth(renderer.depth), stopping(false),
+	uploaded(0), prefix(0), start(std::chrono::steady_clock::now()), totalUs(0), uploadUs(0)
+{
+	split = depth > CHUNK_DEPTH ? depth - CHUNK_DEPTH : 0;
+	floatsPerItem = stream == SHADER_STREAM_POS_COLOR ? 6 : stream == SHADER_STREAM_POS2 ? 2 : 3;
+	// A triangle is three vertices, or one instance
+	size_t itemsPerTriangle = stream == SHADER_STREAM_INSTANCED ? 1 : 3;
+	topItems = split > 0 ? (size_t)triangleCount(split - 1) * itemsPerTriangle : 0;
+	chunkItems = (size_t)triangleCount(depth - split) * itemsPerTriangle;
+	done.assign((split > 0 ? 1 : 0) + powerOf3(split), false);
+
+	// Room for all of it, filled in by poll()
+	size_t bytes = chunkOffset(chunkCount()) * floatsPerItem * sizeof(float);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, renderer.VBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	renderer.bufferBytes = bytes;
+	renderer.vertexCount = 0;
+	renderer.instanceCount = 0;
+
+	if (generators <= 0)
+		generators = (int)std::thread::hardware_concurrency() - 1;
+	if (generators < 1)
+		generators = 1;
+	if (generators > chunkCount())
+		generators = chunkCount();
+	for (int i = 0; i < generators; i++) {
+		Lane* lane = new Lane();
+		lane->generatedUs = 0;
+		for (int slot = 0; slot < CHUNK_SLOTS; slot++) {
+			lane->buffers[slot].reserve(chunkItems * floatsPerItem);
+			lane->empty.push(&lane->buffers[slot]);
+		}
+		lanes.push_back(lane);
+	}
+	for (int i = 0; i < generators; i++)
+		lanes[i]->thread = std::thread(&MeshStream::generateLoop, this, i);
+}
+
+MeshStream::~MeshStream()
+{
+	stopping = true;
+	for (size_t i = 0; i < lanes.size(); i++) {
+		lanes[i]->thread.join();
+		delete lanes[i];
+	}
+}
+
+// Where chunk index starts in the buffer, in vertices (instances when instanced).
+// chunkCount() gives the size of the whole mesh.
+size_t MeshStream::chunkOffset(int index) const
+{
+	int firstSubtree = split > 0 ? 1 : 0;
+	if (index < firstSubtree)
+		return 0;
+	return topItems + (size_t)(index - firstSubtree) * chunkItems;
+}
+
+// Chunk 0 is the levels above the subtrees when there are any, then the subtrees in
+// the order drawTris() visits them
+void MeshStream::generateChunk(int index, std::vector<float> &vertices) const
+{
+	TRACE_SCOPE_ARG("generate chunk", "chunk", index);
+	vertices.clear();
+	glm::vec2 a = renderer.pA, b = renderer.pB, c = renderer.pC;
+	if (split > 0 && index == 0) {
+		if (stream == SHADER_STREAM_POS_COLOR)
+			drawTris(a, b, c, split - 1, vertices);
+		else if (stream == SHADER_STREAM_POS2)
+			drawTrisPos2(a, b, c, split - 1, vertices);
+		else
+			drawTriInstances(a, b, c, split - 1, glm::vec2(0.0f, 0.0f), 1.0f, vertices);
+		return;
+	}
+
+	// The subtree's corners, one base 3 digit of its number per level
+	int subtree = index - (split > 0 ? 1 : 0);
+	glm::vec2 offset(0.0f, 0.0f);
+	float scale = 1.0f;
+	glm::vec2 ta = a, tb = b, tc = c;
+	for (int level = split - 1; level >= 0; level--) {
+		int child = subtree / powerOf3(level) % 3;
+		if (stream == SHADER_STREAM_INSTANCED) {
+			float half = scale / 2;
+			offset = offset + (child == 0 ? a : child == 1 ? b : c) * half;
+			scale = half;
+			continue;
+		}
+		glm::vec2 ab = mid(ta, tb), bc = mid(tb, tc), ac = mid(ta, tc);
+		if (child == 0) {
+			tb = ab;
+			tc = ac;
+		}
+		else if (child == 1) {
+			ta = tb;
+			tb = ab;
+			tc = bc;
+		}
+		else {
+			ta = tc;
+			tb = ac;
+			tc = bc;
+		}
+	}
+	int n = depth - split;
+	if (stream == SHADER_STREAM_POS_COLOR)
+		drawTris(ta, tb, tc, n, vertices);
+	else if (stream == SHADER_STREAM_POS2)
+		drawTrisPos2(ta, tb, tc, n, vertices);
+	else
+		drawTriInstances(a, b, c, n, offset, scale, vertices);
+}
+
+void MeshStream::generateLoop(int laneIndex)
+{
+	TRACE_THREAD_NAME("generator");
+	Lane &lane = *lanes[laneIndex];
+	for (int index = laneIndex; index < chunkCount(); index += (int)lanes.size()) {
+		std::vector<float>* buffer = NULL;
+		// Wait for the uploads to hand a buffer back
+		while (!lane.empty.pop(buffer)) {
+			if (stopping.load(std::memory_order_relaxed))
+				return;
+			std::this_thread::yield();
+		}
+		generateChunk(index, *buffer);
+		Chunk chunk = { index, buffer };
+		// Can't be full, there are only CHUNK_SLOTS buffers
+		lane.filled.push(chunk);
+		lane.generatedUs.store(microsecondsSince(start), std::memory_order_relaxed);
+	}
+}
+
+bool MeshStream::poll(int budgetMs)
+{
+	if (prefix == chunkCount())
+		return true;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, renderer.VBO);
+	while (true) {
+		bool any = false;
+		for (size_t i = 0; i < lanes.size(); i++) {
+			Chunk chunk;
+			while (lanes[i]->filled.pop(chunk)) {
+				TRACE_SCOPE_ARG("upload chunk", "chunk", chunk.index);
+				std::chrono::steady_clock::time_point uploadStart = std::chrono::steady_clock::now();
+				glBufferSubData(GL_COPY_WRITE_BUFFER, chunkOffset(chunk.index) * floatsPerItem * sizeof(float),
+					chunk.data->size() * sizeof(float), &(*chunk.data)[0]);
+				uploadUs += microsecondsSince(uploadStart);
+				done[chunk.index] = true;
+				uploaded++;
+				lanes[i]->empty.push(chunk.data);
+				any = true;
+			}
+		}
+		if (uploaded == chunkCount() || std::chrono::steady_clock::now() >= deadline)
+			break;
+		// Give the generators the core while nothing is ready
+		if (!any)
+			std::this_thread::yield();
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	while (prefix < chunkCount() && done[prefix])
+		prefix++;
+	GLsizei items = (GLsizei)chunkOffset(prefix);
+	if (stream == SHADER_STREAM_INSTANCED) {
+		renderer.vertexCount = items > 0 ? 3 : 0;
+		renderer.instanceCount = items;
+	}
+	else {
+		renderer.vertexCount = items;
+	}
+	if (prefix < chunkCount())
+		return false;
+	totalUs = microsecondsSince(start);
+	return true;
+}
+
+void MeshStream::finish()
+{
+	while (!poll())
+		std::this_thread::yield();
+}
+
+double MeshStream::generateMs() const
+{
+	long long latest = 0;
+	for (size_t i = 0; i < lanes.size(); i++)
+		latest = std::max(latest, lanes[i]->generatedUs.load(std::memory_order_relaxed));
+	return latest / 1000.0;
+}
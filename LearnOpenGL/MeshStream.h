@@ -0,0 +1,93 @@
+#ifndef MESHSTREAM_H
+#define MESHSTREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Renderer.h"
+#include "SpscQueue.h"
+
+// Generates a Renderer's mesh and uploads it at the same time, instead of the one
+// after the other that generate() does. The mesh is cut into the subtrees CHUNK_DEPTH
+// levels deep, all the same size and each at a known place in the buffer, plus one
+// chunk for the levels above them. Generator threads take every Nth chunk in order
+// and hand it to the GL thread through their own SpscQueue; poll() writes whatever
+// has arrived with glBufferSubData and has the renderer draw the chunks done so far,
+// from the start of the buffer. Each generator fills at most CHUNK_SLOTS chunks ahead
+// of the uploads, so memory stays bounded however deep the mesh. Called once a frame,
+// poll() gets a time budget to keep uploading in, and the slots hold more than a
+// generator builds in the rest of a 60 Hz frame, so neither side waits on vsync.
+//
+// Triangles come out in a different order than drawTris(), which only matters to
+// indexed meshes: those can't stream. Neither can SHADER_ANALYTIC and
+// SHADER_STREAM_VERTEX_ID, having nothing to upload.
+class MeshStream
+{
+public:
+	static const int CHUNK_DEPTH = 7;
+	static const int CHUNK_SLOTS = 32;
+	// What the app gives poll() every frame
+	static const int FRAME_BUDGET_MS = 4;
+
+	static bool supports(unsigned int variant, bool indexed);
+
+	// Needs renderer's context current. Sizes the renderer's VBO for its depth, draws
+	// nothing until the first chunks are in and starts generator threads (0 for
+	// one per hardware thread, besides this one).
+	MeshStream(Renderer &renderer, int generators = 0);
+	// Stops the generators, the renderer keeps whatever was uploaded
+	~MeshStream();
+
+	// Uploads every chunk that is ready and moves what the renderer draws up to the
+	// last of the chunks done in a row. Call on the GL thread, e.g. once a frame.
+	// With a budget it keeps taking chunks as they arrive until budgetMs have passed.
+	// True once the whole mesh is in.
+	bool poll(int budgetMs = 0);
+	// poll()s until the whole mesh is in
+	void finish();
+
+	int chunkCount() const { return (int)done.size(); }
+	int chunksUploaded() const { return uploaded; }
+	// Since the constructor: until the last chunk was generated, until the last was
+	// uploaded, and time spent in glBufferSubData
+	double generateMs() const;
+	double totalMs() const { return totalUs / 1000.0; }
+	double uploadMs() const { return uploadUs / 1000.0; }
+
+private:
+	struct Chunk {
+		int index;
+		std::vector<float>* data;
+	};
+	// One per generator: filled chunks one way, emptied buffers back the other
+	struct Lane {
+		SpscQueue<Chunk, CHUNK_SLOTS> filled;
+		SpscQueue<std::vector<float>*, CHUNK_SLOTS> empty;
+		std::vector<float> buffers[CHUNK_SLOTS];
+		std::thread thread;
+		std::atomic<long long> generatedUs; // when its last chunk was done
+	};
+
+	Renderer &renderer;
+	unsigned int stream;
+	int depth;
+	int split; // levels above the chunks
+	int floatsPerItem; // per vertex, or per instance when instanced
+	size_t topItems, chunkItems;
+	std::vector<Lane*> lanes;
+	std::atomic<bool> stopping;
+
+	std::vector<bool> done;
+	int uploaded;
+	int prefix; // chunks done in a row from the first
+	std::chrono::steady_clock::time_point start;
+	long long totalUs, uploadUs;
+
+	void generateLoop(int lane);
+	void generateChunk(int index, std::vector<float> &vertices) const;
+	size_t chunkOffset(int index) const;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "PerfCounters.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* EVENT_NAMES[PERF_EVENT_COUNT] = { "cycles", "instructions", "llc_misses", "dtlb_misses", "page_faults" };
+
+PerfSample::PerfSample()
+{
+	for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+		counts[e] = 0;
+		valid[e] = false;
+	}
+}
+
+void PerfSample::add(const PerfSample & other)
+{
+	for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+		counts[e] += other.counts[e];
+		valid[e] = valid[e] || other.valid[e];
+	}
+}
+
+double PerfSample::ipc() const
+{
+	if (!valid[PERF_CYCLES] || !valid[PERF_INSTRUCTIONS] || counts[PERF_CYCLES] == 0)
+		return 0.0;
+	return (double)counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES];
+}
+
+double PerfSample::per(PerfEvent event, double items) const
+{
+	return valid[event] && items > 0.0 ? counts[event] / items : 0.0;
+}
+
+#ifdef __linux__
+static int openEvent(uint32_t type, uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// This thread, any CPU
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		fds[e] = -1;
+#ifdef __linux__
+	fds[PERF_CYCLES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	fds[PERF_INSTRUCTIONS] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	fds[PERF_LLC_MISSES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	fds[PERF_DTLB_MISSES] = openEvent(PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	fds[PERF_PAGE_FAULTS] = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		if (fds[e] >= 0)
+			close(fds[e]);
+#endif
+}
+
+bool PerfCounters::anyAvailable() const
+{
+	for (int e = 0; e < PERF_EVENT_COUNT; e++)
+		if (fds[e] >= 0)
+			return true;
+	return false;
+}
+
+PerfSample PerfCounters::read() const
+{
+	PerfSample sample;
+#ifdef __linux__
+	for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+		// value, time enabled, time running
+		uint64_t values[3];
+		if (fds[e] < 0 || ::read(fds[e], values, sizeof(values)) != (ssize_t)sizeof(values))
+			continue;
+		sample.valid[e] = true;
+		sample.counts[e] = values[2] > 0 && values[2] < values[1] ? (uint64_t)((double)values[0] * values[1] / values[2]) : values[0];
+	}
+#endif
+	return sample;
+}
+
+const char* PerfCounters::name(PerfEvent event)
+{
+	return EVENT_NAMES[event];
+}
+
+PerfScope::PerfScope(PerfCounters * counters, PerfSample & total) : counters(counters), total(total)
+{
+	if (counters)
+		start = counters->read();
+}
+
+PerfScope::~PerfScope()
+{
+	if (!counters)
+		return;
+	PerfSample end = counters->read();
+	for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+		if (!end.valid[e])
+			continue;
+		// Scaled totals can step back by a count or two
+		end.counts[e] = end.counts[e] > start.counts[e] ? end.counts[e] - start.counts[e] : 0;
+	}
+	total.add(end);
+}
+
+std::string formatPerf(const char* phase, const PerfSample & sample, double triangles)
+{
+	char text[256];
+	int length = snprintf(text, sizeof(text), "%s: ", phase);
+	if (sample.valid[PERF_CYCLES] && sample.valid[PERF_INSTRUCTIONS])
+		length += snprintf(text + length, sizeof(text) - length, "%.2f IPC", sample.ipc());
+	else
+		length += snprintf(text + length, sizeof(text) - length, "n/a IPC");
+	for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+		if (e == PERF_INSTRUCTIONS)
+			continue;
+		if (sample.valid[e])
+			length += snprintf(text + length, sizeof(text) - length, ", %.4g %s", sample.per((PerfEvent)e, triangles), EVENT_NAMES[e]);
+		else
+			length += snprintf(text + length, sizeof(text) - length, ", n/a %s", EVENT_NAMES[e]);
+	}
+	snprintf(text + length, sizeof(text) - length, " per triangle");
+	return text;
+}
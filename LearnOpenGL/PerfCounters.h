@@ -0,0 +1,71 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+// What the hardware counters say about a stretch of code, for telling cache misses
+// from branchy recursion from page faults when the wall clock only says "slow"
+enum PerfEvent {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES, // data TLB read misses
+	PERF_PAGE_FAULTS,
+	PERF_EVENT_COUNT
+};
+
+// Event counts over some stretch, summed over as many stretches as were added
+struct PerfSample {
+	uint64_t counts[PERF_EVENT_COUNT];
+	bool valid[PERF_EVENT_COUNT]; // false when the event could not be counted
+
+	PerfSample();
+	void add(const PerfSample &other);
+	// Instructions per cycle, 0 without both counters
+	double ipc() const;
+	// count / items, e.g. misses per triangle, 0 when not counted
+	double per(PerfEvent event, double items) const;
+};
+
+// perf_event_open counters of the calling thread, user space only so they work at
+// the default perf_event_paranoid of 2. Threads other than the one that made them
+// (the ThreadPool workers, the GL driver's) are not counted. Events the kernel or
+// the machine won't count, e.g. hardware events in most VMs, are left out and
+// reported as such; nothing at all is counted outside Linux.
+class PerfCounters
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	bool available(PerfEvent event) const { return fds[event] >= 0; }
+	bool anyAvailable() const;
+	// Running totals since construction, scaled up when the kernel had to share the
+	// hardware counters with other events
+	PerfSample read() const;
+
+	static const char* name(PerfEvent event);
+
+private:
+	int fds[PERF_EVENT_COUNT];
+};
+
+// Adds what the enclosing block counted to total, nothing when counters is NULL
+class PerfScope
+{
+public:
+	PerfScope(PerfCounters* counters, PerfSample &total);
+	~PerfScope();
+
+private:
+	PerfCounters* counters;
+	PerfSample &total;
+	PerfSample start;
+};
+
+// "generation: 1.85 IPC, 12.3 cycles, 0.021 LLC misses, ... per triangle", with
+// n/a for events that were not counted
+std::string formatPerf(const char* phase, const PerfSample &sample, double triangles);
+
+#endif
@@ -0,0 +1,553 @@
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Raw bytes per band, below this the per-band overhead starts to show in the ratio
+static const size_t MIN_BAND_BYTES = 128 * 1024;
+
+static int seek64(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static bool truncate64(FILE* file, uint64_t size)
+{
+#ifdef _WIN32
+	return _chsize_s(_fileno(file), (long long)size) == 0;
+#else
+	return ftruncate(fileno(file), (off_t)size) == 0;
+#endif
+}
+
+static void put32(unsigned char* out, uint32_t value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+struct CrcTable {
+	uint32_t entries[256];
+
+	CrcTable() {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size)
+{
+	static const CrcTable table;
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static const uint32_t ADLER_BASE = 65521;
+
+static uint32_t adler32(uint32_t adler, const unsigned char* data, size_t size)
+{
+	uint32_t a = adler & 0xFFFF, b = adler >> 16;
+	while (size > 0) {
+		// Largest run that cannot overflow b before the modulo
+		size_t run = std::min(size, (size_t)5552);
+		for (size_t i = 0; i < run; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+		data += run;
+		size -= run;
+	}
+	return a | (b << 16);
+}
+
+// Adler-32 of A followed by B from the two checksums and B's length, as zlib's adler32_combine
+static uint32_t adler32Combine(uint32_t adlerA, uint32_t adlerB, uint64_t sizeB)
+{
+	uint32_t rem = (uint32_t)(sizeB % ADLER_BASE);
+	uint32_t sum1 = adlerA & 0xFFFF;
+	uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % ADLER_BASE);
+	sum1 += (adlerB & 0xFFFF) + ADLER_BASE - 1;
+	sum2 += (adlerA >> 16) + (adlerB >> 16) + ADLER_BASE - rem;
+	if (sum1 >= ADLER_BASE)
+		sum1 -= ADLER_BASE;
+	if (sum1 >= ADLER_BASE)
+		sum1 -= ADLER_BASE;
+	if (sum2 >= 2 * ADLER_BASE)
+		sum2 -= 2 * ADLER_BASE;
+	if (sum2 >= ADLER_BASE)
+		sum2 -= ADLER_BASE;
+	return sum1 | (sum2 << 16);
+}
+
+// Deflate with the fixed Huffman codes of RFC 1951 3.2.6. Codes are stored bit
+// reversed, ready to go out LSB first.
+struct FixedCodes {
+	uint16_t literal[288];
+	unsigned char literalBits[288];
+	unsigned char distance[30];
+	unsigned char lengthSymbol[259];   // match length -> length symbol - 257
+	unsigned char distanceSymbol[512]; // distance -> distance symbol, see the constructor
+
+	FixedCodes();
+};
+
+static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static uint16_t reverseBits(uint16_t code, int bits)
+{
+	uint16_t reversed = 0;
+	for (int i = 0; i < bits; i++)
+		reversed |= ((code >> i) & 1) << (bits - 1 - i);
+	return reversed;
+}
+
+FixedCodes::FixedCodes()
+{
+	for (int symbol = 0; symbol < 288; symbol++) {
+		int code, bits;
+		if (symbol < 144) {
+			code = 0x30 + symbol;
+			bits = 8;
+		}
+		else if (symbol < 256) {
+			code = 0x190 + symbol - 144;
+			bits = 9;
+		}
+		else if (symbol < 280) {
+			code = symbol - 256;
+			bits = 7;
+		}
+		else {
+			code = 0xC0 + symbol - 280;
+			bits = 8;
+		}
+		literal[symbol] = reverseBits((uint16_t)code, bits);
+		literalBits[symbol] = (unsigned char)bits;
+	}
+	for (int symbol = 0; symbol < 30; symbol++)
+		distance[symbol] = (unsigned char)reverseBits((uint16_t)symbol, 5);
+	for (int symbol = 0; symbol < 29; symbol++) {
+		int end = symbol == 28 ? 259 : LENGTH_BASE[symbol + 1];
+		for (int length = LENGTH_BASE[symbol]; length < end; length++)
+			lengthSymbol[length] = (unsigned char)symbol;
+	}
+	// Indexed by distance - 1 below 256 and 256 + ((distance - 1) >> 7) above
+	for (int symbol = 0; symbol < 30; symbol++) {
+		int last = symbol == 29 ? 32768 : DISTANCE_BASE[symbol + 1] - 1;
+		for (int d = DISTANCE_BASE[symbol]; d <= last; d++) {
+			if (d <= 256)
+				distanceSymbol[d - 1] = (unsigned char)symbol;
+			else
+				distanceSymbol[256 + ((d - 1) >> 7)] = (unsigned char)symbol;
+		}
+	}
+}
+
+static const FixedCodes& fixedCodes()
+{
+	static const FixedCodes codes;
+	return codes;
+}
+
+struct BitWriter {
+	std::vector<unsigned char> &out;
+	uint64_t bits;
+	int count;
+
+	BitWriter(std::vector<unsigned char> &out) : out(out), bits(0), count(0) {}
+
+	void put(uint32_t value, int n) {
+		bits |= (uint64_t)value << count;
+		count += n;
+		while (count >= 8) {
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+	void align() {
+		if (count > 0)
+			put(0, 8 - count);
+	}
+};
+
+// One band as a fixed Huffman block, greedy LZ77 over a 32K window with one hash
+// candidate per position. Filtered two-colour rows are long runs of zeros and
+// repeats, which single candidate matching already squeezes well.
+static void deflateBand(const unsigned char* data, size_t size, bool final, std::vector<unsigned char> &out)
+{
+	const FixedCodes &codes = fixedCodes();
+	const int HASH_BITS = 15;
+	const size_t WINDOW = 32768;
+	std::vector<int64_t> head((size_t)1 << HASH_BITS, -1);
+	BitWriter writer(out);
+	writer.put(final ? 1 : 0, 1); // BFINAL
+	writer.put(1, 2);             // BTYPE fixed Huffman
+
+	size_t i = 0;
+	while (i < size) {
+		size_t length = 0, distance = 0;
+		if (i + 3 <= size) {
+			uint32_t key = (uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2];
+			uint32_t hash = (key * 2654435761u) >> (32 - HASH_BITS);
+			int64_t candidate = head[hash];
+			head[hash] = (int64_t)i;
+			if (candidate >= 0 && i - (size_t)candidate <= WINDOW) {
+				const unsigned char* a = data + candidate;
+				const unsigned char* b = data + i;
+				size_t limit = std::min((size_t)258, size - i);
+				while (length < limit && a[length] == b[length])
+					length++;
+				distance = i - (size_t)candidate;
+			}
+		}
+		if (length >= 3) {
+			int symbol = codes.lengthSymbol[length];
+			writer.put(codes.literal[257 + symbol], codes.literalBits[257 + symbol]);
+			writer.put((uint32_t)(length - LENGTH_BASE[symbol]), LENGTH_EXTRA[symbol]);
+			int d = distance <= 256 ? codes.distanceSymbol[distance - 1] : codes.distanceSymbol[256 + ((distance - 1) >> 7)];
+			writer.put(codes.distance[d], 5);
+			writer.put((uint32_t)(distance - DISTANCE_BASE[d]), DISTANCE_EXTRA[d]);
+			// Short matches feed the hash, long runs would only cost time
+			if (length <= 16) {
+				for (size_t k = i + 1; k < i + length && k + 3 <= size; k++) {
+					uint32_t key = (uint32_t)data[k] << 16 | (uint32_t)data[k + 1] << 8 | data[k + 2];
+					head[(key * 2654435761u) >> (32 - HASH_BITS)] = (int64_t)k;
+				}
+			}
+			i += length;
+		}
+		else {
+			writer.put(codes.literal[data[i]], codes.literalBits[data[i]]);
+			i++;
+		}
+	}
+	writer.put(codes.literal[256], codes.literalBits[256]); // end of block
+
+	if (!final) {
+		// Sync flush: empty stored block, leaves the stream byte aligned
+		writer.put(0, 1);
+		writer.put(0, 2);
+		writer.align();
+		out.push_back(0x00);
+		out.push_back(0x00);
+		out.push_back(0xFF);
+		out.push_back(0xFF);
+	}
+	writer.align();
+}
+
+// Filters one packed row into out (filter type byte first). Up when the row repeats
+// the one above, otherwise whichever of None, Sub and Up has the smallest sum of
+// absolute values, the usual estimate of how well a row compresses.
+static void filterRow(const unsigned char* row, const unsigned char* above, size_t size, size_t bpp, unsigned char* out)
+{
+	if (above && memcmp(row, above, size) == 0) {
+		out[0] = 2;
+		memset(out + 1, 0, size);
+		return;
+	}
+	uint64_t none = 0, sub = 0, up = 0;
+	for (size_t i = 0; i < size; i++) {
+		none += row[i] < 128 ? row[i] : 256 - row[i];
+		unsigned char s = (unsigned char)(row[i] - (i >= bpp ? row[i - bpp] : 0));
+		sub += s < 128 ? s : 256 - s;
+		if (above) {
+			unsigned char u = (unsigned char)(row[i] - above[i]);
+			up += u < 128 ? u : 256 - u;
+		}
+	}
+	int type = sub < none ? 1 : 0;
+	if (above && up < std::min(none, sub))
+		type = 2;
+	out[0] = (unsigned char)type;
+	for (size_t i = 0; i < size; i++) {
+		if (type == 0)
+			out[1 + i] = row[i];
+		else if (type == 1)
+			out[1 + i] = (unsigned char)(row[i] - (i >= bpp ? row[i - bpp] : 0));
+		else
+			out[1 + i] = (unsigned char)(row[i] - above[i]);
+	}
+}
+
+PngWriter::PngWriter(ThreadPool * pool)
+	: width(0), height(0), pool(pool), file(NULL), offset(0), rowsWritten(0), adler(1), bitDepth(8), rowBytes(0)
+{
+}
+
+PngWriter::~PngWriter()
+{
+	if (file)
+		fclose(file);
+}
+
+void PngWriter::setFormat(int width, int height, const uint32_t * palette, int paletteSize)
+{
+	this->width = width;
+	this->height = height;
+	colors.assign(palette, palette + (palette ? std::min(paletteSize, 256) : 0));
+	if (colors.empty()) {
+		bitDepth = 8;
+		rowBytes = (size_t)width * 3;
+	}
+	else {
+		bitDepth = colors.size() <= 2 ? 1 : colors.size() <= 4 ? 2 : colors.size() <= 16 ? 4 : 8;
+		rowBytes = ((size_t)width * bitDepth + 7) / 8;
+	}
+	rowsWritten = 0;
+	adler = 1;
+	previous.clear();
+}
+
+bool PngWriter::write(const void * data, size_t size)
+{
+	if (fwrite(data, 1, size, file) != size) {
+		std::cout << "ERROR::PNG::WRITE_FAILED" << std::endl;
+		return false;
+	}
+	offset += size;
+	return true;
+}
+
+bool PngWriter::writeChunk(const char * type, const unsigned char * data, size_t size)
+{
+	unsigned char header[8];
+	put32(header, (uint32_t)size);
+	memcpy(header + 4, type, 4);
+	unsigned char crc[4];
+	put32(crc, crc32(crc32(0, header + 4, 4), data, size));
+	return write(header, 8) && (size == 0 || write(data, size)) && write(crc, 4);
+}
+
+bool PngWriter::open(const char * path, int width, int height, const uint32_t * palette, int paletteSize)
+{
+	if (file)
+		fclose(file);
+	setFormat(width, height, palette, paletteSize);
+	offset = 0;
+	file = fopen(path, "wb");
+	if (!file) {
+		std::cout << "ERROR::PNG::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	unsigned char ihdr[13];
+	put32(ihdr, (uint32_t)width);
+	put32(ihdr + 4, (uint32_t)height);
+	ihdr[8] = (unsigned char)bitDepth;
+	ihdr[9] = colors.empty() ? 2 : 3; // RGB or indexed
+	ihdr[10] = 0; // deflate
+	ihdr[11] = 0; // adaptive filtering
+	ihdr[12] = 0; // no interlace
+	if (!write(signature, 8) || !writeChunk("IHDR", ihdr, 13))
+		return false;
+	if (!colors.empty()) {
+		std::vector<unsigned char> plte;
+		for (size_t i = 0; i < colors.size(); i++) {
+			const unsigned char* rgba = (const unsigned char*)&colors[i];
+			plte.insert(plte.end(), rgba, rgba + 3);
+		}
+		if (!writeChunk("PLTE", &plte[0], plte.size()))
+			return false;
+	}
+	return true;
+}
+
+bool PngWriter::resume(const char * path, int width, int height, const uint32_t * palette, int paletteSize, const Checkpoint & checkpoint)
+{
+	if (file)
+		fclose(file);
+	setFormat(width, height, palette, paletteSize);
+	file = fopen(path, "r+b");
+	if (!file || seek64(file, checkpoint.offset) != 0) {
+		std::cout << "ERROR::PNG::RESUME_FAILED " << path << std::endl;
+		return false;
+	}
+	// The row above is gone, the first new row just can't use Up
+	offset = checkpoint.offset;
+	rowsWritten = checkpoint.rows;
+	adler = checkpoint.adler;
+	return true;
+}
+
+void PngWriter::packRow(const unsigned char * rgba, unsigned char * out) const
+{
+	if (colors.empty()) {
+		for (int x = 0; x < width; x++) {
+			out[x * 3 + 0] = rgba[x * 4 + 0];
+			out[x * 3 + 1] = rgba[x * 4 + 1];
+			out[x * 3 + 2] = rgba[x * 4 + 2];
+		}
+		return;
+	}
+	memset(out, 0, rowBytes);
+	const uint32_t* pixels = (const uint32_t*)rgba;
+	uint32_t lastColor = colors[0];
+	int lastIndex = 0;
+	int perByte = 8 / bitDepth;
+	for (int x = 0; x < width; x++) {
+		// Runs of one colour are the norm, colours missing from the palette map to 0
+		if (pixels[x] != lastColor) {
+			lastColor = pixels[x];
+			lastIndex = 0;
+			for (size_t i = 0; i < colors.size(); i++) {
+				if (colors[i] == lastColor) {
+					lastIndex = (int)i;
+					break;
+				}
+			}
+		}
+		int shift = 8 - bitDepth * (x % perByte + 1);
+		out[x / perByte] |= (unsigned char)(lastIndex << shift);
+	}
+}
+
+bool PngWriter::writeRows(const unsigned char * rgba, int rows)
+{
+	if (!file)
+		return false;
+	rows = std::min(rows, height - rowsWritten);
+	if (rows <= 0)
+		return true;
+
+	size_t rgbaStride = (size_t)width * 4;
+	int threads = pool ? pool->size() + 1 : 1;
+	int bandRows = std::max((rows + 4 * threads - 1) / (4 * threads), (int)(MIN_BAND_BYTES / (rowBytes + 1)) + 1);
+	int bands = (rows + bandRows - 1) / bandRows;
+	bool first = rowsWritten == 0, last = rowsWritten + rows == height;
+	size_t bpp = colors.empty() ? 3 : 1;
+
+	struct Band {
+		std::vector<unsigned char> chunk;
+		uint32_t adler;
+		size_t rawBytes;
+	};
+	std::vector<Band> results(bands);
+	std::function<void(int)> encode = [&](int band) {
+		int begin = band * bandRows, end = std::min(rows, begin + bandRows);
+		std::vector<unsigned char> raw((size_t)(end - begin) * (rowBytes + 1));
+		std::vector<unsigned char> packed(rowBytes), above(rowBytes);
+		bool hasAbove = begin > 0 || !previous.empty();
+		if (begin > 0)
+			packRow(rgba + (size_t)(begin - 1) * rgbaStride, &above[0]);
+		else if (hasAbove)
+			above = previous;
+		for (int row = begin; row < end; row++) {
+			packRow(rgba + (size_t)row * rgbaStride, &packed[0]);
+			filterRow(&packed[0], hasAbove ? &above[0] : NULL, rowBytes, bpp, &raw[(size_t)(row - begin) * (rowBytes + 1)]);
+			above.swap(packed);
+			hasAbove = true;
+		}
+
+		Band &out = results[band];
+		out.rawBytes = raw.size();
+		out.adler = adler32(1, &raw[0], raw.size());
+		// Chunk length and type, filled in below, then the deflate data and the CRC
+		out.chunk.resize(8);
+		if (first && band == 0) {
+			out.chunk.push_back(0x78); // zlib header: deflate, 32K window, fastest
+			out.chunk.push_back(0x01);
+		}
+		deflateBand(&raw[0], raw.size(), last && band == bands - 1, out.chunk);
+		put32(&out.chunk[0], (uint32_t)(out.chunk.size() - 8));
+		memcpy(&out.chunk[4], "IDAT", 4);
+		unsigned char crc[4];
+		put32(crc, crc32(0, &out.chunk[4], out.chunk.size() - 4));
+		out.chunk.insert(out.chunk.end(), crc, crc + 4);
+	};
+	if (pool && bands > 1)
+		pool->parallelFor(bands, encode);
+	else
+		for (int band = 0; band < bands; band++)
+			encode(band);
+
+	for (int band = 0; band < bands; band++) {
+		if (!write(&results[band].chunk[0], results[band].chunk.size()))
+			return false;
+		adler = adler32Combine(adler, results[band].adler, results[band].rawBytes);
+	}
+	previous.resize(rowBytes);
+	packRow(rgba + (size_t)(rows - 1) * rgbaStride, &previous[0]);
+	rowsWritten += rows;
+	return true;
+}
+
+PngWriter::Checkpoint PngWriter::checkpoint()
+{
+	if (file)
+		fflush(file);
+	Checkpoint checkpoint;
+	checkpoint.rows = rowsWritten;
+	checkpoint.offset = offset;
+	checkpoint.adler = adler;
+	return checkpoint;
+}
+
+bool PngWriter::close()
+{
+	if (!file)
+		return false;
+	bool ok = rowsWritten == height;
+	if (!ok)
+		std::cout << "ERROR::PNG::INCOMPLETE " << rowsWritten << " of " << height << " rows" << std::endl;
+	// Adler-32 of everything deflated ends the zlib stream, in a last IDAT of its own
+	unsigned char trailer[4];
+	put32(trailer, adler);
+	ok = ok && writeChunk("IDAT", trailer, 4) && writeChunk("IEND", NULL, 0);
+	// A resumed file can be longer than what was written this time
+	ok = ok && fflush(file) == 0 && truncate64(file, offset);
+	ok = fclose(file) == 0 && ok;
+	file = NULL;
+	return ok;
+}
+
+bool writePNG(const char * path, const Image & image, ThreadPool * pool)
+{
+	// Palette if the image has few enough colours
+	std::vector<uint32_t> palette;
+	const uint32_t* pixels = (const uint32_t*)&image.rgba[0];
+	size_t count = (size_t)image.width * image.height;
+	uint32_t lastColor = 0;
+	for (size_t i = 0; i < count && palette.size() <= 256; i++) {
+		if (i > 0 && pixels[i] == lastColor)
+			continue;
+		lastColor = pixels[i];
+		if (std::find(palette.begin(), palette.end(), lastColor) == palette.end())
+			palette.push_back(lastColor);
+	}
+
+	PngWriter writer(pool);
+	bool indexed = !palette.empty() && palette.size() <= 256;
+	if (!writer.open(path, image.width, image.height, indexed ? &palette[0] : NULL, indexed ? (int)palette.size() : 0))
+		return false;
+	if (!writer.writeRows(&image.rgba[0], image.height))
+		return false;
+	return writer.close();
+}
@@ -0,0 +1,71 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+// Streaming PNG encoder that deflates in parallel. Every writeRows() call is cut into
+// row bands, each band is filtered and deflated on its own (fixed Huffman codes, no
+// shared dictionary) and ends on a byte boundary with an empty stored block, the
+// sync flush zlib uses, so the bands concatenate into one valid zlib stream. Each
+// band goes out as its own IDAT chunk with its CRC and Adler-32 computed in the
+// worker; the Adler-32 values are combined at the end.
+//
+// Our frames hold a handful of colours, so a palette (1, 2, 4 or 8 bits per pixel)
+// is used whenever one is given, and rows are filtered with Up when they repeat the
+// row above and otherwise the cheaper of None and Sub.
+class PngWriter
+{
+public:
+	// Enough to carry on an interrupted file later, see resume()
+	struct Checkpoint {
+		int rows;
+		uint64_t offset;
+		uint32_t adler;
+	};
+
+	int width, height;
+
+	// Bands are spread over pool, NULL encodes on the calling thread
+	PngWriter(ThreadPool* pool = NULL);
+	~PngWriter();
+
+	// palette holds every RGBA colour the rows will use (alpha is dropped), at most
+	// 256 of them. With no palette the file is 8-bit RGB.
+	bool open(const char* path, int width, int height, const uint32_t* palette = NULL, int paletteSize = 0);
+	// Reopens a file written with the same arguments at a checkpoint of it
+	bool resume(const char* path, int width, int height, const uint32_t* palette, int paletteSize, const Checkpoint &checkpoint);
+	// Appends rows top-down, tightly packed RGBA
+	bool writeRows(const unsigned char* rgba, int rows);
+	// State after the last writeRows(), flushed to the OS
+	Checkpoint checkpoint();
+	// Writes the trailer once every row is in
+	bool close();
+
+private:
+	ThreadPool* pool;
+	FILE* file;
+	uint64_t offset;
+	int rowsWritten;
+	uint32_t adler;
+	std::vector<uint32_t> colors;
+	int bitDepth;
+	size_t rowBytes;
+	// Last row written, packed, for the Up filter of the next call; empty after resume
+	std::vector<unsigned char> previous;
+
+	void setFormat(int width, int height, const uint32_t* palette, int paletteSize);
+	bool writeChunk(const char* type, const unsigned char* data, size_t size);
+	bool write(const void* data, size_t size);
+	// Packs one RGBA row into the file's pixel format
+	void packRow(const unsigned char* rgba, unsigned char* out) const;
+};
+
+// Writes image as PNG, with a palette when it has 256 colours or fewer
+bool writePNG(const char* path, const Image &image, ThreadPool* pool = NULL);
+
+#endif
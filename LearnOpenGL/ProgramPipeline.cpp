@@ -0,0 +1,35 @@
+#include "ProgramPipeline.h"
+#include "GLExt.h"
+
+ProgramPipeline::ProgramPipeline(Shader & vertex, Shader & fragment) : vertex(vertex), fragment(fragment)
+{
+	glGenProgramPipelines(1, &ID);
+	glUseProgramStages(ID, GL_VERTEX_SHADER_BIT, vertex.ID);
+	glUseProgramStages(ID, GL_FRAGMENT_SHADER_BIT, fragment.ID);
+
+	// Catches stage interface mismatches, which a separate link can no longer report
+	int success;
+	glValidateProgramPipeline(ID);
+	glGetProgramPipelineiv(ID, GL_VALIDATE_STATUS, &success);
+	if (!success) {
+		char infoLog[512];
+		glGetProgramPipelineInfoLog(ID, 512, NULL, infoLog);
+		std::cout << "ERROR::PROGRAM_PIPELINE::VALIDATION_FAILED\n" << infoLog << std::endl;
+	}
+}
+
+ProgramPipeline::~ProgramPipeline()
+{
+	glDeleteProgramPipelines(1, &ID);
+}
+
+void ProgramPipeline::bind()
+{
+	glUseProgram(0);
+	glBindProgramPipeline(ID);
+}
+
+void ProgramPipeline::activate(Shader & stage)
+{
+	glActiveShaderProgram(ID, stage.ID);
+}
@@ -0,0 +1,25 @@
+#ifndef PROGRAMPIPELINE_H
+#define PROGRAMPIPELINE_H
+
+#include "Shader.h"
+
+// A program pipeline object combining separately compiled vertex and fragment stages
+// (GL_ARB_separate_shader_objects). Building one links nothing, so any vertex mode can
+// be paired with any colour mode for the cost of a glUseProgramStages call.
+class ProgramPipeline
+{
+public:
+	unsigned int ID;
+	Shader &vertex;
+	Shader &fragment;
+
+	ProgramPipeline(Shader &vertex, Shader &fragment);
+	~ProgramPipeline();
+
+	// Replaces any glUseProgram program, which would take precedence over the pipeline
+	void bind();
+	// Route glUniform* (and so Shader::set) to one of the stages. Must be bound.
+	void activate(Shader &stage);
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include "Renderer.h"
+#include "Sierpinski.h"
+#include "Trace.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Uniform handles, hashed at compile time
+constexpr UniformName U_TIME = uniformName("time");
+constexpr UniformName U_COLOR_OVER = uniformName("colorOver");
+constexpr UniformName U_TRANSFORM = uniformName("transform");
+constexpr UniformName U_PA = uniformName("pA");
+constexpr UniformName U_PB = uniformName("pB");
+constexpr UniformName U_PC = uniformName("pC");
+constexpr UniformName U_DEPTH = uniformName("depth");
+
+const RenderStrategy RENDER_STRATEGIES[] = {
+	{ "vbo", SHADER_STREAM_POS_COLOR, false },
+	{ "vbo_pos2", SHADER_STREAM_POS2, false },
+	{ "indexed", SHADER_STREAM_POS2, true },
+	{ "instanced", SHADER_STREAM_INSTANCED, false },
+	{ "vertex_id", SHADER_STREAM_VERTEX_ID, false },
+	{ "impostor", SHADER_ANALYTIC, false }
+};
+const int RENDER_STRATEGY_COUNT = sizeof(RENDER_STRATEGIES) / sizeof(RENDER_STRATEGIES[0]);
+
+const RenderStrategy* findRenderStrategy(const char * name)
+{
+	for (int i = 0; i < RENDER_STRATEGY_COUNT; i++) {
+		if (strcmp(RENDER_STRATEGIES[i].name, name) == 0)
+			return &RENDER_STRATEGIES[i];
+	}
+	return NULL;
+}
+
+const glm::vec2 Renderer::BASE_A(0.0f, 0.5f);
+const glm::vec2 Renderer::BASE_B(0.5f, -0.5f);
+const glm::vec2 Renderer::BASE_C(-0.5f, -0.5f);
+
+// Only the streams that draw a plain vertex list can be indexed
+static bool canIndex(unsigned int variant)
+{
+	unsigned int stream = variant & SHADER_STREAM_MASK;
+	return !(variant & SHADER_ANALYTIC) && (stream == SHADER_STREAM_POS_COLOR || stream == SHADER_STREAM_POS2);
+}
+
+Renderer::Renderer(ShaderLibrary & shaders, unsigned int variant, int depth, bool indexed, PerfCounters* counters, const RendererMesh* mesh)
+	: pA(BASE_A), pB(BASE_B), pC(BASE_C), depth(depth), variant(variant), shader(shaders.get(variant)),
+	EBO(0), vertexCount(0), instanceCount(0), indexType(GL_UNSIGNED_INT), bufferBytes(0), counters(counters)
+{
+	this->indexed = indexed && canIndex(variant);
+
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	if (this->indexed)
+		glGenBuffers(1, &EBO);
+	layoutVertexArray(VAO, VBO, EBO);
+
+	if (mesh)
+		upload(*mesh);
+	else
+		generate();
+}
+
+Renderer::~Renderer()
+{
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	if (EBO)
+		glDeleteBuffers(1, &EBO);
+}
+
+void Renderer::layoutVertexArray(unsigned int vao, unsigned int vbo, unsigned int ebo)
+{
+	// bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	// SHADER_ANALYTIC draws from an empty VAO, like SHADER_STREAM_VERTEX_ID
+	unsigned int stream = variant & SHADER_STREAM_MASK;
+	if (variant & SHADER_ANALYTIC)
+		stream = SHADER_STREAM_VERTEX_ID;
+	switch (stream) {
+		case SHADER_STREAM_POS_COLOR:
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(0);
+
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+			glEnableVertexAttribArray(1);
+			break;
+		case SHADER_STREAM_POS2:
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(0);
+			break;
+		case SHADER_STREAM_INSTANCED:
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			glVertexAttribDivisor(0, 1);
+			glEnableVertexAttribArray(0);
+			break;
+		default: // SHADER_STREAM_VERTEX_ID draws from an empty VAO
+			break;
+	}
+	// The element buffer binding is VAO state
+	if (ebo)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
+// Collapses bit-identical vertices of a stream of stride floats each. Unique vertices
+// keep the order they first appear in, so the index stream stays as local as the
+// original one.
+static void indexVertices(const std::vector<float> &vertices, int stride, std::vector<float> &unique, std::vector<uint32_t> &indices)
+{
+	size_t count = vertices.size() / stride;
+	size_t bytes = stride * sizeof(float);
+	std::vector<uint32_t> order(count);
+	for (size_t i = 0; i < count; i++)
+		order[i] = (uint32_t)i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return memcmp(&vertices[(size_t)a * stride], &vertices[(size_t)b * stride], bytes) < 0;
+	});
+	// first[i] is the earliest vertex equal to vertex i
+	std::vector<uint32_t> first(count);
+	for (size_t i = 0; i < count; i++) {
+		bool same = i > 0 && memcmp(&vertices[(size_t)order[i] * stride], &vertices[(size_t)order[i - 1] * stride], bytes) == 0;
+		first[order[i]] = same ? first[order[i - 1]] : order[i];
+	}
+	unique.clear();
+	indices.resize(count);
+	uint32_t next = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (first[i] == i) {
+			indices[i] = next++;
+			unique.insert(unique.end(), vertices.begin() + i * stride, vertices.begin() + (i + 1) * stride);
+		}
+		else {
+			indices[i] = indices[first[i]];
+		}
+	}
+}
+
+// Subtrees this deep are built in one call, a cancel is noticed between them
+static const int CANCEL_CHECK_DEPTH = 8;
+
+// drawTris(), drawTrisPos2() or drawTriInstances() for stream, with the levels above
+// CANCEL_CHECK_DEPTH walked here in the same order so cancel can stop it between
+// subtrees. False when it did.
+static bool buildTris(unsigned int stream, glm::vec2 a, glm::vec2 b, glm::vec2 c, int n, glm::vec2 offset, float scale,
+	std::vector<float> &vertices, const std::atomic<bool>* cancel)
+{
+	if (cancel && cancel->load(std::memory_order_relaxed))
+		return false;
+	if (!cancel || n <= CANCEL_CHECK_DEPTH) {
+		switch (stream) {
+			case SHADER_STREAM_POS_COLOR: drawTris(a, b, c, n, vertices);
+				break;
+			case SHADER_STREAM_POS2: drawTrisPos2(a, b, c, n, vertices);
+				break;
+			default: drawTriInstances(a, b, c, n, offset, scale, vertices);
+				break;
+		}
+		return true;
+	}
+	if (stream == SHADER_STREAM_INSTANCED) {
+		float instance[] = { offset.x, offset.y, scale };
+		vertices.insert(vertices.end(), instance, instance + 3);
+		float half = scale / 2;
+		return buildTris(stream, a, b, c, n - 1, offset + a * half, half, vertices, cancel)
+			&& buildTris(stream, a, b, c, n - 1, offset + b * half, half, vertices, cancel)
+			&& buildTris(stream, a, b, c, n - 1, offset + c * half, half, vertices, cancel);
+	}
+	glm::vec2 ab = mid(a, b), bc = mid(b, c), ac = mid(a, c);
+	if (stream == SHADER_STREAM_POS_COLOR) {
+		drawTri(ab, bc, ac, vertices);
+	}
+	else {
+		float tri[] = { ab.x, ab.y, bc.x, bc.y, ac.x, ac.y };
+		vertices.insert(vertices.end(), tri, tri + 6);
+	}
+	return buildTris(stream, a, ab, ac, n - 1, offset, scale, vertices, cancel)
+		&& buildTris(stream, b, ab, bc, n - 1, offset, scale, vertices, cancel)
+		&& buildTris(stream, c, ac, bc, n - 1, offset, scale, vertices, cancel);
+}
+
+bool Renderer::buildMesh(unsigned int variant, int depth, bool indexed, glm::vec2 a, glm::vec2 b, glm::vec2 c, RendererMesh & mesh,
+	const std::atomic<bool>* cancel)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.instanceCount = 0;
+	if (variant & SHADER_ANALYTIC) {
+		// Only the base triangle, sierpinski.frag does the rest
+		mesh.vertexCount = 3;
+		return true;
+	}
+	TRACE_SCOPE_ARG("generate", "depth", depth);
+	std::vector<float> &vertices = mesh.vertices;
+	unsigned int stream = variant & SHADER_STREAM_MASK;
+	switch (stream) {
+		case SHADER_STREAM_POS_COLOR:
+			vertices.reserve((size_t)triangleCount(depth) * 18);
+			// Populatue vertices vector with sierpinskis algorith,
+			if (!buildTris(stream, a, b, c, depth, glm::vec2(0.0f, 0.0f), 1.0f, vertices, cancel))
+				return false;
+			mesh.vertexCount = (GLsizei)(vertices.size() / 6);
+			break;
+		case SHADER_STREAM_POS2:
+			vertices.reserve((size_t)triangleCount(depth) * 6);
+			if (!buildTris(stream, a, b, c, depth, glm::vec2(0.0f, 0.0f), 1.0f, vertices, cancel))
+				return false;
+			mesh.vertexCount = (GLsizei)(vertices.size() / 2);
+			break;
+		case SHADER_STREAM_INSTANCED:
+			vertices.reserve((size_t)triangleCount(depth) * 3);
+			if (!buildTris(stream, a, b, c, depth, glm::vec2(0.0f, 0.0f), 1.0f, vertices, cancel))
+				return false;
+			mesh.vertexCount = 3;
+			mesh.instanceCount = (GLsizei)(vertices.size() / 3);
+			break;
+		default:
+			mesh.vertexCount = (GLsizei)(3 * triangleCount(depth));
+			break;
+	}
+
+	if (indexed && canIndex(variant) && !vertices.empty()) {
+		if (cancel && cancel->load(std::memory_order_relaxed))
+			return false;
+		std::vector<float> unique;
+		indexVertices(vertices, stream == SHADER_STREAM_POS2 ? 2 : 6, unique, mesh.indices);
+		vertices.swap(unique);
+		mesh.vertexCount = (GLsizei)mesh.indices.size();
+	}
+	return true;
+}
+
+void Renderer::generate()
+{
+	// Built first and uploaded after, so the counters can tell the two apart
+	RendererMesh mesh;
+	{
+		PerfScope scope(counters, generationCounters);
+		buildMesh(variant, depth, indexed, pA, pB, pC, mesh);
+	}
+	upload(mesh);
+}
+
+void Renderer::upload(const RendererMesh & mesh)
+{
+	MeshBuffers buffers = { VAO, VBO, EBO, 0, 0, indexType, 0 };
+	{
+		PerfScope scope(counters, uploadCounters);
+		writeMesh(mesh, buffers);
+	}
+	vertexCount = buffers.vertexCount;
+	instanceCount = buffers.instanceCount;
+	indexType = buffers.indexType;
+	bufferBytes = buffers.bufferBytes;
+}
+
+void Renderer::writeMesh(const RendererMesh & mesh, MeshBuffers & buffers)
+{
+	buffers.vertexCount = mesh.vertexCount;
+	buffers.instanceCount = mesh.instanceCount;
+	buffers.bufferBytes = 0;
+	if (mesh.vertices.empty())
+		return;
+
+	TRACE_SCOPE("upload");
+	// Through the copy target, which no VAO or other context's state depends on
+	const std::vector<uint32_t> &indices = mesh.indices;
+	size_t indexBytes = 0;
+	if (!indices.empty()) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.EBO);
+		if (indices.size() <= 65536) {
+			std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+			buffers.indexType = GL_UNSIGNED_SHORT;
+			indexBytes = shortIndices.size() * sizeof(uint16_t);
+			glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, &shortIndices[0], GL_STATIC_DRAW);
+		}
+		else {
+			buffers.indexType = GL_UNSIGNED_INT;
+			indexBytes = indices.size() * sizeof(uint32_t);
+			glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, &indices[0], GL_STATIC_DRAW);
+		}
+	}
+
+	size_t vertexBytes = mesh.vertices.size() * sizeof(float);
+	buffers.bufferBytes = vertexBytes + indexBytes;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.VBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, &mesh.vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+MeshBuffers Renderer::createMeshBuffers()
+{
+	MeshBuffers buffers = { 0, 0, 0, 0, 0, GL_UNSIGNED_INT, 0 };
+	glGenVertexArrays(1, &buffers.VAO);
+	glGenBuffers(1, &buffers.VBO);
+	if (indexed)
+		glGenBuffers(1, &buffers.EBO);
+	layoutVertexArray(buffers.VAO, buffers.VBO, buffers.EBO);
+	// Still drawing from ours
+	glBindVertexArray(VAO);
+	return buffers;
+}
+
+void Renderer::deleteMeshBuffers(MeshBuffers & buffers)
+{
+	glDeleteVertexArrays(1, &buffers.VAO);
+	glDeleteBuffers(1, &buffers.VBO);
+	if (buffers.EBO)
+		glDeleteBuffers(1, &buffers.EBO);
+	buffers.VAO = buffers.VBO = buffers.EBO = 0;
+}
+
+void Renderer::swapMesh(MeshBuffers & buffers, int depth)
+{
+	MeshBuffers current = { VAO, VBO, EBO, vertexCount, instanceCount, indexType, bufferBytes };
+	VAO = buffers.VAO;
+	VBO = buffers.VBO;
+	EBO = buffers.EBO;
+	vertexCount = buffers.vertexCount;
+	instanceCount = buffers.instanceCount;
+	indexType = buffers.indexType;
+	bufferBytes = buffers.bufferBytes;
+	this->depth = depth;
+	buffers = current;
+	// Written on another context, the buffers are only sure to be seen here once
+	// bound again
+	layoutVertexArray(VAO, VBO, EBO);
+}
+
+void Renderer::bind()
+{
+	shader.use();
+	glBindVertexArray(VAO);
+	shader.set(U_PA, pA);
+	shader.set(U_PB, pB);
+	shader.set(U_PC, pC);
+	if (variant & SHADER_ANALYTIC) {
+		shader.set(U_DEPTH, depth);
+		// Coverage comes out as alpha, keep the destination opaque
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	}
+	else {
+		glDisable(GL_BLEND);
+	}
+}
+
+void Renderer::drawFrame(float time)
+{
+	clear();
+	setUniforms(time);
+	submit();
+}
+
+void Renderer::clear()
+{
+	TRACE_SCOPE("clear");
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void Renderer::setUniforms(float time)
+{
+	TRACE_SCOPE("uniforms");
+	if (variant & SHADER_GPU_ANIM) {
+		shader.set(U_TIME, time);
+	}
+	else {
+		glm::mat4 trans = glm::mat4(1.0f);
+		trans = glm::rotate(trans, time, glm::vec3(0.0, 1.0, 0.0));
+		shader.set(U_TRANSFORM, trans);
+	}
+	if ((variant & SHADER_COLOR_MASK) == SHADER_COLOR_UNIFORM) {
+		float h = (sin(time) / 2.0f) + 0.5f;
+		h = 360.0f * h;
+		ColorVec3 color = getHSVColor(h, 1.0f, 1.0f); // Generate from degree with HSV
+		shader.set(U_COLOR_OVER, glm::vec3(color.r, color.g, color.b));
+	}
+	else if ((variant & SHADER_COLOR_MASK) == SHADER_COLOR_HUE) {
+		shader.set(U_TIME, time);
+	}
+}
+
+void Renderer::submit()
+{
+	TRACE_SCOPE("submit");
+	if (indexed)
+		glDrawElements(GL_TRIANGLES, vertexCount, indexType, (void*)0);
+	else if (instanceCount > 0)
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
+	else
+		glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+}
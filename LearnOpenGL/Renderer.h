@@ -0,0 +1,118 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PerfCounters.h"
+#include "ShaderLibrary.h"
+
+// A way of drawing the scene: the stream bits of a ShaderVariant (or SHADER_ANALYTIC)
+// and whether the mesh is indexed. Named for the command line and the shootout.
+struct RenderStrategy {
+	const char* name;
+	unsigned int stream;
+	bool indexed;
+};
+extern const RenderStrategy RENDER_STRATEGIES[];
+extern const int RENDER_STRATEGY_COUNT;
+// NULL for an unknown name
+const RenderStrategy* findRenderStrategy(const char* name);
+// Deepest mesh the app builds: depth 13 is 4.8 million triangles, a third of a GB as
+// POS_COLOR. SHADER_ANALYTIC has no mesh and goes deeper.
+const int MAX_MESH_DEPTH = 13;
+const int MAX_ANALYTIC_DEPTH = 24;
+
+// A mesh as Renderer::buildMesh() leaves it for upload(). Building it takes no GL,
+// so it can happen on any thread, e.g. while the window is still being created.
+struct RendererMesh {
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices; // empty unless indexed
+	GLsizei vertexCount;
+	GLsizei instanceCount;
+};
+
+// Where a mesh lives on the GPU and how to draw it, for a second mesh written while
+// the Renderer's own one draws (see MeshRegenerator)
+struct MeshBuffers {
+	unsigned int VAO, VBO, EBO;
+	GLsizei vertexCount;
+	GLsizei instanceCount;
+	GLenum indexType;
+	size_t bufferBytes;
+};
+
+// The triangle scene: geometry for one of the ShaderVariant stream modes, the shader
+// variant drawing it and the per-frame animation uniforms. Shared by the window, the
+// headless backend and anything else that needs a frame rendered.
+class Renderer
+{
+public:
+	// Original Points For Triangle
+	glm::vec2 pA, pB, pC;
+	int depth;
+	unsigned int variant;
+	// Draw with glDrawElements from deduplicated vertices (POS_COLOR and POS2 only)
+	bool indexed;
+	Shader &shader;
+
+	unsigned int VAO, VBO, EBO;
+	GLsizei vertexCount;   // vertices per draw, indices when indexed
+	GLsizei instanceCount; // 0 unless SHADER_STREAM_INSTANCED
+	GLenum indexType;      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	size_t bufferBytes;    // GPU memory held by the current mesh, indices included
+	// When set, generate() adds what it counts building the mesh (indexing included)
+	// and uploading it to these
+	PerfCounters* counters;
+	PerfSample generationCounters, uploadCounters;
+
+	// The base triangle every Renderer starts with
+	static const glm::vec2 BASE_A, BASE_B, BASE_C;
+
+	// Needs a current context. Generates and uploads the mesh for depth, or uploads
+	// mesh when given, built by buildMesh() for the same variant, depth and indexed.
+	Renderer(ShaderLibrary &shaders, unsigned int variant, int depth, bool indexed = false, PerfCounters* counters = NULL,
+		const RendererMesh* mesh = NULL);
+	~Renderer();
+
+	// What generate() uploads for the base triangle a, b, c. Thread-safe, no GL.
+	// Stops early and returns false once cancel is set.
+	static bool buildMesh(unsigned int variant, int depth, bool indexed, glm::vec2 a, glm::vec2 b, glm::vec2 c, RendererMesh &mesh,
+		const std::atomic<bool>* cancel = NULL);
+	// Writes mesh into the buffers' VBO and EBO and records how to draw it. Works on
+	// any context sharing objects with this one's, the VAO is left alone.
+	static void writeMesh(const RendererMesh &mesh, MeshBuffers &buffers);
+
+	// A second VAO and buffers laid out like this one's, empty
+	MeshBuffers createMeshBuffers();
+	void deleteMeshBuffers(MeshBuffers &buffers);
+	// Draws the mesh in buffers, built for depth, from now on and hands the current
+	// one back in buffers. Call bind() again after.
+	void swapMesh(MeshBuffers &buffers, int depth);
+
+	// Make the program/VAO current and set the constant uniforms. Call again after
+	// anything else used the context, e.g. a shader hot reload.
+	void bind();
+	// Regenerate and upload the mesh for the current depth and base triangle (nothing
+	// to upload for SHADER_ANALYTIC, call bind() again for the new depth)
+	void generate();
+	// The upload half of generate()
+	void upload(const RendererMesh &mesh);
+	// Clear and draw one frame at animation time seconds. Expects bind().
+	void drawFrame(float time);
+	// drawFrame() in its three steps, for timing them apart
+	void clear();
+	void setUniforms(float time);
+	void submit();
+
+private:
+	// Points vao's attributes at vbo, and its element buffer at ebo
+	void layoutVertexArray(unsigned int vao, unsigned int vbo, unsigned int ebo);
+};
+
+#endif
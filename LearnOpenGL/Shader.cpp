@@ -1,6 +1,13 @@
 #include "Shader.h"
+#include "GLExt.h"
+#include "ShaderCache.h"
+#include "Trace.h"
 
-Shader::Shader(const char * vertexPath, const char * fragmentPath)
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+
+Shader::Shader(const char * vertexPath, const char * fragmentPath, const ShaderCache * cache)
 {
 	// Read Shader Files
 	std::string vertexCode;
@@ -28,47 +35,180 @@ Shader::Shader(const char * vertexPath, const char * fragmentPath)
 	catch (std::ifstream::failure e) {
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
 	}
+	build(vertexCode, fragmentCode, cache);
+}
+
+Shader::Shader(const std::string & vertexCode, const std::string & fragmentCode, const ShaderCache * cache)
+{
+	build(vertexCode, fragmentCode, cache);
+}
+
+Shader::Shader(GLenum stage, const std::string & code)
+{
+	fromCache = false;
+	const char* source = code.c_str();
+	// Compiles, links with GL_PROGRAM_SEPARABLE set and discards the shader object
+	ID = glCreateShaderProgramv(stage, 1, &source);
+	int success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success) {
+		char infoLog[512];
+		glGetProgramInfoLog(ID, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::" << (stage == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT")
+			<< "::SEPARABLE_STAGE_FAILED\n" << infoLog << std::endl;
+	}
+	reflect();
+}
+
+void Shader::build(const std::string & vertexCode, const std::string & fragmentCode, const ShaderCache * cache)
+{
+	// Try a previously linked binary before compiling anything
+	fromCache = false;
+	uint64_t key = 0;
+	if (cache && cache->enabled()) {
+		key = cache->key(vertexCode, fragmentCode);
+		ID = cache->load(key);
+		if (ID != 0) {
+			fromCache = true;
+			reflect();
+			return;
+		}
+	}
+
+	PendingProgram pending = beginProgram(vertexCode, fragmentCode, cache && cache->enabled());
+	ID = pending.program;
+	if (finishProgram(pending, false) && cache && cache->enabled())
+		cache->store(key, ID);
+
+	reflect();
+}
+
+Shader::PendingProgram Shader::beginProgram(const std::string & vertexCode, const std::string & fragmentCode, bool retrievable)
+{
+	TRACE_SCOPE("compile shaders");
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	// Compile Shaders
-	unsigned int vertex, fragment;
+	// Compile Shaders. Status is only queried in finishProgram, so with
+	// KHR_parallel_shader_compile none of this blocks.
+	PendingProgram pending;
+	pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+	glCompileShader(pending.vertex);
+
+	pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+	glCompileShader(pending.fragment);
+
+	// Shader Program / Linking
+	pending.program = glCreateProgram();
+	glAttachShader(pending.program, pending.vertex);
+	glAttachShader(pending.program, pending.fragment);
+	if (retrievable)
+		glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending.program);
+	return pending;
+}
+
+bool Shader::finishProgram(PendingProgram & pending, bool deleteOnFailure)
+{
+	// Where the compile and link are waited for
+	TRACE_SCOPE("link program");
 	int success;
 	char infoLog[512];
 
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(pending.vertex, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(pending.vertex, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
 
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(vertex);
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(pending.fragment, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+		glGetShaderInfoLog(pending.fragment, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
 
-	// Shader Program / Linking
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
-	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	bool linked = true;
+	glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
 	if (!success) {
-		glGetProgramInfoLog(ID, 512, NULL, infoLog);
+		glGetProgramInfoLog(pending.program, 512, NULL, infoLog);
 		std::cout << "ERROR:SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		linked = false;
+	}
+
+	glDeleteShader(pending.vertex);
+	glDeleteShader(pending.fragment);
+	if (!linked && deleteOnFailure) {
+		glDeleteProgram(pending.program);
+		pending.program = 0;
+	}
+	return linked;
+}
+
+void Shader::replace(unsigned int program)
+{
+	glDeleteProgram(ID);
+	ID = program;
+	fromCache = false;
+	reflect();
+}
+
+void Shader::reflect()
+{
+	uniforms.clear();
+	uniformNames.clear();
+	int count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> name(maxLength + 1);
+	for (int i = 0; i < count; i++) {
+		int size;
+		GLenum type;
+		glGetActiveUniform(ID, i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+		// Arrays come back as "name[0]", register them under their base name
+		std::string base(&name[0]);
+		size_t bracket = base.find('[');
+		if (bracket != std::string::npos)
+			base.resize(bracket);
+
+		Uniform uniform;
+		uniform.name = uniformName(base.c_str());
+		uniform.location = glGetUniformLocation(ID, &name[0]);
+		uniform.type = type;
+		uniform.written = false;
+		uniform.mismatched = false;
+		if (uniform.location < 0) // uniform block members have no location
+			continue;
+		for (size_t j = 0; j < uniforms.size(); j++) {
+			if (uniforms[j].name == uniform.name)
+				std::cout << "ERROR::SHADER::UNIFORM_NAME_COLLISION " << uniformNames[j] << " and " << base << std::endl;
+		}
+		uniforms.push_back(uniform);
+		uniformNames.push_back(base);
 	}
+}
 
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+// Whether a uniform declared as declared can be set by the setter for type. Booleans
+// and samplers are set as ints.
+static bool settable(GLenum declared, GLenum type)
+{
+	if (declared == type)
+		return true;
+	if (type != GL_INT)
+		return false;
+	switch (declared) {
+		case GL_BOOL:
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_RECT: case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_2D_SHADOW:
+		case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+			return true;
+		default:
+			return false;
+	}
 }
 
 void Shader::use()
@@ -76,17 +216,95 @@ void Shader::use()
 	glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string & name, bool value) const
+void Shader::setBool(const std::string & name, bool value)
+{
+	set(uniformName(name.c_str()), value);
+}
+
+void Shader::setInt(const std::string & name, int value)
+{
+	set(uniformName(name.c_str()), value);
+}
+
+void Shader::setFloat(const std::string & name, float value)
+{
+	set(uniformName(name.c_str()), value);
+}
+
+int Shader::location(UniformName name) const
+{
+	for (size_t i = 0; i < uniforms.size(); i++) {
+		if (uniforms[i].name == name)
+			return uniforms[i].location;
+	}
+	return -1;
+}
+
+Shader::Uniform* Shader::changed(UniformName name, GLenum type, const void * value, size_t size)
+{
+	for (size_t i = 0; i < uniforms.size(); i++) {
+		Uniform &uniform = uniforms[i];
+		if (uniform.name != name)
+			continue;
+		if (!settable(uniform.type, type)) {
+			if (!uniform.mismatched)
+				std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << uniformNames[i] << " is declared as 0x"
+					<< std::hex << uniform.type << ", set as 0x" << type << std::dec << std::endl;
+			uniform.mismatched = true;
+			return NULL;
+		}
+		if (uniform.written && memcmp(uniform.shadow, value, size) == 0)
+			return NULL;
+		memcpy(uniform.shadow, value, size);
+		uniform.written = true;
+		return &uniform;
+	}
+	return NULL;
+}
+
+void Shader::set(UniformName name, bool value)
+{
+	set(name, (int)value);
+}
+
+void Shader::set(UniformName name, int value)
+{
+	if (Uniform* u = changed(name, GL_INT, &value, sizeof(value)))
+		glUniform1i(u->location, value);
+}
+
+void Shader::set(UniformName name, float value)
+{
+	if (Uniform* u = changed(name, GL_FLOAT, &value, sizeof(value)))
+		glUniform1f(u->location, value);
+}
+
+void Shader::set(UniformName name, const glm::vec2 & value)
+{
+	if (Uniform* u = changed(name, GL_FLOAT_VEC2, &value, sizeof(value)))
+		glUniform2fv(u->location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(UniformName name, const glm::vec3 & value)
+{
+	if (Uniform* u = changed(name, GL_FLOAT_VEC3, &value, sizeof(value)))
+		glUniform3fv(u->location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(UniformName name, const glm::vec4 & value)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	if (Uniform* u = changed(name, GL_FLOAT_VEC4, &value, sizeof(value)))
+		glUniform4fv(u->location, 1, glm::value_ptr(value));
 }
 
-void Shader::setInt(const std::string & name, int value) const
+void Shader::set(UniformName name, const glm::mat3 & value)
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	if (Uniform* u = changed(name, GL_FLOAT_MAT3, &value, sizeof(value)))
+		glUniformMatrix3fv(u->location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void Shader::setFloat(const std::string & name, float value) const
+void Shader::set(UniformName name, const glm::mat4 & value)
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	if (Uniform* u = changed(name, GL_FLOAT_MAT4, &value, sizeof(value)))
+		glUniformMatrix4fv(u->location, 1, GL_FALSE, glm::value_ptr(value));
 }
@@ -2,27 +2,94 @@
 #define	SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>	
 
+// Uniform names are hashed (FNV-1a) at compile time, e.g.
+//   constexpr UniformName U_TIME = uniformName("time");
+typedef uint32_t UniformName;
+constexpr UniformName uniformName(const char* name, UniformName hash = 2166136261u)
+{
+	return *name ? uniformName(name + 1, (hash ^ (unsigned char)*name) * 16777619u) : hash;
+}
+
+class ShaderCache;
+
 class Shader
 {
 public:
 	// Program ID
 	unsigned int ID;
+	// True when the program was restored from a cached binary instead of compiled
+	bool fromCache;
 	
-	Shader(const char* vertexPath, const char* fragmentPath);
+	Shader(const char* vertexPath, const char* fragmentPath, const ShaderCache* cache = NULL);
+	// From source text already in memory (see ShaderLibrary)
+	Shader(const std::string &vertexCode, const std::string &fragmentCode, const ShaderCache* cache = NULL);
+	// A single separable stage (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER) for a
+	// ProgramPipeline, needs GLExt.separateShaderObjects
+	Shader(GLenum stage, const std::string &code);
 
 	// Activate Shader
 	void use();
 	// Utility Functions
-	void setBool(const std::string &name, bool value) const;
-	void setInt(const std::string &name, int value) const;
-	void setFloat(const std::string &name, float value) const;
+	void setBool(const std::string &name, bool value);
+	void setInt(const std::string &name, int value);
+	void setFloat(const std::string &name, float value);
+
+	// Typed setters, resolved through the uniform table. Writing the value a uniform
+	// already holds is skipped, and so is a setter that doesn't match the type the
+	// shader declares (logged the first time). The program must be in use.
+	void set(UniformName name, bool value);
+	void set(UniformName name, int value);
+	void set(UniformName name, float value);
+	void set(UniformName name, const glm::vec2 &value);
+	void set(UniformName name, const glm::vec3 &value);
+	void set(UniformName name, const glm::vec4 &value);
+	void set(UniformName name, const glm::mat3 &value);
+	void set(UniformName name, const glm::mat4 &value);
+	// -1 if the linker dropped the uniform (or it never existed)
+	int location(UniformName name) const;
+
+	// Swap in another linked program (e.g. a hot reload), deleting the current one.
+	// Cached uniform values are forgotten, callers re-set what they need after use().
+	void replace(unsigned int program);
+
+	// Compile and link split in two, so the status queries that block can be deferred
+	struct PendingProgram {
+		unsigned int program;
+		unsigned int vertex;
+		unsigned int fragment;
+	};
+	static PendingProgram beginProgram(const std::string &vertexCode, const std::string &fragmentCode, bool retrievable);
+	// Logs compile/link errors. On failure the program is deleted (and zeroed) if deleteOnFailure.
+	static bool finishProgram(PendingProgram &pending, bool deleteOnFailure);
+
+private:
+	struct Uniform {
+		UniformName name;
+		int location;
+		GLenum type;
+		bool written;
+		bool mismatched; // set with the wrong type once, and logged
+		unsigned char shadow[16 * sizeof(float)]; // last value sent to GL
+	};
+	// Every active uniform, enumerated once after linking
+	std::vector<Uniform> uniforms;
+	std::vector<std::string> uniformNames; // same order, for error messages
 
+	void build(const std::string &vertexCode, const std::string &fragmentCode, const ShaderCache* cache);
+	// Also logs uniforms whose names hash alike, only the first of them can be set
+	void reflect();
+	// Returns the slot to write to, or NULL when the uniform is unknown, not declared
+	// as type or already holds value
+	Uniform* changed(UniformName name, GLenum type, const void* value, size_t size);
 };
 
 
@@ -0,0 +1,138 @@
+#include "ShaderCache.h"
+#include "GLExt.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const char CACHE_MAGIC[4] = { 'S', 'P', 'B', '1' };
+
+static uint64_t fnv1a(const std::string &data, uint64_t hash)
+{
+	for (size_t i = 0; i < data.size(); i++)
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+	return hash;
+}
+
+static std::string glString(GLenum name)
+{
+	const char* value = (const char*)glGetString(name);
+	return value ? value : "";
+}
+
+ShaderCache::ShaderCache(const std::string & directory) : directory(directory)
+{
+	driver = glString(GL_VENDOR) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+	available = GLExt.programBinary;
+	if (available) {
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+}
+
+bool ShaderCache::enabled() const
+{
+	return available;
+}
+
+uint64_t ShaderCache::key(const std::string & vertexCode, const std::string & fragmentCode) const
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = fnv1a(vertexCode, hash);
+	hash = fnv1a(std::string(1, '\0'), hash);
+	hash = fnv1a(fragmentCode, hash);
+	hash = fnv1a(std::string(1, '\0'), hash);
+	return fnv1a(driver, hash);
+}
+
+std::string ShaderCache::path(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+unsigned int ShaderCache::load(uint64_t key) const
+{
+	if (!available)
+		return 0;
+
+	std::ifstream file(path(key).c_str(), std::ios::binary | std::ios::ate);
+	if (!file)
+		return 0;
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0);
+	char magic[4];
+	GLenum format = 0;
+	uint32_t length = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&format, sizeof(format));
+	file.read((char*)&length, sizeof(length));
+	// A corrupt length must not size the allocation, it can't be more than what follows
+	std::streamoff header = sizeof(magic) + sizeof(format) + sizeof(length);
+	if (!file || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || length == 0 || (std::streamoff)length > fileSize - header)
+		return 0;
+	std::vector<char> binary(length);
+	file.read(&binary[0], length);
+	if (!file)
+		return 0;
+
+	unsigned int program = glCreateProgram();
+	glProgramBinary(program, format, &binary[0], (GLsizei)length);
+	int success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		// Stale or foreign binary, drop it so the next store replaces it
+		glDeleteProgram(program);
+		file.close();
+		remove(path(key).c_str());
+		return 0;
+	}
+	return program;
+}
+
+void ShaderCache::store(uint64_t key, unsigned int program) const
+{
+	if (!available)
+		return;
+
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, &binary[0]);
+	if (written <= 0)
+		return;
+
+	// Write to a temporary name first so a crash never leaves a truncated entry behind
+	std::string target = path(key);
+	std::string temp = target + ".tmp";
+	std::ofstream file(temp.c_str(), std::ios::binary | std::ios::trunc);
+	uint32_t size = (uint32_t)written;
+	file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	file.write((const char*)&format, sizeof(format));
+	file.write((const char*)&size, sizeof(size));
+	file.write(&binary[0], written);
+	file.close();
+	if (!file) {
+		remove(temp.c_str());
+		return;
+	}
+	remove(target.c_str());
+	if (rename(temp.c_str(), target.c_str()) != 0)
+		std::cout << "ERROR::SHADER_CACHE::WRITE_FAILED " << target << std::endl;
+}
@@ -0,0 +1,33 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (glGetProgramBinary). Entries are keyed by
+// the shader source text and the driver's vendor/renderer/version strings, so a driver
+// update simply misses instead of feeding the driver a binary it will reject.
+class ShaderCache
+{
+public:
+	// Needs a current context with loadGLExtensions done
+	ShaderCache(const std::string &directory);
+
+	// False when the driver cannot save program binaries, load/store then do nothing
+	bool enabled() const;
+
+	uint64_t key(const std::string &vertexCode, const std::string &fragmentCode) const;
+	// Returns a linked program, or 0 on a miss or when the driver rejects the binary
+	unsigned int load(uint64_t key) const;
+	// program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void store(uint64_t key, unsigned int program) const;
+
+private:
+	std::string directory;
+	std::string driver;
+	bool available;
+
+	std::string path(uint64_t key) const;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "ShaderLibrary.h"
+#include "ShaderSources.h"
+#include "Trace.h"
+
+ShaderLibrary::ShaderLibrary(const ShaderCache * cache) : compiles(0), cache(cache)
+{
+	for (int i = 0; i < SHADER_VARIANT_COUNT; i++) {
+		shaders[i] = NULL;
+		pipelines[i] = NULL;
+	}
+	for (int i = 0; i < 2 * (SHADER_VERTEX_MASK + 1); i++)
+		vertexStages[i] = NULL;
+	for (int i = 0; i < 2 * ((SHADER_COLOR_MASK >> 3) + 1); i++)
+		fragmentStages[i] = NULL;
+}
+
+static void deleteShader(Shader* shader)
+{
+	if (shader)
+		glDeleteProgram(shader->ID);
+	delete shader;
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+	// Pipelines first, they reference the stages
+	for (int i = 0; i < SHADER_VARIANT_COUNT; i++) {
+		delete pipelines[i];
+		deleteShader(shaders[i]);
+	}
+	for (int i = 0; i < 2 * (SHADER_VERTEX_MASK + 1); i++)
+		deleteShader(vertexStages[i]);
+	for (int i = 0; i < 2 * ((SHADER_COLOR_MASK >> 3) + 1); i++)
+		deleteShader(fragmentStages[i]);
+}
+
+static unsigned int normalize(unsigned int variant)
+{
+	variant &= SHADER_VARIANT_COUNT - 1;
+	// The analytic stages draw no mesh, every stream mode is the same program
+	if (variant & SHADER_ANALYTIC)
+		variant &= ~SHADER_STREAM_MASK;
+	// The hue is worked out per vertex, next to the spin
+	if ((variant & SHADER_COLOR_MASK) == SHADER_COLOR_HUE)
+		variant |= SHADER_GPU_ANIM;
+	return variant;
+}
+
+Shader & ShaderLibrary::get(unsigned int variant)
+{
+	variant = normalize(variant);
+	if (!shaders[variant]) {
+		TRACE_SCOPE_ARG("load shader variant", "variant", variant);
+		std::string prefix = defines(variant);
+		shaders[variant] = new Shader(specialize(SHADER_VERT_SOURCE, prefix), specialize(fragmentSource(variant), prefix), cache);
+		if (!shaders[variant]->fromCache)
+			compiles += 2;
+	}
+	return *shaders[variant];
+}
+
+ProgramPipeline & ShaderLibrary::pipeline(unsigned int variant)
+{
+	variant = normalize(variant);
+	if (!pipelines[variant]) {
+		unsigned int v = vertexStage(variant);
+		unsigned int f = fragmentStage(variant);
+		if (!vertexStages[v]) {
+			vertexStages[v] = new Shader(GL_VERTEX_SHADER, specialize(SHADER_VERT_SOURCE, "#define SEPARABLE\n" + vertexDefines(variant)));
+			compiles++;
+		}
+		if (!fragmentStages[f]) {
+			fragmentStages[f] = new Shader(GL_FRAGMENT_SHADER, specialize(fragmentSource(variant), "#define SEPARABLE\n" + fragmentDefines(variant)));
+			compiles++;
+		}
+		pipelines[variant] = new ProgramPipeline(*vertexStages[v], *fragmentStages[f]);
+	}
+	return *pipelines[variant];
+}
+
+unsigned int ShaderLibrary::vertexStage(unsigned int variant)
+{
+	return (variant & SHADER_VERTEX_MASK) + (variant & SHADER_ANALYTIC ? SHADER_VERTEX_MASK + 1 : 0);
+}
+
+unsigned int ShaderLibrary::fragmentStage(unsigned int variant)
+{
+	return ((variant & SHADER_COLOR_MASK) >> 3) + (variant & SHADER_ANALYTIC ? (SHADER_COLOR_MASK >> 3) + 1 : 0);
+}
+
+const char* ShaderLibrary::fragmentSource(unsigned int variant)
+{
+	return variant & SHADER_ANALYTIC ? SIERPINSKI_FRAG_SOURCE : SHADER_FRAG_SOURCE;
+}
+
+std::string ShaderLibrary::vertexDefines(unsigned int variant)
+{
+	std::string prefix;
+	if (variant & SHADER_ANALYTIC) {
+		prefix += "#define ANALYTIC\n";
+	}
+	else {
+		switch (variant & SHADER_STREAM_MASK) {
+			case SHADER_STREAM_POS2: prefix += "#define STREAM_POS2\n";
+				break;
+			case SHADER_STREAM_VERTEX_ID: prefix += "#define STREAM_VERTEX_ID\n";
+				break;
+			case SHADER_STREAM_INSTANCED: prefix += "#define STREAM_INSTANCED\n";
+				break;
+			default: prefix += "#define STREAM_POS_COLOR\n";
+		}
+	}
+	if (normalize(variant) & SHADER_GPU_ANIM)
+		prefix += "#define GPU_ANIM\n";
+	return prefix;
+}
+
+std::string ShaderLibrary::fragmentDefines(unsigned int variant)
+{
+	switch (variant & SHADER_COLOR_MASK) {
+		case SHADER_COLOR_HUE: return "#define COLOR_HUE\n";
+		case SHADER_COLOR_VERTEX: return "#define COLOR_VERTEX\n";
+		default: return "#define COLOR_UNIFORM\n";
+	}
+}
+
+std::string ShaderLibrary::defines(unsigned int variant)
+{
+	return vertexDefines(variant) + fragmentDefines(variant);
+}
+
+std::string ShaderLibrary::specialize(const std::string & source, const std::string & defines)
+{
+	// #version has to stay the first line
+	size_t lineEnd = source.find('\n');
+	if (source.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos)
+		return defines + source;
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+static bool loadFlattened(const std::string &path, std::string &source, int depth)
+{
+	std::ifstream file(path.c_str());
+	if (!file || depth > 16)
+		return false;
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+			size_t open = line.find('"', start);
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close != std::string::npos) {
+				if (!loadFlattened(directory + line.substr(open + 1, close - open - 1), source, depth + 1))
+					return false;
+				continue;
+			}
+		}
+		source += line;
+		source += '\n';
+	}
+	return true;
+}
+
+bool ShaderLibrary::loadFile(const std::string & path, std::string & source)
+{
+	TRACE_SCOPE("load shader file");
+	source.clear();
+	return loadFlattened(path, source, 0);
+}
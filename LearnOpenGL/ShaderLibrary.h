@@ -0,0 +1,80 @@
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+
+#include <string>
+
+#include "Shader.h"
+#include "ProgramPipeline.h"
+
+class ShaderCache;
+
+// Permutation bits of the embedded Sierpinski shaders (see shader.vert/shader.frag)
+enum ShaderVariant {
+	// Vertex stage: source of the vertices, two bits
+	SHADER_STREAM_POS_COLOR = 0,  // interleaved vec3 position + vec3 colour, 24 bytes/vertex
+	SHADER_STREAM_POS2 = 1,       // vec2 position only, 8 bytes/vertex
+	SHADER_STREAM_VERTEX_ID = 2,  // no buffer, positions derived from gl_VertexID
+	SHADER_STREAM_INSTANCED = 3,  // one vec3 offset/scale per triangle, 12 bytes/triangle
+	SHADER_STREAM_MASK = 3,
+	// Vertex stage: spin from the time uniform instead of transform
+	SHADER_GPU_ANIM = 4,
+	SHADER_VERTEX_MASK = 7,
+
+	// Fragment stage: colour mode, two bits
+	SHADER_COLOR_UNIFORM = 0,     // colorOver
+	SHADER_COLOR_HUE = 8,         // hue cycled from time by the vertex stage, implies SHADER_GPU_ANIM
+	SHADER_COLOR_VERTEX = 16,     // colour handed down by the vertex stage
+	SHADER_COLOR_MASK = 24,
+
+	// Both stages: one base triangle shaded by sierpinski.frag instead of the mesh,
+	// the stream bits are ignored
+	SHADER_ANALYTIC = 32,
+
+	SHADER_VARIANT_COUNT = 64
+};
+
+// Builds the variants of the shaders embedded by embed_shaders.py. Everything is
+// compiled the first time it is asked for, so startup pays only for what is drawn.
+//
+// get() links a whole program per variant. With GLExt.separateShaderObjects,
+// pipeline() instead compiles each vertex and fragment stage variant once and pairs
+// them in a ProgramPipeline, so compiles grow with the stage variants in use
+// rather than with the combinations of them (BM_ShaderVariants compares the two).
+class ShaderLibrary
+{
+public:
+	// Shader stages compiled so far, two per get() variant, one per pipeline() stage
+	int compiles;
+
+	ShaderLibrary(const ShaderCache* cache = NULL);
+	~ShaderLibrary();
+
+	Shader& get(unsigned int variant);
+	ProgramPipeline& pipeline(unsigned int variant);
+
+	// "#define ..." lines for a variant, both stages
+	static std::string defines(unsigned int variant);
+	// Embedded source of a variant's fragment stage
+	static const char* fragmentSource(unsigned int variant);
+	// Inserts defines right after the #version line
+	static std::string specialize(const std::string &source, const std::string &defines);
+	// Reads a shader from disk resolving #include "file" the way embed_shaders.py does,
+	// for hot reloading the sources the embedded copies were built from
+	static bool loadFile(const std::string &path, std::string &source);
+
+private:
+	const ShaderCache* cache;
+	Shader* shaders[SHADER_VARIANT_COUNT];
+	// Indexed by vertexStage()/fragmentStage()
+	Shader* vertexStages[2 * (SHADER_VERTEX_MASK + 1)];
+	Shader* fragmentStages[2 * ((SHADER_COLOR_MASK >> 3) + 1)];
+	ProgramPipeline* pipelines[SHADER_VARIANT_COUNT];
+
+	static unsigned int vertexStage(unsigned int variant);
+	static unsigned int fragmentStage(unsigned int variant);
+
+	static std::string vertexDefines(unsigned int variant);
+	static std::string fragmentDefines(unsigned int variant);
+};
+
+#endif
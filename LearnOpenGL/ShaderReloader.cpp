@@ -0,0 +1,236 @@
+#include "ShaderReloader.h"
+#include "GLExt.h"
+#include "ShaderLibrary.h"
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static std::string directoryOf(const std::string &path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+static std::string fileOf(const std::string &path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool isInclude(const char* name)
+{
+	size_t length = strlen(name);
+	return length > 5 && strcmp(name + length - 5, ".glsl") == 0;
+}
+
+ShaderReloader::ShaderReloader(Shader & shader, const char * vertexPath, const char * fragmentPath, GLFWwindow * window, const std::string & defines)
+	: shader(shader), vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), running(true),
+	hasSources(false), parallel(GLExt.parallelShaderCompile), building(false), workerContext(NULL), finished(0)
+{
+	if (parallel) {
+		// Let the driver pick how many compiler threads to use
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+	else if (window != NULL) {
+		// GLFW windows may only be created on the main thread, so the worker's
+		// (invisible) context is made here and handed over
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		workerContext = glfwCreateWindow(1, 1, "", NULL, window);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (workerContext == NULL)
+			std::cout << "ERROR::SHADER_RELOADER::CONTEXT_CREATION_FAILED, building on the render thread" << std::endl;
+		else
+			worker = std::thread(&ShaderReloader::compileLoop, this);
+	}
+	watcher = std::thread(&ShaderReloader::watch, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	{
+		// Under the lock, or compileLoop could test running just before it changes and
+		// sleep through the notify
+		std::lock_guard<std::mutex> lock(sourceMutex);
+		running = false;
+	}
+	sourceReady.notify_all();
+	if (watcher.joinable())
+		watcher.join();
+	if (worker.joinable())
+		worker.join();
+	if (workerContext)
+		glfwDestroyWindow(workerContext);
+
+	unsigned int orphan = finished.exchange(0);
+	if (orphan)
+		glDeleteProgram(orphan);
+	if (building) {
+		Shader::finishProgram(pending, true);
+		glDeleteProgram(pending.program);
+	}
+}
+
+bool ShaderReloader::readSources()
+{
+	std::string vertex, fragment;
+	if (!ShaderLibrary::loadFile(vertexPath, vertex) || !ShaderLibrary::loadFile(fragmentPath, fragment))
+		return false; // mid-save, the next event will pick it up
+
+	std::lock_guard<std::mutex> lock(sourceMutex);
+	vertexCode = ShaderLibrary::specialize(vertex, defines);
+	fragmentCode = ShaderLibrary::specialize(fragment, defines);
+	hasSources = true;
+	sourceReady.notify_one();
+	return true;
+}
+
+bool ShaderReloader::takeSources(std::string & vertex, std::string & fragment)
+{
+	std::lock_guard<std::mutex> lock(sourceMutex);
+	if (!hasSources)
+		return false;
+	vertex.swap(vertexCode);
+	fragment.swap(fragmentCode);
+	hasSources = false;
+	return true;
+}
+
+#ifdef __linux__
+void ShaderReloader::watch()
+{
+	int fd = inotify_init1(IN_NONBLOCK);
+	if (fd < 0) {
+		std::cout << "ERROR::SHADER_RELOADER::INOTIFY_INIT_FAILED" << std::endl;
+		return;
+	}
+	// Watch the directories rather than the files: editors often save by writing a
+	// new file and renaming it over the old one, which would orphan a file watch.
+	std::string vertexName = fileOf(vertexPath), fragmentName = fileOf(fragmentPath);
+	int vertexWatch = inotify_add_watch(fd, directoryOf(vertexPath).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	int fragmentWatch = inotify_add_watch(fd, directoryOf(fragmentPath).c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+	alignas(struct inotify_event) char buffer[4096];
+	while (running) {
+		pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		bool changed = false;
+		ssize_t length;
+		while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+			for (char* p = buffer; p < buffer + length; ) {
+				struct inotify_event* event = (struct inotify_event*)p;
+				if (event->len > 0) {
+					if ((event->wd == vertexWatch && (vertexName == event->name || isInclude(event->name))) ||
+						(event->wd == fragmentWatch && (fragmentName == event->name || isInclude(event->name))))
+						changed = true;
+				}
+				p += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		if (changed)
+			readSources();
+	}
+	close(fd);
+}
+#else
+static long long modifiedTime(const std::string &path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 ? (long long)info.st_mtime : 0;
+}
+
+void ShaderReloader::watch()
+{
+	// No inotify here, poll modification times instead
+	long long vertexTime = modifiedTime(vertexPath), fragmentTime = modifiedTime(fragmentPath);
+	while (running) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		long long v = modifiedTime(vertexPath), f = modifiedTime(fragmentPath);
+		if (v != vertexTime || f != fragmentTime) {
+			vertexTime = v;
+			fragmentTime = f;
+			readSources();
+		}
+	}
+}
+#endif
+
+void ShaderReloader::compileLoop()
+{
+	glfwMakeContextCurrent(workerContext);
+	while (running) {
+		std::string vertex, fragment;
+		{
+			std::unique_lock<std::mutex> lock(sourceMutex);
+			sourceReady.wait(lock, [this] { return hasSources || !running; });
+		}
+		if (!takeSources(vertex, fragment))
+			continue;
+
+		Shader::PendingProgram build = Shader::beginProgram(vertex, fragment, false);
+		if (!Shader::finishProgram(build, true)) {
+			std::cout << "Shader reload failed, keeping the previous program" << std::endl;
+			continue;
+		}
+		// The render thread's context must not see the program before the link is done
+		glFinish();
+		unsigned int stale = finished.exchange(build.program);
+		if (stale)
+			glDeleteProgram(stale); // superseded before it was ever drawn with
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+bool ShaderReloader::update()
+{
+	if (parallel) {
+		if (!building) {
+			std::string vertex, fragment;
+			if (!takeSources(vertex, fragment))
+				return false;
+			pending = Shader::beginProgram(vertex, fragment, false);
+			building = true;
+		}
+		int done = 0;
+		glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+		if (!done)
+			return false;
+		building = false;
+		if (!Shader::finishProgram(pending, true)) {
+			std::cout << "Shader reload failed, keeping the previous program" << std::endl;
+			return false;
+		}
+		shader.replace(pending.program);
+		std::cout << "Shader reloaded" << std::endl;
+		return true;
+	}
+
+	unsigned int program = finished.exchange(0);
+	if (program == 0 && !worker.joinable()) {
+		// No worker, build here
+		std::string vertex, fragment;
+		if (!takeSources(vertex, fragment))
+			return false;
+		Shader::PendingProgram build = Shader::beginProgram(vertex, fragment, false);
+		if (!Shader::finishProgram(build, true)) {
+			std::cout << "Shader reload failed, keeping the previous program" << std::endl;
+			return false;
+		}
+		program = build.program;
+	}
+	if (program == 0)
+		return false;
+	shader.replace(program);
+	std::cout << "Shader reloaded" << std::endl;
+	return true;
+}
@@ -0,0 +1,69 @@
+#ifndef SHADERRELOADER_H
+#define SHADERRELOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Shader.h"
+
+struct GLFWwindow;
+
+// Watches a shader's source files and rebuilds the program in the background when
+// they change. The render thread only ever sees finished programs: update() swaps a
+// successfully linked replacement into the Shader between frames, while a build that
+// fails to compile or link is logged and dropped, leaving the old program running.
+//
+// Builds use KHR_parallel_shader_compile when the driver has it (compile is kicked
+// off from update() and polled for completion on later frames), otherwise they run
+// on a worker thread with its own hidden context sharing objects with window's.
+// Without a window they are done in update() on the render thread, which stalls that
+// frame but keeps every GL call on one thread (a GLTrace only records that one).
+class ShaderReloader
+{
+public:
+	// Must be created on the thread that owns window's context. Sources are read with
+	// ShaderLibrary::loadFile and given the variant's defines, so included .glsl files
+	// next to them are watched as well. window may be NULL, see above.
+	ShaderReloader(Shader &shader, const char* vertexPath, const char* fragmentPath, GLFWwindow* window, const std::string &defines = "");
+	~ShaderReloader();
+
+	// Call once per frame, at the frame boundary. Returns true when the program was
+	// replaced, the caller should then use() it again and restore its uniforms.
+	bool update();
+
+private:
+	Shader &shader;
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string defines;
+
+	std::atomic<bool> running;
+	std::thread watcher;
+
+	// Sources read by the watcher, waiting for a build
+	std::mutex sourceMutex;
+	std::condition_variable sourceReady;
+	bool hasSources;
+	std::string vertexCode;
+	std::string fragmentCode;
+
+	// KHR_parallel_shader_compile path
+	bool parallel;
+	bool building;
+	Shader::PendingProgram pending;
+
+	// Worker thread path
+	GLFWwindow* workerContext;
+	std::thread worker;
+	std::atomic<unsigned int> finished; // linked program waiting to be swapped in
+
+	void watch();
+	void compileLoop();
+	bool readSources();
+	bool takeSources(std::string &vertex, std::string &fragment);
+};
+
+#endif
@@ -0,0 +1,412 @@
+// Generated by embed_shaders.py, do not edit. Edit the .vert/.frag/.glsl files and rerun it.
+#ifndef SHADERSOURCES_H
+#define SHADERSOURCES_H
+
+// shader.vert
+constexpr const char* SHADER_VERT_SOURCE = R"GLSL(#version 330 core
+// Permutations, defined by ShaderLibrary right after the #version line:
+//   exactly one of STREAM_POS_COLOR, STREAM_POS2, STREAM_VERTEX_ID, STREAM_INSTANCED
+//   picks the vertex source, or ANALYTIC draws just the base triangle for sierpinski.frag,
+//   GPU_ANIM derives the spin from time instead of transform, and the hue COLOR_HUE
+//   fragment stages use,
+//   SEPARABLE builds the stage for a program pipeline.
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+out gl_PerVertex { vec4 gl_Position; };
+#define VARYING(n) layout (location = n)
+#else
+#define VARYING(n)
+#endif
+
+// Helpers shared by the Sierpinski shaders, pulled in with #include "common.glsl"
+
+// HSV -> RGB for s = v = 1, h in degrees
+vec3 hueColor(float h)
+{
+    return clamp(abs(mod(h / 60.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+}
+
+// Same spin around the y axis main() builds with glm::rotate
+mat4 spinY(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(c, 0.0, -s, 0.0,
+                0.0, 1.0, 0.0, 0.0,
+                s, 0.0, c, 0.0,
+                0.0, 0.0, 0.0, 1.0);
+}
+
+// Corner of the triangle drawn by vertex vertexId, with no vertex buffer at all.
+// Triangles are numbered level by level: level L holds 3^L of them, and the base-3
+// digits of a triangle's index within its level pick the sub-triangle to descend
+// into exactly as drawTris() recurses (0: A, 1: B, 2: C).
+vec2 sierpinskiVertex(int vertexId, vec2 a, vec2 b, vec2 c)
+{
+    int tri = vertexId / 3;
+    int corner = vertexId - tri * 3;
+
+    int first = 0;
+    int count = 1;
+    int level = 0;
+    while (tri >= first + count) {
+        first += count;
+        count *= 3;
+        level++;
+    }
+
+    int index = tri - first;
+    for (int l = 0; l < level; l++) {
+        count /= 3;
+        int digit = index / count;
+        index -= digit * count;
+        vec2 ab = (a + b) * 0.5;
+        vec2 bc = (b + c) * 0.5;
+        vec2 ac = (a + c) * 0.5;
+        if (digit == 0) {
+            b = ab;
+            c = ac;
+        }
+        else if (digit == 1) {
+            a = b;
+            b = ab;
+            c = bc;
+        }
+        else {
+            a = c;
+            b = ac;
+            c = bc;
+        }
+    }
+
+    if (corner == 0)
+        return (a + b) * 0.5;
+    if (corner == 1)
+        return (b + c) * 0.5;
+    return (a + c) * 0.5;
+}
+
+#if defined(STREAM_POS_COLOR)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+#elif defined(STREAM_POS2)
+layout (location = 0) in vec2 aPos;
+#elif defined(STREAM_INSTANCED)
+layout (location = 0) in vec3 aInstance; // xy offset, z scale of the base triangle
+#endif
+
+VARYING(0) flat out vec3 ourColor;
+#ifdef GPU_ANIM
+// Once per vertex rather than per fragment, it is the same for the whole draw
+VARYING(2) flat out vec3 ourHue;
+#endif
+#ifdef ANALYTIC
+VARYING(1) out vec2 basisPos;
+
+// How much the base triangle is grown about its centre to leave room for the
+// antialiased edges
+const float ANALYTIC_MARGIN = 1.05;
+#endif
+
+#ifdef GPU_ANIM
+uniform float time;
+#else
+uniform mat4 transform;
+#endif
+
+#if defined(STREAM_VERTEX_ID) || defined(STREAM_INSTANCED) || defined(ANALYTIC)
+// Base triangle
+uniform vec2 pA;
+uniform vec2 pB;
+uniform vec2 pC;
+#endif
+
+void main()
+{
+#if defined(ANALYTIC)
+    vec2 corner = gl_VertexID == 0 ? vec2(0.0, 0.0) : gl_VertexID == 1 ? vec2(1.0, 0.0) : vec2(0.0, 1.0);
+    basisPos = (corner - 1.0 / 3.0) * ANALYTIC_MARGIN + 1.0 / 3.0;
+    vec4 position = vec4(pA + basisPos.x * (pB - pA) + basisPos.y * (pC - pA), 0.0, 1.0);
+#elif defined(STREAM_VERTEX_ID)
+    vec4 position = vec4(sierpinskiVertex(gl_VertexID, pA, pB, pC), 0.0, 1.0);
+#elif defined(STREAM_INSTANCED)
+    // Every drawn triangle is the base's midpoint triangle, scaled and moved
+    vec2 corner = gl_VertexID == 0 ? (pA + pB) * 0.5 : gl_VertexID == 1 ? (pB + pC) * 0.5 : (pA + pC) * 0.5;
+    vec4 position = vec4(corner * aInstance.z + aInstance.xy, 0.0, 1.0);
+#elif defined(STREAM_POS2)
+    vec4 position = vec4(aPos, 0.0, 1.0);
+#else
+    vec4 position = vec4(aPos, 1.0);
+#endif
+
+#ifdef GPU_ANIM
+    gl_Position = spinY(time) * position;
+    ourHue = hueColor(360.0 * (sin(time) / 2.0 + 0.5));
+#else
+    gl_Position = transform * position;
+#endif
+
+#ifdef STREAM_POS_COLOR
+    ourColor = aColor;
+#else
+    ourColor = vec3(1.0, 0.5, 0.0); // what drawTri() writes into every vertex
+#endif
+}
+)GLSL";
+
+// shader.frag
+constexpr const char* SHADER_FRAG_SOURCE = R"GLSL(#version 330 core
+// Permutations: exactly one of COLOR_UNIFORM (colorOver), COLOR_HUE (the hue a
+// GPU_ANIM vertex stage cycles from time) or COLOR_VERTEX (the vertex stage's colour),
+// plus SEPARABLE as in shader.vert.
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+#define VARYING(n) layout (location = n)
+#else
+#define VARYING(n)
+#endif
+
+// Helpers shared by the Sierpinski shaders, pulled in with #include "common.glsl"
+
+// HSV -> RGB for s = v = 1, h in degrees
+vec3 hueColor(float h)
+{
+    return clamp(abs(mod(h / 60.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+}
+
+// Same spin around the y axis main() builds with glm::rotate
+mat4 spinY(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(c, 0.0, -s, 0.0,
+                0.0, 1.0, 0.0, 0.0,
+                s, 0.0, c, 0.0,
+                0.0, 0.0, 0.0, 1.0);
+}
+
+// Corner of the triangle drawn by vertex vertexId, with no vertex buffer at all.
+// Triangles are numbered level by level: level L holds 3^L of them, and the base-3
+// digits of a triangle's index within its level pick the sub-triangle to descend
+// into exactly as drawTris() recurses (0: A, 1: B, 2: C).
+vec2 sierpinskiVertex(int vertexId, vec2 a, vec2 b, vec2 c)
+{
+    int tri = vertexId / 3;
+    int corner = vertexId - tri * 3;
+
+    int first = 0;
+    int count = 1;
+    int level = 0;
+    while (tri >= first + count) {
+        first += count;
+        count *= 3;
+        level++;
+    }
+
+    int index = tri - first;
+    for (int l = 0; l < level; l++) {
+        count /= 3;
+        int digit = index / count;
+        index -= digit * count;
+        vec2 ab = (a + b) * 0.5;
+        vec2 bc = (b + c) * 0.5;
+        vec2 ac = (a + c) * 0.5;
+        if (digit == 0) {
+            b = ab;
+            c = ac;
+        }
+        else if (digit == 1) {
+            a = b;
+            b = ab;
+            c = bc;
+        }
+        else {
+            a = c;
+            b = ac;
+            c = bc;
+        }
+    }
+
+    if (corner == 0)
+        return (a + b) * 0.5;
+    if (corner == 1)
+        return (b + c) * 0.5;
+    return (a + c) * 0.5;
+}
+
+out vec4 FragColor;
+
+VARYING(0) flat in vec3 ourColor;
+
+#if defined(COLOR_UNIFORM)
+uniform vec3 colorOver;
+#elif defined(COLOR_HUE)
+VARYING(2) flat in vec3 ourHue;
+#endif
+
+void main()
+{
+#if defined(COLOR_UNIFORM)
+    FragColor = vec4(colorOver, 1.0f);
+#elif defined(COLOR_HUE)
+    FragColor = vec4(ourHue, 1.0f);
+#else
+    FragColor = vec4(ourColor, 1.0f);
+#endif
+}
+)GLSL";
+
+// sierpinski.frag
+constexpr const char* SIERPINSKI_FRAG_SOURCE = R"GLSL(#version 330 core
+// Analytic counterpart of shader.frag for SHADER_ANALYTIC: the vertex stage draws only
+// the base triangle and every fragment works out whether it is in one of the middle
+// triangles drawTris() would generate, by running the recursion backwards from its
+// position in the base's basis (origin pA, axes pB - pA and pC - pA). Cost is per
+// pixel and per level, and the loop stops once a level is smaller than a pixel, so
+// any depth costs about the same. Edges get coverage from the distance to them in
+// pixels, written as alpha for blending over the clear colour.
+// Permutations: the colour modes of shader.frag, plus SEPARABLE.
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+#define VARYING(n) layout (location = n)
+#else
+#define VARYING(n)
+#endif
+
+// Helpers shared by the Sierpinski shaders, pulled in with #include "common.glsl"
+
+// HSV -> RGB for s = v = 1, h in degrees
+vec3 hueColor(float h)
+{
+    return clamp(abs(mod(h / 60.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+}
+
+// Same spin around the y axis main() builds with glm::rotate
+mat4 spinY(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(c, 0.0, -s, 0.0,
+                0.0, 1.0, 0.0, 0.0,
+                s, 0.0, c, 0.0,
+                0.0, 0.0, 0.0, 1.0);
+}
+
+// Corner of the triangle drawn by vertex vertexId, with no vertex buffer at all.
+// Triangles are numbered level by level: level L holds 3^L of them, and the base-3
+// digits of a triangle's index within its level pick the sub-triangle to descend
+// into exactly as drawTris() recurses (0: A, 1: B, 2: C).
+vec2 sierpinskiVertex(int vertexId, vec2 a, vec2 b, vec2 c)
+{
+    int tri = vertexId / 3;
+    int corner = vertexId - tri * 3;
+
+    int first = 0;
+    int count = 1;
+    int level = 0;
+    while (tri >= first + count) {
+        first += count;
+        count *= 3;
+        level++;
+    }
+
+    int index = tri - first;
+    for (int l = 0; l < level; l++) {
+        count /= 3;
+        int digit = index / count;
+        index -= digit * count;
+        vec2 ab = (a + b) * 0.5;
+        vec2 bc = (b + c) * 0.5;
+        vec2 ac = (a + c) * 0.5;
+        if (digit == 0) {
+            b = ab;
+            c = ac;
+        }
+        else if (digit == 1) {
+            a = b;
+            b = ab;
+            c = bc;
+        }
+        else {
+            a = c;
+            b = ac;
+            c = bc;
+        }
+    }
+
+    if (corner == 0)
+        return (a + b) * 0.5;
+    if (corner == 1)
+        return (b + c) * 0.5;
+    return (a + c) * 0.5;
+}
+
+out vec4 FragColor;
+
+VARYING(0) flat in vec3 ourColor;
+VARYING(1) in vec2 basisPos;
+
+uniform int depth;
+
+#if defined(COLOR_UNIFORM)
+uniform vec3 colorOver;
+#elif defined(COLOR_HUE)
+VARYING(2) flat in vec3 ourHue;
+#endif
+
+// Signed distance in pixels from p to the middle triangle of the unit triangle
+// (0, 0), (1, 0), (0, 1), positive inside. g holds how much s, t and s + t change
+// per pixel.
+float middleDistance(vec2 p, vec3 g)
+{
+    return min(min((0.5 - p.x) / g.x, (0.5 - p.y) / g.y), (p.x + p.y - 0.5) / g.z);
+}
+
+float coverage()
+{
+    vec2 ds = vec2(dFdx(basisPos.x), dFdy(basisPos.x));
+    vec2 dt = vec2(dFdx(basisPos.y), dFdy(basisPos.y));
+    vec3 g = max(vec3(length(ds), length(dt), length(ds + dt)), vec3(1e-8));
+
+    // The primitive is a little bigger than the base triangle so its edges can fade out
+    vec2 p = basisPos;
+    float base = clamp(min(min(p.x / g.x, p.y / g.y), (1.0 - p.x - p.y) / g.z) + 0.5, 0.0, 1.0);
+    if (base <= 0.0)
+        return 0.0;
+
+    float covered = 0.0;
+    for (int level = 0; level <= depth; level++) {
+        // Under a pixel per sub-triangle the remaining levels fill this fraction of it
+        if (max(g.x, max(g.y, g.z)) > 1.0) {
+            covered = max(covered, 1.0 - pow(0.75, float(depth - level + 1)));
+            break;
+        }
+        covered = max(covered, clamp(middleDistance(p, g) + 0.5, 0.0, 1.0));
+        if (covered >= 1.0)
+            break;
+        // Into the corner sub-triangle holding p, undoing the halving drawTris() recurses with
+        if (p.x > 0.5)
+            p = vec2(2.0 * p.x - 1.0, 2.0 * p.y);
+        else if (p.y > 0.5)
+            p = vec2(2.0 * p.x, 2.0 * p.y - 1.0);
+        else
+            p *= 2.0;
+        g *= 2.0;
+    }
+    return min(covered, base);
+}
+
+void main()
+{
+#if defined(COLOR_UNIFORM)
+    vec3 color = colorOver;
+#elif defined(COLOR_HUE)
+    vec3 color = ourHue;
+#else
+    vec3 color = ourColor;
+#endif
+    FragColor = vec4(color, coverage());
+}
+)GLSL";
+
+#endif
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "Shootout.h"
+#include "AnalyticRaster.h"
+#include "Headless.h"
+#include "Renderer.h"
+#include "ShaderLibrary.h"
+#include "SoftRaster.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static const float TIME_STEP = 1.0f / 60.0f;
+
+enum StrategyKind { STRATEGY_GL, STRATEGY_SOFT, STRATEGY_ANALYTIC_CPU };
+
+struct Strategy {
+	const char* name;
+	StrategyKind kind;
+	unsigned int variant; // GL strategies
+	bool indexed;
+};
+
+// Spin and hue from the time uniform, like the window
+static const unsigned int SHADING = SHADER_GPU_ANIM | SHADER_COLOR_HUE;
+
+// Every RenderStrategy, then the CPU rasterizers
+static std::vector<Strategy> strategies()
+{
+	std::vector<Strategy> list;
+	for (int i = 0; i < RENDER_STRATEGY_COUNT; i++) {
+		Strategy strategy = { RENDER_STRATEGIES[i].name, STRATEGY_GL, RENDER_STRATEGIES[i].stream | SHADING, RENDER_STRATEGIES[i].indexed };
+		list.push_back(strategy);
+	}
+	Strategy soft = { "soft_raster", STRATEGY_SOFT, 0, false };
+	Strategy analytic = { "analytic_cpu", STRATEGY_ANALYTIC_CPU, 0, false };
+	list.push_back(soft);
+	list.push_back(analytic);
+	return list;
+}
+
+// One run of a strategy, handed up from the child process as raw bytes
+struct RunResult {
+	int ok;
+	double startupMs; // start of the run to the end of its first frame
+	double p50, p95, p99, mean; // frame times, milliseconds
+	long long bufferBytes;      // GPU buffers, or the CPU-side mesh of the CPU strategies
+	long long peakRssKB;
+};
+
+static double msSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs warmup + measured frames of drawFrame(time) and fills in the timings
+template <typename Frame>
+static void measureFrames(const ShootoutOptions &options, std::chrono::steady_clock::time_point start, RunResult &result, Frame drawFrame)
+{
+	std::vector<double> frameMs;
+	frameMs.reserve(options.frames);
+	for (int frame = 0; frame < options.warmupFrames + options.frames; frame++) {
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		drawFrame(frame * TIME_STEP);
+		double ms = msSince(frameStart);
+		if (frame == 0)
+			result.startupMs = msSince(start);
+		if (frame >= options.warmupFrames)
+			frameMs.push_back(ms);
+	}
+	if (frameMs.empty())
+		return;
+	std::sort(frameMs.begin(), frameMs.end());
+	size_t n = frameMs.size();
+	result.p50 = frameMs[std::min(n - 1, n / 2)];
+	result.p95 = frameMs[std::min(n - 1, (size_t)(0.95 * n))];
+	result.p99 = frameMs[std::min(n - 1, (size_t)(0.99 * n))];
+	double sum = 0.0;
+	for (size_t i = 0; i < n; i++)
+		sum += frameMs[i];
+	result.mean = sum / n;
+}
+
+static RunResult runStrategy(const Strategy &strategy, const ShootoutOptions &options)
+{
+	RunResult result = {};
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	glm::vec2 pA(0.0f, 0.5f), pB(0.5f, -0.5f), pC(-0.5f, -0.5f); // Original Points For Triangle
+	ColorVec3 clearColor(0.2f, 0.3f, 0.3f);
+
+	if (strategy.kind == STRATEGY_GL) {
+		HeadlessContext headless(options.width, options.height);
+		if (!headless.ok)
+			return result;
+		// No program cache, every run compiles from scratch
+		ShaderLibrary shaders;
+		Renderer renderer(shaders, strategy.variant, options.depth, strategy.indexed);
+		renderer.bind();
+		measureFrames(options, start, result, [&](float time) {
+			renderer.drawFrame(time);
+			glFinish();
+		});
+		result.bufferBytes = (long long)renderer.bufferBytes;
+		result.ok = glGetError() == GL_NO_ERROR;
+		return result;
+	}
+
+	ThreadPool pool;
+	Image image;
+	if (strategy.kind == STRATEGY_SOFT) {
+		SoftRaster raster(options.width, options.height, pool);
+		std::vector<float> vertices;
+		vertices.reserve((size_t)triangleCount(options.depth) * 6);
+		drawTrisPos2(pA, pB, pC, options.depth, vertices);
+		measureFrames(options, start, result, [&](float time) {
+			glm::mat4 trans = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0, 1.0, 0.0));
+			float h = 360.0f * ((sin(time) / 2.0f) + 0.5f);
+			raster.setTriangles(&vertices[0], vertices.size() / 2, 2, trans);
+			raster.draw(getHSVColor(h, 1.0f, 1.0f), clearColor, image);
+		});
+		result.bufferBytes = (long long)(vertices.size() * sizeof(float));
+	}
+	else {
+		AnalyticRaster raster(options.width, options.height, pool);
+		measureFrames(options, start, result, [&](float time) {
+			glm::mat4 trans = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0, 1.0, 0.0));
+			float h = 360.0f * ((sin(time) / 2.0f) + 0.5f);
+			raster.setView(pA, pB, pC, options.depth, trans);
+			raster.draw(getHSVColor(h, 1.0f, 1.0f), clearColor, image);
+		});
+	}
+	result.ok = 1;
+	return result;
+}
+
+// runStrategy() in a child process, whose peak RSS is then the run's alone. Where
+// there is no fork() the run happens in this process and peak RSS is not measured.
+static RunResult runIsolated(const Strategy &strategy, const ShootoutOptions &options)
+{
+#ifdef __linux__
+	RunResult result = {};
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cout << "ERROR::SHOOTOUT::PIPE_FAILED" << std::endl;
+		return result;
+	}
+	std::cout.flush();
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		RunResult child = runStrategy(strategy, options);
+		// Far below PIPE_BUF, so the write is atomic
+		bool written = write(fds[1], &child, sizeof(child)) == (ssize_t)sizeof(child);
+		std::cout.flush();
+		_exit(written ? 0 : 1);
+	}
+	close(fds[1]);
+	if (pid < 0) {
+		close(fds[0]);
+		std::cout << "ERROR::SHOOTOUT::FORK_FAILED" << std::endl;
+		return result;
+	}
+	bool received = read(fds[0], &result, sizeof(result)) == (ssize_t)sizeof(result);
+	close(fds[0]);
+	int status = 0;
+	struct rusage usage = {};
+	wait4(pid, &status, 0, &usage);
+	if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		result.ok = 0;
+	result.peakRssKB = usage.ru_maxrss;
+	return result;
+#else
+	return runStrategy(strategy, options);
+#endif
+}
+
+// Interference from the rest of the machine only ever adds time, so the fastest run
+// is the one that repeats best. Memory is taken from the hungriest run.
+template <typename T>
+static T fastest(const std::vector<RunResult> &runs, T RunResult::*field)
+{
+	T value = runs[0].*field;
+	for (size_t i = 1; i < runs.size(); i++)
+		value = std::min(value, runs[i].*field);
+	return value;
+}
+
+template <typename T>
+static T largest(const std::vector<RunResult> &runs, T RunResult::*field)
+{
+	T value = runs[0].*field;
+	for (size_t i = 1; i < runs.size(); i++)
+		value = std::max(value, runs[i].*field);
+	return value;
+}
+
+static bool writeResults(const char* path, const ShootoutOptions &options, const std::vector<Strategy> &list, const std::vector<RunResult> &results)
+{
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		std::cout << "ERROR::SHOOTOUT::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	// One strategy per line, readBaseline() depends on it
+	fprintf(file, "{\n  \"width\": %d, \"height\": %d, \"depth\": %d, \"frames\": %d,\n  \"strategies\": {\n",
+		options.width, options.height, options.depth, options.frames);
+	bool first = true;
+	for (size_t s = 0; s < list.size(); s++) {
+		const RunResult &r = results[s];
+		if (!r.ok)
+			continue;
+		fprintf(file, "%s    \"%s\": { \"startup_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"mean_ms\": %.4f, \"buffer_bytes\": %lld, \"peak_rss_kb\": %lld }",
+			first ? "" : ",\n", list[s].name, r.startupMs, r.p50, r.p95, r.p99, r.mean, r.bufferBytes, r.peakRssKB);
+		first = false;
+	}
+	fprintf(file, "\n  }\n}\n");
+	return fclose(file) == 0;
+}
+
+// Reads results written by writeResults() for the same options into baseline
+// (ok stays 0 for strategies it lacks)
+static bool readBaseline(const char* path, const ShootoutOptions &options, const std::vector<Strategy> &list, std::vector<RunResult> &baseline)
+{
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::SHOOTOUT::BASELINE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+	bool matches = false;
+	std::string line;
+	while (std::getline(file, line)) {
+		int width, height, depth, frames;
+		if (sscanf(line.c_str(), " \"width\": %d, \"height\": %d, \"depth\": %d, \"frames\": %d", &width, &height, &depth, &frames) == 4)
+			matches = width == options.width && height == options.height && depth == options.depth && frames == options.frames;
+		char name[64];
+		RunResult r = {};
+		if (sscanf(line.c_str(), " \"%63[^\"]\": { \"startup_ms\": %lf, \"p50_ms\": %lf, \"p95_ms\": %lf, \"p99_ms\": %lf, \"mean_ms\": %lf, \"buffer_bytes\": %lld, \"peak_rss_kb\": %lld",
+			name, &r.startupMs, &r.p50, &r.p95, &r.p99, &r.mean, &r.bufferBytes, &r.peakRssKB) != 8)
+			continue;
+		for (size_t s = 0; s < list.size(); s++) {
+			if (std::string(list[s].name) == name) {
+				baseline[s] = r;
+				baseline[s].ok = 1;
+			}
+		}
+	}
+	if (!matches) {
+		std::cout << "ERROR::SHOOTOUT::BASELINE_MISMATCH " << path << " was run at another size, depth or frame count" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Frames well under a millisecond jitter by more than any tolerance, on top of it
+// they may be this much slower
+static const double TIMER_SLACK_MS = 0.05;
+
+// Counts and prints what got worse than the baseline. The median frame time and
+// peak RSS may grow by the tolerance, buffer sizes are exact and may not grow at
+// all. The tail percentiles move too much between runs on a shared machine to gate
+// on, they are only reported.
+static int compareBaseline(const ShootoutOptions &options, const std::vector<Strategy> &list, const std::vector<RunResult> &results, const std::vector<RunResult> &baseline)
+{
+	int regressions = 0;
+	for (size_t s = 0; s < list.size(); s++) {
+		const RunResult &now = results[s], &then = baseline[s];
+		if (!then.ok)
+			continue;
+		const char* name = list[s].name;
+		if (!now.ok) {
+			std::cout << "REGRESSION " << name << " failed to run" << std::endl;
+			regressions++;
+			continue;
+		}
+		if (now.p50 > then.p50 * (1.0 + options.tolerance) + TIMER_SLACK_MS) {
+			std::cout << "REGRESSION " << name << " p50 " << now.p50 << " ms, baseline " << then.p50 << " ms" << std::endl;
+			regressions++;
+		}
+		if (now.bufferBytes > then.bufferBytes) {
+			std::cout << "REGRESSION " << name << " buffers " << now.bufferBytes << " bytes, baseline " << then.bufferBytes << std::endl;
+			regressions++;
+		}
+		if (then.peakRssKB > 0 && now.peakRssKB > then.peakRssKB * (1.0 + options.tolerance)) {
+			std::cout << "REGRESSION " << name << " peak RSS " << now.peakRssKB << " KB, baseline " << then.peakRssKB << " KB" << std::endl;
+			regressions++;
+		}
+	}
+	return regressions;
+}
+
+int runShootout(const ShootoutOptions & options)
+{
+	if (options.width <= 0 || options.height <= 0 || options.frames <= 0 || options.runs <= 0) {
+		std::cout << "ERROR::SHOOTOUT::BAD_OPTIONS" << std::endl;
+		return -1;
+	}
+	std::vector<Strategy> list = strategies();
+	std::vector<RunResult> baseline(list.size(), RunResult());
+	if (options.baselinePath && !readBaseline(options.baselinePath, options, list, baseline))
+		return -1;
+
+	std::cout << "Shootout at " << options.width << "x" << options.height << ", depth " << options.depth << " ("
+		<< triangleCount(options.depth) << " triangles), " << options.frames << " frames after " << options.warmupFrames
+		<< " warmup, best of " << options.runs << " runs" << std::endl;
+	char line[256];
+	snprintf(line, sizeof(line), "%-14s %11s %9s %9s %9s %9s %11s %11s", "strategy", "startup ms", "p50 ms", "p95 ms",
+		"p99 ms", "mean ms", "buffer KB", "peak RSS MB");
+	std::cout << line << std::endl;
+
+	std::vector<RunResult> results(list.size(), RunResult());
+	for (size_t s = 0; s < list.size(); s++) {
+		std::vector<RunResult> runs;
+		for (int run = 0; run < options.runs; run++) {
+			RunResult result = runIsolated(list[s], options);
+			if (!result.ok)
+				break;
+			runs.push_back(result);
+		}
+		if ((int)runs.size() < options.runs) {
+			snprintf(line, sizeof(line), "%-14s %11s", list[s].name, "failed");
+			std::cout << line << std::endl;
+			continue;
+		}
+		RunResult &r = results[s];
+		r.ok = 1;
+		r.startupMs = fastest(runs, &RunResult::startupMs);
+		r.p50 = fastest(runs, &RunResult::p50);
+		r.p95 = fastest(runs, &RunResult::p95);
+		r.p99 = fastest(runs, &RunResult::p99);
+		r.mean = fastest(runs, &RunResult::mean);
+		r.bufferBytes = largest(runs, &RunResult::bufferBytes);
+		r.peakRssKB = largest(runs, &RunResult::peakRssKB);
+		snprintf(line, sizeof(line), "%-14s %11.2f %9.3f %9.3f %9.3f %9.3f %11.1f %11.1f", list[s].name, r.startupMs,
+			r.p50, r.p95, r.p99, r.mean, r.bufferBytes / 1024.0, r.peakRssKB / 1024.0);
+		std::cout << line << std::endl;
+	}
+
+	if (options.jsonPath && writeResults(options.jsonPath, options, list, results))
+		std::cout << "Wrote " << options.jsonPath << std::endl;
+	if (options.baselinePath) {
+		int regressions = compareBaseline(options, list, results, baseline);
+		std::cout << regressions << " regressions against " << options.baselinePath << " (tolerance "
+			<< options.tolerance * 100.0 << "%)" << std::endl;
+		if (regressions > 0)
+			return 1;
+	}
+	return 0;
+}
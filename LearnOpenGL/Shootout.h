@@ -0,0 +1,30 @@
+#ifndef SHOOTOUT_H
+#define SHOOTOUT_H
+
+// Every way we have of drawing the triangle, run for the same frames at the same
+// depth and resolution and compared side by side: the GL strategies offscreen on the
+// headless context (llvmpipe on a farm node), the CPU rasterizers without GL.
+//
+// Each run of a strategy happens in a child process of its own (Linux), so no run
+// sees the driver, heap or caches another one warmed up and the child's peak RSS is
+// that strategy's alone. Animation uses a fixed timestep, shaders are compiled
+// without the program cache and every frame ends in glFinish(), so frame times are
+// the real cost of the frame. Each strategy runs several times and the fastest
+// timings are kept, which is steady enough to gate regressions against a baseline.
+struct ShootoutOptions {
+	int width;
+	int height;
+	int depth;
+	int frames;         // measured frames per run
+	int warmupFrames;   // run first and not measured
+	int runs;           // runs per strategy, the fastest timings are kept
+	const char* jsonPath;     // results are written here, NULL to skip
+	const char* baselinePath; // earlier results to compare against, NULL for none
+	double tolerance;   // allowed growth over the baseline, 0.1 is 10%
+};
+
+// Prints the comparison table. Returns the process exit code, 1 when a strategy
+// regressed against the baseline.
+int runShootout(const ShootoutOptions &options);
+
+#endif
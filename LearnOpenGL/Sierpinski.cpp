@@ -0,0 +1,119 @@
+#include "Sierpinski.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+void drawTri(glm::vec2 A, glm::vec2 B, glm::vec2 C, std::vector<float> &vertex_arr)
+{
+	//std::cout << A.x << " " << A.y << std::endl;
+	//std::cout << B.x << " " << B.y << std::endl;
+	//std::cout << C.x << " " << C.y << std::endl;
+	float tri[] = {
+		// positions    
+		 A.x, A.y, 0.0f, 1.f, 0.5f, 0.0f,
+		 B.x, B.y, 0.0f, 1.f, 0.5f, 0.0f,
+		 C.x, C.y, 0.0f, 1.f, 0.5f, 0.0f,
+	};
+	for (int i = 0; i < 18; i++) {
+		vertex_arr.push_back(tri[i]);
+	}
+
+}
+
+// Levels from here up get a trace scope each: depth 14 makes 3^8 of them, and the
+// smallest covers 3280 triangles, so tracing doesn't change what it measures
+static const int TRACE_MIN_LEVEL = 7;
+
+void drawTris(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, std::vector<float> &vertices) {
+	TRACE_SCOPE_IF(n >= TRACE_MIN_LEVEL, "drawTris", "level", n);
+	// Sierpinski's Algorithm
+	drawTri(mid(A, B) , mid(B, C), mid(A, C), vertices);
+	if (n > 0) {
+		drawTris(A, mid(A, B), mid(A, C), n - 1, vertices);
+		drawTris(B, mid(A, B), mid(B, C), n - 1, vertices);
+		drawTris(C, mid(A, C), mid(B, C), n - 1, vertices);
+	}
+}
+
+void drawTrisPos2(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, std::vector<float> &vertices) {
+	TRACE_SCOPE_IF(n >= TRACE_MIN_LEVEL, "drawTrisPos2", "level", n);
+	glm::vec2 ab = mid(A, B), bc = mid(B, C), ac = mid(A, C);
+	float tri[] = { ab.x, ab.y, bc.x, bc.y, ac.x, ac.y };
+	vertices.insert(vertices.end(), tri, tri + 6);
+	if (n > 0) {
+		drawTrisPos2(A, ab, ac, n - 1, vertices);
+		drawTrisPos2(B, ab, bc, n - 1, vertices);
+		drawTrisPos2(C, ac, bc, n - 1, vertices);
+	}
+}
+
+void drawTriInstances(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, glm::vec2 offset, float scale, std::vector<float> &instances) {
+	TRACE_SCOPE_IF(n >= TRACE_MIN_LEVEL, "drawTriInstances", "level", n);
+	// A sub-triangle keeping corner P of its parent is the parent at half scale,
+	// moved by half of P
+	instances.push_back(offset.x);
+	instances.push_back(offset.y);
+	instances.push_back(scale);
+	if (n > 0) {
+		float half = scale / 2;
+		drawTriInstances(A, B, C, n - 1, offset + A * half, half, instances);
+		drawTriInstances(A, B, C, n - 1, offset + B * half, half, instances);
+		drawTriInstances(A, B, C, n - 1, offset + C * half, half, instances);
+	}
+}
+
+long long triangleCount(int n)
+{
+	long long power = 3;
+	for (int i = 0; i < n; i++)
+		power *= 3;
+	return (power - 1) / 2;
+}
+
+glm::vec2 mid(glm::vec2 A, glm::vec2 B)
+{
+	float x = (A.x + B.x) / 2;
+	float y = (A.y + B.y) / 2;
+	return glm::vec2(x, y);
+}
+
+ColorVec3 getHSVColor(float h, float s, float v) {
+	// h [0, 360] s/v [0.0. 1.0];
+	int i = (int)floor(h / 60.0f) % 6;
+	float f = h / 60.0f - floor(h / 60.0f);
+	float p = v * (float)(1 - s);
+	float q = v * (float)(1 - s * f);
+	float t = v * (float)(1 - (1 - f) * s);
+	ColorVec3 color(0.0f, 0.0f, 0.0f);
+	switch (i) {
+		case 0: color = ColorVec3(v, t, p);
+			break;
+		case 1: color = ColorVec3(q, v, p);
+			break;
+		case 2: color = ColorVec3(p, v, t);
+			break;
+		case 3: color = ColorVec3(p, q, v);
+			break;
+		case 4: color = ColorVec3(t, p, v);
+			break;
+		case 5: color = ColorVec3(v, p, q);
+			break;
+		default: color = ColorVec3(0.f, 0.f, 0.f);
+	}
+	return color;
+}
+
+uint32_t packRGBA(ColorVec3 color)
+{
+	unsigned char rgba[4] = {
+		(unsigned char)std::min(255.0f, std::max(0.0f, color.r * 255.0f + 0.5f)),
+		(unsigned char)std::min(255.0f, std::max(0.0f, color.g * 255.0f + 0.5f)),
+		(unsigned char)std::min(255.0f, std::max(0.0f, color.b * 255.0f + 0.5f)),
+		255
+	};
+	uint32_t packed;
+	memcpy(&packed, rgba, 4);
+	return packed;
+}
@@ -0,0 +1,37 @@
+#ifndef SIERPINSKI_H
+#define SIERPINSKI_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct ColorVec3 {
+	float r;
+	float g;
+	float b;
+	ColorVec3(float r0, float g0, float b0) {
+		r = r0;
+		g = g0;
+		b = b0;
+	}
+};
+
+// Populates vertices with sierpinski's algorithm, 3 interleaved position + colour vertices
+// (6 floats each) per triangle
+void drawTris(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, std::vector<float> &vertices);
+void drawTri(glm::vec2 A, glm::vec2 B, glm::vec2 C, std::vector<float> &vertex_arr);
+// Same triangles, vec2 positions only (2 floats per vertex)
+void drawTrisPos2(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, std::vector<float> &vertices);
+// Same triangles as offset.x, offset.y, scale instances of the base triangle's middle
+// triangle (3 floats per triangle). offset/scale describe the triangle being split,
+// start with (0, 0) and 1.
+void drawTriInstances(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, glm::vec2 offset, float scale, std::vector<float> &instances);
+// Triangles drawTris emits for depth n, (3^(n+1) - 1) / 2
+long long triangleCount(int n);
+glm::vec2 mid(glm::vec2 A, glm::vec2 B);
+ColorVec3 getHSVColor(float h, float s, float v);
+// 8-bit RGBA, opaque, in memory order (for Image pixels)
+uint32_t packRGBA(ColorVec3 color);
+
+#endif
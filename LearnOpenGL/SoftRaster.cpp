@@ -0,0 +1,271 @@
+#include "SoftRaster.h"
+#include "Headless.h"
+#include "PngWriter.h"
+#include "ShaderLibrary.h"
+#include "Simd.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+SoftRaster::SoftRaster(int width, int height, ThreadPool & pool)
+	: fbWidth(width), fbHeight(height), pool(pool)
+{
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+void SoftRaster::setTriangles(const float * vertices, size_t vertexCount, int stride, const glm::mat4 & transform)
+{
+	size_t count = vertexCount / 3;
+	int chunks = std::max(1, std::min((int)((count + 4095) / 4096), pool.size() * 4));
+	chunkTriangles.resize(chunks);
+	bins.resize(chunks);
+	size_t perChunk = (count + chunks - 1) / chunks;
+	float halfWidth = fbWidth * 0.5f, halfHeight = fbHeight * 0.5f;
+
+	pool.parallelFor(chunks, [&](int chunk) {
+		std::vector<Triangle> &tris = chunkTriangles[chunk];
+		std::vector<std::vector<uint32_t> > &tileBins = bins[chunk];
+		tris.clear();
+		tileBins.resize(tilesX * tilesY);
+		for (size_t i = 0; i < tileBins.size(); i++)
+			tileBins[i].clear();
+
+		size_t begin = chunk * perChunk, end = std::min(count, begin + perChunk);
+		for (size_t t = begin; t < end; t++) {
+			Triangle tri;
+			for (int v = 0; v < 3; v++) {
+				const float* p = vertices + (t * 3 + v) * stride;
+				glm::vec4 clip = transform * glm::vec4(p[0], p[1], 0.0f, 1.0f);
+				// NDC to pixels, rows top-down like Image
+				tri.x[v] = (clip.x / clip.w + 1.0f) * halfWidth;
+				tri.y[v] = (1.0f - clip.y / clip.w) * halfHeight;
+			}
+			float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+			if (area == 0.0f)
+				continue;
+			if (area < 0.0f) {
+				// Keep every triangle wound the same way so inside is all edges >= 0
+				std::swap(tri.x[1], tri.x[2]);
+				std::swap(tri.y[1], tri.y[2]);
+			}
+			// Pixel centres covered by the bounds; sub-pixel triangles that miss every
+			// centre drop out here, which is most of them at high depth
+			float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+			float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+			float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+			float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+			tri.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+			tri.maxX = std::min(fbWidth - 1, (int)std::floor(maxX - 0.5f));
+			tri.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+			tri.maxY = std::min(fbHeight - 1, (int)std::floor(maxY - 0.5f));
+			if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+				continue;
+
+			uint32_t index = (uint32_t)tris.size();
+			tris.push_back(tri);
+			for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++) {
+				for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+					tileBins[ty * tilesX + tx].push_back(index);
+			}
+		}
+	});
+}
+
+// Edge function of a (clockwise on screen) triangle: inside where all three are >= 0.
+// E(px, py) = a * px + b * py + c, evaluated at pixel centres.
+struct Edges {
+	double a[3], b[3], c[3];
+	Edges(const float* x, const float* y) {
+		for (int i = 0; i < 3; i++) {
+			int j = (i + 1) % 3;
+			a[i] = -(double)(y[j] - y[i]);
+			b[i] = (double)(x[j] - x[i]);
+			c[i] = -(a[i] * x[i] + b[i] * y[i]);
+		}
+	}
+	double at(int i, double px, double py) const { return a[i] * px + b[i] * py + c[i]; }
+};
+
+// Calls span(x, y, mask) for every run of 8 pixels starting at x (a multiple of 8)
+// with at least one covered pixel; bit i of mask is pixel x + i.
+template <typename Span>
+static void coverScalar(const Edges &e, int x0, int y0, int x1, int y1, Span &span)
+{
+	int start = x0 & ~7;
+	for (int y = y0; y <= y1; y++) {
+		double py = y + 0.5;
+		for (int x = start; x <= x1; x += 8) {
+			unsigned int mask = 0;
+			for (int i = 0; i < 8; i++) {
+				int px = x + i;
+				if (px < x0 || px > x1)
+					continue;
+				if (e.at(0, px + 0.5, py) >= 0.0 && e.at(1, px + 0.5, py) >= 0.0 && e.at(2, px + 0.5, py) >= 0.0)
+					mask |= 1u << i;
+			}
+			if (mask)
+				span(x, y, mask);
+		}
+	}
+}
+
+#ifdef SIMD_X86
+template <typename Span>
+AVX2_TARGET static void coverAVX2(const Edges &e, int x0, int y0, int x1, int y1, Span &span)
+{
+	int start = x0 & ~7;
+	const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	__m256 a0 = _mm256_set1_ps((float)e.a[0]), a1 = _mm256_set1_ps((float)e.a[1]), a2 = _mm256_set1_ps((float)e.a[2]);
+	__m256 step0 = _mm256_set1_ps((float)(e.a[0] * 8)), step1 = _mm256_set1_ps((float)(e.a[1] * 8)), step2 = _mm256_set1_ps((float)(e.a[2] * 8));
+	for (int y = y0; y <= y1; y++) {
+		// Row start in double, then only small float steps within the tile
+		double px = start + 0.5, py = y + 0.5;
+		__m256 e0 = _mm256_fmadd_ps(lane, a0, _mm256_set1_ps((float)e.at(0, px, py)));
+		__m256 e1 = _mm256_fmadd_ps(lane, a1, _mm256_set1_ps((float)e.at(1, px, py)));
+		__m256 e2 = _mm256_fmadd_ps(lane, a2, _mm256_set1_ps((float)e.at(2, px, py)));
+		for (int x = start; x <= x1; x += 8) {
+			__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+				_mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+			unsigned int mask = (unsigned int)_mm256_movemask_ps(inside);
+			// Trim to the clipped bounds
+			if (x < x0)
+				mask &= 0xFFu << (x0 - x);
+			if (x + 7 > x1)
+				mask &= 0xFFu >> (x + 7 - x1);
+			if (mask)
+				span(x, y, mask);
+			e0 = _mm256_add_ps(e0, step0);
+			e1 = _mm256_add_ps(e1, step1);
+			e2 = _mm256_add_ps(e2, step2);
+		}
+	}
+}
+#endif
+
+template <typename Span>
+void SoftRaster::rasterizeTile(int tile, Span span)
+{
+	static const bool avx2 = hasAVX2();
+	int tileX0 = (tile % tilesX) * TILE_SIZE, tileY0 = (tile / tilesX) * TILE_SIZE;
+	int tileX1 = std::min(tileX0 + TILE_SIZE, fbWidth) - 1, tileY1 = std::min(tileY0 + TILE_SIZE, fbHeight) - 1;
+	for (size_t chunk = 0; chunk < bins.size(); chunk++) {
+		const std::vector<uint32_t> &bin = bins[chunk][tile];
+		const std::vector<Triangle> &tris = chunkTriangles[chunk];
+		for (size_t i = 0; i < bin.size(); i++) {
+			const Triangle &tri = tris[bin[i]];
+			int x0 = std::max(tri.minX, tileX0), x1 = std::min(tri.maxX, tileX1);
+			int y0 = std::max(tri.minY, tileY0), y1 = std::min(tri.maxY, tileY1);
+			Edges edges(tri.x, tri.y);
+#ifdef SIMD_X86
+			if (avx2) {
+				coverAVX2(edges, x0, y0, x1, y1, span);
+				continue;
+			}
+#endif
+			coverScalar(edges, x0, y0, x1, y1, span);
+		}
+	}
+}
+
+struct RGBASpan {
+	uint32_t* pixels;
+	int stride;
+	uint32_t color;
+	void operator()(int x, int y, unsigned int mask) {
+		uint32_t* row = pixels + (size_t)y * stride + x;
+		if (mask == 0xFF) {
+			for (int i = 0; i < 8; i++)
+				row[i] = color;
+			return;
+		}
+		for (int i = 0; i < 8; i++) {
+			if (mask & (1u << i))
+				row[i] = color;
+		}
+	}
+};
+
+struct MaskSpan {
+	uint64_t* words;
+	int wordsPerRow;
+	void operator()(int x, int y, unsigned int mask) {
+		words[(size_t)y * wordsPerRow + (x >> 6)] |= (uint64_t)mask << (x & 63);
+	}
+};
+
+void SoftRaster::draw(ColorVec3 color, ColorVec3 clearColor, Image & out)
+{
+	if (out.width != fbWidth || out.height != fbHeight)
+		out = Image(fbWidth, fbHeight);
+	uint32_t* pixels = (uint32_t*)&out.rgba[0];
+	uint32_t fill = packRGBA(color), clear = packRGBA(clearColor);
+	pool.parallelFor(tilesX * tilesY, [&](int tile) {
+		// Clear is done per tile as well, while the tile is hot in this core's cache
+		int tileX0 = (tile % tilesX) * TILE_SIZE, tileY0 = (tile / tilesX) * TILE_SIZE;
+		int tileX1 = std::min(tileX0 + TILE_SIZE, fbWidth), tileY1 = std::min(tileY0 + TILE_SIZE, fbHeight);
+		for (int y = tileY0; y < tileY1; y++)
+			std::fill(pixels + (size_t)y * fbWidth + tileX0, pixels + (size_t)y * fbWidth + tileX1, clear);
+		RGBASpan span = { pixels, fbWidth, fill };
+		rasterizeTile(tile, span);
+	});
+}
+
+void SoftRaster::drawMask(std::vector<uint64_t> & bits)
+{
+	int words = wordsPerRow();
+	bits.assign((size_t)words * fbHeight, 0);
+	// Tiles are 64 pixels wide and start on a multiple of 64, so every tile owns
+	// whole words and workers never write the same one
+	pool.parallelFor(tilesX * tilesY, [&](int tile) {
+		MaskSpan span = { &bits[0], words };
+		rasterizeTile(tile, span);
+	});
+}
+
+int runSoftRaster(const HeadlessOptions & options)
+{
+	ThreadPool pool;
+	SoftRaster raster(options.width, options.height, pool);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<float> vertices;
+	vertices.reserve((size_t)triangleCount(options.depth) * 6);
+	glm::vec2 pA(0.0f, 0.5f), pB(0.5f, -0.5f), pC(-0.5f, -0.5f); // Original Points For Triangle
+	drawTrisPos2(pA, pB, pC, options.depth, vertices);
+	double generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	Image image;
+	start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < options.frames; frame++) {
+		// Same animation Renderer drives through the shaders
+		float time = frame * options.timeStep;
+		glm::mat4 trans = glm::rotate(glm::mat4(1.0f), time, glm::vec3(0.0, 1.0, 0.0));
+		float h = 360.0f * ((sin(time) / 2.0f) + 0.5f);
+		raster.setTriangles(&vertices[0], vertices.size() / 2, 2, trans);
+		raster.draw(getHSVColor(h, 1.0f, 1.0f), ColorVec3(0.2f, 0.3f, 0.3f), image);
+		if (options.outputPrefix) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s%04d.png", options.outputPrefix, frame);
+			if (!writePNG(path, image, &pool)) {
+				std::cout << "ERROR::SOFTRASTER::WRITE_FAILED " << path << std::endl;
+				return -1;
+			}
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Software rasterized " << options.frames << " frames at " << options.width << "x" << options.height
+		<< " (depth " << options.depth << ", " << pool.size() << " threads, " << (hasAVX2() ? "AVX2" : "scalar")
+		<< ") in " << seconds * 1000.0 << " ms after " << generateMs << " ms of generation";
+	if (options.frames > 0 && seconds > 0.0)
+		std::cout << ", " << options.frames / seconds << " fps";
+	std::cout << std::endl;
+	return 0;
+}
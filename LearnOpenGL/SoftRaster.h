@@ -0,0 +1,64 @@
+#ifndef SOFTRASTER_H
+#define SOFTRASTER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Image.h"
+#include "Sierpinski.h"
+#include "ThreadPool.h"
+
+struct HeadlessOptions;
+
+// CPU rasterizer for flat coloured, untextured triangle soup, no GL involved.
+// Triangles are set up and binned into 64x64 screen tiles in parallel, then each
+// tile is rasterized by one worker with 8-wide AVX2 edge functions (scalar when the
+// CPU lacks AVX2). Every covered pixel gets the same colour, so draw order within a
+// tile does not matter and shared edges may be filled twice without any visible
+// difference.
+class SoftRaster
+{
+public:
+	static const int TILE_SIZE = 64;
+
+	SoftRaster(int width, int height, ThreadPool &pool);
+
+	int width() const { return fbWidth; }
+	int height() const { return fbHeight; }
+
+	// Transforms and bins a drawTris()-style stream: vertexCount vertices of stride
+	// floats each, x and y first. Positions go through transform like in shader.vert.
+	void setTriangles(const float* vertices, size_t vertexCount, int stride, const glm::mat4 &transform);
+	// Resolve into RGBA
+	void draw(ColorVec3 color, ColorVec3 clearColor, Image &out);
+	// Resolve into a 1 bit per pixel coverage mask, rows of wordsPerRow() 64-bit words,
+	// bit x & 63 of word x >> 6 is pixel x
+	void drawMask(std::vector<uint64_t> &bits);
+	int wordsPerRow() const { return (fbWidth + 63) / 64; }
+
+private:
+	struct Triangle {
+		float x[3];
+		float y[3];
+		int minX, minY, maxX, maxY;
+	};
+
+	int fbWidth, fbHeight;
+	int tilesX, tilesY;
+	ThreadPool &pool;
+	// Setup runs in chunks, each with its own surviving triangles and bins, so
+	// binning needs no locks. bins[chunk][tile] indexes chunkTriangles[chunk].
+	std::vector<std::vector<Triangle> > chunkTriangles;
+	std::vector<std::vector<std::vector<uint32_t> > > bins;
+
+	template <typename Span>
+	void rasterizeTile(int tile, Span span);
+};
+
+// Same frames as runHeadless, drawn by SoftRaster
+int runSoftRaster(const HeadlessOptions &options);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue from one producer thread to one consumer thread. Each side
+// owns one index and only reads the other's, so a push or pop is a load, a copy and a
+// release store, and never waits. CAPACITY must be a power of two.
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	// Producer only. False when full.
+	bool push(const T &value)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == CAPACITY)
+			return false;
+		slots[t & (CAPACITY - 1)] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. False when empty.
+	bool pop(T &value)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+		value = slots[h & (CAPACITY - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+	// A cache line apart, the two threads write one each. Padding rather than alignas,
+	// C++14's new doesn't honour over-alignment.
+	std::atomic<size_t> head; // next slot to pop
+	char headPadding[64];
+	std::atomic<size_t> tail; // next slot to push
+	char tailPadding[64];
+	T slots[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "StartupTimer.h"
+
+#include <cstdio>
+
+StartupTimer::StartupTimer() : start(std::chrono::steady_clock::now()), last(start)
+{
+}
+
+void StartupTimer::mark(const char * step)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	Step s = { step, std::chrono::duration<double, std::milli>(now - last).count() };
+	steps.push_back(s);
+	last = now;
+}
+
+double StartupTimer::totalMs() const
+{
+	return std::chrono::duration<double, std::milli>(last - start).count();
+}
+
+std::string StartupTimer::report() const
+{
+	char line[128];
+	snprintf(line, sizeof(line), "Startup %.1f ms:", totalMs());
+	std::string text = line;
+	for (size_t i = 0; i < steps.size(); i++) {
+		snprintf(line, sizeof(line), "%s %s %.1f", i > 0 ? "," : "", steps[i].name, steps[i].ms);
+		text += line;
+	}
+	return text;
+}
@@ -0,0 +1,102 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(int threads) : busy(0), stopping(false)
+{
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+int ThreadPool::size() const
+{
+	return (int)workers.size();
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	jobReady.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return jobs.empty() && busy == 0; });
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &body)
+{
+	if (count <= 0)
+		return;
+	// Indices are handed out one at a time, so uneven items balance themselves.
+	// Helpers reference this stack frame, so it has to outlive every one of them.
+	int helpers = std::min(count - 1, size());
+	std::atomic<int> next(0);
+	std::atomic<int> running(helpers);
+	std::mutex doneMutex;
+	std::condition_variable done;
+	auto run = [&]() {
+		int i;
+		while ((i = next++) < count)
+			body(i);
+	};
+	for (int i = 0; i < helpers; i++) {
+		submit([&]() {
+			run();
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (--running == 0)
+				done.notify_all();
+		});
+	}
+	run();
+	std::unique_lock<std::mutex> lock(doneMutex);
+	done.wait(lock, [&] { return running == 0; });
+}
+
+void ThreadPool::work()
+{
+	TRACE_THREAD_NAME("pool worker");
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping && jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			busy++;
+		}
+		{
+			TRACE_SCOPE("pool job");
+			job();
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy--;
+			if (jobs.empty() && busy == 0)
+				idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off a shared queue
+class ThreadPool
+{
+public:
+	// 0 threads means one per hardware thread
+	ThreadPool(int threads = 0);
+	~ThreadPool();
+
+	int size() const;
+	void submit(std::function<void()> job);
+	// Blocks until every submitted job has finished
+	void wait();
+	// Runs body(i) for i in [0, count), spread over the workers plus the calling
+	// thread, and returns once all are done
+	void parallelFor(int count, const std::function<void(int)> &body);
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()> > jobs;
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable idle;
+	int busy;
+	bool stopping;
+
+	void work();
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "TiledExport.h"
+#include "AnalyticRaster.h"
+#include "BigTiff.h"
+#include "PngWriter.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Rows rendered per step, one row of BigTIFF tiles
+static const int BAND_ROWS = BigTiffWriter::TILE_SIZE;
+
+// Where an earlier run of the same export stopped. offset and adler are only used
+// by PNG output, which can't recompute them.
+struct Progress {
+	int bands;
+	uint64_t offset;
+	uint32_t adler;
+};
+
+static Progress readProgress(const std::string &path, const ExportOptions &options)
+{
+	Progress progress = { 0, 0, 1 };
+	std::ifstream file(path.c_str());
+	int width = 0, height = 0, depth = 0, bands = 0;
+	float time = 0.0f;
+	uint64_t offset = 0;
+	uint32_t adler = 1;
+	if (!(file >> width >> height >> depth >> time >> bands >> offset >> adler))
+		return progress;
+	if (width != options.width || height != options.height || depth != options.depth || time != options.time)
+		return progress;
+	progress.bands = bands;
+	progress.offset = offset;
+	progress.adler = adler;
+	return progress;
+}
+
+static bool writeProgress(const std::string &path, const ExportOptions &options, const Progress &progress)
+{
+	// Written beside and renamed over, a crash mid-write must not lose the old count
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream file(temp.c_str(), std::ios::trunc);
+		file.precision(9);
+		file << options.width << " " << options.height << " " << options.depth << " " << options.time << " "
+			<< progress.bands << " " << progress.offset << " " << progress.adler << "\n";
+		if (!file)
+			return false;
+	}
+	remove(path.c_str());
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+static bool endsWith(const std::string &text, const std::string &suffix)
+{
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// The frame being exported, rendered a band of rows at a time
+struct ExportScene {
+	ThreadPool pool;
+	AnalyticRaster raster;
+	uint32_t fill, clear;
+
+	ExportScene(const ExportOptions &options) : raster(options.width, options.height, pool) {
+		glm::vec2 pA(0.0f, 0.5f), pB(0.5f, -0.5f), pC(-0.5f, -0.5f); // Original Points For Triangle
+		glm::mat4 trans = glm::rotate(glm::mat4(1.0f), options.time, glm::vec3(0.0, 1.0, 0.0));
+		raster.setView(pA, pB, pC, options.depth, trans);
+		float h = 360.0f * ((sin(options.time) / 2.0f) + 0.5f);
+		fill = packRGBA(getHSVColor(h, 1.0f, 1.0f));
+		clear = packRGBA(ColorVec3(0.2f, 0.3f, 0.3f));
+	}
+
+	// row(y, pixels) for every image row of band, in parallel
+	template <typename Row>
+	void renderBand(int band, Row row) {
+		int width = raster.width(), height = raster.height();
+		pool.parallelFor(BAND_ROWS, [&](int i) {
+			int y = band * BAND_ROWS + i;
+			if (y >= height)
+				return;
+			std::vector<uint64_t> words(raster.wordsPerRow());
+			std::vector<uint32_t> pixels(width);
+			raster.coverSpan(y, 0, width, &words[0]);
+			expandCoverage(&words[0], width, fill, clear, &pixels[0]);
+			row(i, &pixels[0]);
+		});
+	}
+};
+
+static int exportTiff(const ExportOptions &options, ExportScene &scene, const std::string &progressPath, int &firstBand)
+{
+	BigTiffWriter writer;
+	if (!writer.open(options.path, options.width, options.height, firstBand)) {
+		// Output went missing or is unreadable, start over
+		if (firstBand == 0 || !writer.open(options.path, options.width, options.height, 0))
+			return -1;
+		firstBand = 0;
+	}
+
+	const int TILE = BigTiffWriter::TILE_SIZE;
+	// The one row of tiles in memory: tilesAcross tiles of TILE x TILE RGB, zeroed so the
+	// padding right of and below the image is black
+	std::vector<unsigned char> tiles((size_t)writer.tilesAcross * BigTiffWriter::TILE_BYTES);
+	for (int band = firstBand; band < writer.tilesDown; band++) {
+		std::fill(tiles.begin(), tiles.end(), 0);
+		scene.renderBand(band, [&](int ty, const uint32_t* pixels) {
+			// Scatter the image row into row ty of every tile
+			for (int x = 0; x < options.width; x++) {
+				unsigned char* dst = &tiles[(size_t)(x / TILE) * BigTiffWriter::TILE_BYTES + ((size_t)ty * TILE + x % TILE) * 3];
+				const unsigned char* src = (const unsigned char*)&pixels[x];
+				dst[0] = src[0];
+				dst[1] = src[1];
+				dst[2] = src[2];
+			}
+		});
+		if (!writer.writeTileRow(band, &tiles[0]) || !writer.flush())
+			return -1;
+		Progress progress = { band + 1, 0, 1 };
+		if (!writeProgress(progressPath, options, progress)) {
+			std::cout << "ERROR::EXPORT::PROGRESS_FAILED " << progressPath << std::endl;
+			return -1;
+		}
+		std::cout << "\rBand " << band + 1 << "/" << writer.tilesDown << std::flush;
+	}
+	if (!writer.close()) {
+		std::cout << std::endl << "ERROR::EXPORT::WRITE_FAILED " << options.path << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+static int exportPng(const ExportOptions &options, ExportScene &scene, const std::string &progressPath, int &firstBand, const Progress &resumeAt)
+{
+	// Two colours, so a 1-bit palette
+	uint32_t palette[2] = { scene.clear, scene.fill };
+	PngWriter writer(&scene.pool);
+	PngWriter::Checkpoint checkpoint;
+	checkpoint.rows = firstBand * BAND_ROWS;
+	checkpoint.offset = resumeAt.offset;
+	checkpoint.adler = resumeAt.adler;
+	if (firstBand == 0 || !writer.resume(options.path, options.width, options.height, palette, 2, checkpoint)) {
+		firstBand = 0;
+		if (!writer.open(options.path, options.width, options.height, palette, 2))
+			return -1;
+	}
+
+	int bands = (options.height + BAND_ROWS - 1) / BAND_ROWS;
+	std::vector<unsigned char> rgba((size_t)options.width * BAND_ROWS * 4);
+	for (int band = firstBand; band < bands; band++) {
+		scene.renderBand(band, [&](int i, const uint32_t* pixels) {
+			memcpy(&rgba[(size_t)i * options.width * 4], pixels, (size_t)options.width * 4);
+		});
+		if (!writer.writeRows(&rgba[0], std::min(BAND_ROWS, options.height - band * BAND_ROWS)))
+			return -1;
+		checkpoint = writer.checkpoint();
+		Progress progress = { band + 1, checkpoint.offset, checkpoint.adler };
+		if (!writeProgress(progressPath, options, progress)) {
+			std::cout << "ERROR::EXPORT::PROGRESS_FAILED " << progressPath << std::endl;
+			return -1;
+		}
+		std::cout << "\rBand " << band + 1 << "/" << bands << std::flush;
+	}
+	if (!writer.close()) {
+		std::cout << std::endl << "ERROR::EXPORT::WRITE_FAILED " << options.path << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int runExport(const ExportOptions & options)
+{
+	if (options.width <= 0 || options.height <= 0) {
+		std::cout << "ERROR::EXPORT::BAD_SIZE " << options.width << "x" << options.height << std::endl;
+		return -1;
+	}
+	std::string progressPath = std::string(options.path) + ".progress";
+	Progress progress = readProgress(progressPath, options);
+	int firstBand = progress.bands;
+	if (firstBand > 0)
+		std::cout << "Resuming " << options.path << " at row " << firstBand * BAND_ROWS << std::endl;
+
+	ExportScene scene(options);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool png = endsWith(options.path, ".png") || endsWith(options.path, ".PNG");
+	int result = png ? exportPng(options, scene, progressPath, firstBand, progress) : exportTiff(options, scene, progressPath, firstBand);
+	if (result != 0)
+		return result;
+	remove(progressPath.c_str());
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double megapixels = (double)options.width * std::max(0, options.height - firstBand * BAND_ROWS) / 1e6;
+	std::cout << std::endl << "Exported " << options.width << "x" << options.height << " (depth " << options.depth << ") to "
+		<< options.path << " in " << seconds << " s, " << (seconds > 0.0 ? megapixels / seconds : 0.0) << " MP/s" << std::endl;
+	return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef TILEDEXPORT_H
+#define TILEDEXPORT_H
+
+struct ExportOptions {
+	const char* path; // BigTIFF, or PNG when it ends in .png; progress is kept in <path>.progress
+	int width;
+	int height;
+	int depth;
+	float time;       // animation time of the exported frame
+};
+
+// Renders one frame of any size (64k x 64k posters and up) with AnalyticRaster a row
+// of BigTiffWriter tiles at a time, so neither the image nor a mesh is ever held in
+// memory. Each band goes to a BigTiffWriter or, streamed, to a 1-bit PngWriter. After
+// every band the progress goes to <path>.progress; running the same export again
+// resumes from there. Returns the process exit code.
+int runExport(const ExportOptions &options);
+
+#endif
@@ -0,0 +1,99 @@
+#include "Trace.h"
+
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> traceActive(false);
+thread_local TraceBuffer* traceBuffer = NULL;
+
+static thread_local const char* threadName = NULL;
+// Every buffer ever registered. They are kept after their thread exits, so its
+// events still make it into the trace.
+static std::mutex registryMutex;
+static std::vector<TraceBuffer*> registry;
+// traceStart()'s time in both clocks, to turn ticks into nanoseconds
+static int64_t startTicks = 0, startTime = 0;
+
+TraceBuffer* traceRegisterThread()
+{
+	TraceBuffer* buffer = new TraceBuffer();
+	buffer->written.store(0, std::memory_order_relaxed);
+	buffer->name = threadName;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->tid = (int)registry.size() + 1;
+	registry.push_back(buffer);
+	traceBuffer = buffer;
+	return buffer;
+}
+
+void traceStart()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (size_t i = 0; i < registry.size(); i++)
+		registry[i]->written.store(0, std::memory_order_relaxed);
+	startTicks = traceTicks();
+	startTime = traceNow();
+	traceActive.store(true, std::memory_order_release);
+}
+
+void traceStop()
+{
+	traceActive.store(false, std::memory_order_release);
+}
+
+void traceThreadName(const char * name)
+{
+	threadName = name;
+	if (traceBuffer)
+		traceBuffer->name = name;
+}
+
+bool traceWrite(const char * path)
+{
+	traceStop();
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		std::cout << "ERROR::TRACE::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(registryMutex);
+	int64_t elapsed = traceNow() - startTime;
+	double nsPerTick = elapsed > 0 ? (double)elapsed / (traceTicks() - startTicks) : 1.0;
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+	uint64_t events = 0, lost = 0;
+	for (size_t t = 0; t < registry.size(); t++) {
+		TraceBuffer &buffer = *registry[t];
+		uint64_t written = buffer.written.load(std::memory_order_acquire);
+		uint64_t start = written > TraceBuffer::EVENTS ? written - TraceBuffer::EVENTS : 0;
+		lost += start;
+		if (buffer.name) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", buffer.tid, buffer.name);
+			first = false;
+		}
+		for (uint64_t i = start; i < written; i++) {
+			const TraceEvent &event = buffer.events[i & (TraceBuffer::EVENTS - 1)];
+			// Complete events, microseconds since traceStart()
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				first ? "" : ",\n", event.name, buffer.tid, (event.begin - startTicks) * nsPerTick / 1000.0, (event.end - event.begin) * nsPerTick / 1000.0);
+			if (event.argName)
+				fprintf(file, ",\"args\":{\"%s\":%lld}", event.argName, (long long)event.arg);
+			fprintf(file, "}");
+			first = false;
+		}
+		events += written - start;
+	}
+	fprintf(file, "\n]}\n");
+	if (fclose(file) != 0) {
+		std::cout << "ERROR::TRACE::WRITE_FAILED " << path << std::endl;
+		return false;
+	}
+	std::cout << "Wrote " << events << " trace events from " << registry.size() << " threads to " << path;
+	if (lost > 0)
+		std::cout << " (" << lost << " overwritten, the buffers hold " << TraceBuffer::EVENTS << " per thread)";
+	std::cout << std::endl;
+	return true;
+}
@@ -0,0 +1,120 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "Simd.h"
+#if defined(SIMD_X86) && defined(__GNUC__)
+#include <x86intrin.h>
+#endif
+
+// Timeline of what every thread was doing, written as Chrome trace JSON for
+// chrome://tracing or ui.perfetto.dev: shader compiles, generation by level, uploads,
+// the frame phases, swaps and thread pool jobs, each on the thread that ran it.
+//
+// The TRACE_ macros are only compiled in with SIERPINSKI_TRACE defined (cmake
+// -DSIERPINSKI_TRACE=ON); otherwise they are nothing at all. Compiled in, a scope
+// costs one relaxed load while not recording and two timestamps and a store into
+// the thread's own ring buffer while it is, with no lock or shared cache line. On
+// x86 the timestamps are TSC ticks, converted when the trace is written, since
+// steady_clock alone takes 40 ns a read on some VMs.
+// Names and argument names must be string literals, only the pointer is kept.
+#ifdef SIERPINSKI_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, argName, value) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, argName, (int64_t)(value))
+// Only traces when condition holds, e.g. the top levels of a recursion
+#define TRACE_SCOPE_IF(condition, name, argName, value) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, argName, (int64_t)(value), condition)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_ARG(name, argName, value) ((void)0)
+#define TRACE_SCOPE_IF(condition, name, argName, value) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+inline bool traceCompiledIn()
+{
+#ifdef SIERPINSKI_TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+struct TraceEvent {
+	const char* name;
+	const char* argName; // NULL for none
+	int64_t arg;
+	int64_t begin, end;  // traceTicks()
+};
+
+// One thread's events. Only that thread writes; once full the oldest are overwritten.
+struct TraceBuffer {
+	static const uint64_t EVENTS = 1 << 16;
+	TraceEvent events[EVENTS];
+	std::atomic<uint64_t> written;
+	int tid;
+	const char* name;
+};
+
+extern std::atomic<bool> traceActive;
+// The calling thread's buffer, NULL until it records its first event
+extern thread_local TraceBuffer* traceBuffer;
+TraceBuffer* traceRegisterThread();
+
+// Recording starts empty and runs until traceStop()
+void traceStart();
+void traceStop();
+// Shown as the thread's name on the timeline
+void traceThreadName(const char* name);
+// Stops recording and writes every thread's events. Call once the other threads
+// are idle, a thread still recording may tear the events being written.
+bool traceWrite(const char* path);
+
+// steady_clock nanoseconds
+inline int64_t traceNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The invariant TSC on x86, traceNow() elsewhere
+inline int64_t traceTicks()
+{
+#ifdef SIMD_X86
+	return (int64_t)__rdtsc();
+#else
+	return traceNow();
+#endif
+}
+
+class TraceScope
+{
+public:
+	TraceScope(const char* name, const char* argName = NULL, int64_t arg = 0, bool enabled = true)
+		: name(name), argName(argName), arg(arg), begin(enabled && traceActive.load(std::memory_order_relaxed) ? traceTicks() : 0) {}
+	~TraceScope() {
+		if (begin == 0)
+			return;
+		TraceBuffer* buffer = traceBuffer ? traceBuffer : traceRegisterThread();
+		uint64_t index = buffer->written.load(std::memory_order_relaxed);
+		TraceEvent &event = buffer->events[index & (TraceBuffer::EVENTS - 1)];
+		event.name = name;
+		event.argName = argName;
+		event.arg = arg;
+		event.begin = begin;
+		event.end = traceTicks();
+		buffer->written.store(index + 1, std::memory_order_release);
+	}
+
+private:
+	const char* name;
+	const char* argName;
+	int64_t arg;
+	int64_t begin;
+};
+
+#endif
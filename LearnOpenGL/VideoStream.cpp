@@ -0,0 +1,203 @@
+#include "VideoStream.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// BT.601 limited range in 8.8 fixed point, as in libyuv's and ffmpeg's C paths. Chroma
+// uses the sum of a 2x2 block, hence the extra 2 bits of shift.
+static inline unsigned char lumaOf(const unsigned char* p)
+{
+	return (unsigned char)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+}
+
+static inline unsigned char chromaU(int r, int g, int b)
+{
+	return (unsigned char)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+}
+
+static inline unsigned char chromaV(int r, int g, int b)
+{
+	return (unsigned char)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+}
+
+#ifdef SIMD_X86
+// 8 pixels of two rows per step, the same arithmetic as the scalar code. Returns how
+// many pixels of the row pair it did.
+AVX2_TARGET static int convertPairAVX2(const unsigned char* top, const unsigned char* bottom, int width,
+	unsigned char* yTop, unsigned char* yBottom, unsigned char* u, unsigned char* v)
+{
+	const __m256i lowBytes = _mm256_set1_epi32(0x00FF00FF);
+	// madd_epi16 pairs: R in the low half of each 32-bit lane, B in the high half;
+	// G low, A high
+	const __m256i yRB = _mm256_set1_epi32((25 << 16) | 66);
+	const __m256i yG = _mm256_set1_epi32(129);
+	const __m256i uRB = _mm256_set1_epi32((112 << 16) | (uint16_t)-38);
+	const __m256i uG = _mm256_set1_epi32((uint16_t)-74);
+	const __m256i vRB = _mm256_set1_epi32((int)((uint32_t)(uint16_t)-18 << 16) | 112);
+	const __m256i vG = _mm256_set1_epi32((uint16_t)-94);
+	const __m256i yRound = _mm256_set1_epi32(128), yOffset = _mm256_set1_epi32(16);
+	const __m256i cRound = _mm256_set1_epi32(512), cOffset = _mm256_set1_epi32(128);
+	const __m256i gatherY = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256i gatherC = _mm256_setr_epi32(0, 1, 4, 5, 0, 1, 4, 5);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(top + x * 4));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(bottom + x * 4));
+		__m256i aRB = _mm256_and_si256(a, lowBytes), aGA = _mm256_and_si256(_mm256_srli_epi32(a, 8), lowBytes);
+		__m256i bRB = _mm256_and_si256(b, lowBytes), bGA = _mm256_and_si256(_mm256_srli_epi32(b, 8), lowBytes);
+
+		__m256i ya = _mm256_add_epi32(_mm256_madd_epi16(aRB, yRB), _mm256_madd_epi16(aGA, yG));
+		__m256i yb = _mm256_add_epi32(_mm256_madd_epi16(bRB, yRB), _mm256_madd_epi16(bGA, yG));
+		ya = _mm256_add_epi32(_mm256_srli_epi32(_mm256_add_epi32(ya, yRound), 8), yOffset);
+		yb = _mm256_add_epi32(_mm256_srli_epi32(_mm256_add_epi32(yb, yRound), 8), yOffset);
+		// Bytes of each 128-bit half end up as [a0-3 b0-3 a0-3 b0-3] and [a4-7 b4-7 ...]
+		__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(ya, yb), _mm256_packus_epi32(ya, yb));
+		__m128i luma = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(packed, gatherY));
+		_mm_storel_epi64((__m128i*)(yTop + x), luma);
+		_mm_storel_epi64((__m128i*)(yBottom + x), _mm_srli_si128(luma, 8));
+
+		// 2x2 sums: rows added, then neighbouring pixels. The 16-bit halves stay
+		// under 1020 so they never carry into each other.
+		__m256i sRB = _mm256_add_epi32(aRB, bRB), sGA = _mm256_add_epi32(aGA, bGA);
+		sRB = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(sRB, sRB), gatherC);
+		sGA = _mm256_permutevar8x32_epi32(_mm256_hadd_epi32(sGA, sGA), gatherC);
+		__m256i cu = _mm256_add_epi32(_mm256_madd_epi16(sRB, uRB), _mm256_madd_epi16(sGA, uG));
+		__m256i cv = _mm256_add_epi32(_mm256_madd_epi16(sRB, vRB), _mm256_madd_epi16(sGA, vG));
+		cu = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(cu, cRound), 10), cOffset);
+		cv = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(cv, cRound), 10), cOffset);
+		// [u0-3 v0-3 ...] in the low half
+		__m128i chroma = _mm256_castsi256_si128(_mm256_packus_epi16(_mm256_packus_epi32(cu, cv), _mm256_packus_epi32(cu, cv)));
+		int uBytes = _mm_cvtsi128_si32(chroma), vBytes = _mm_cvtsi128_si32(_mm_srli_si128(chroma, 4));
+		memcpy(u + x / 2, &uBytes, 4);
+		memcpy(v + x / 2, &vBytes, 4);
+	}
+	return x;
+}
+#endif
+
+void convertToYUV420(const unsigned char * rgba, int width, int height, int firstPair, int pairs,
+	unsigned char * yPlane, unsigned char * uPlane, unsigned char * vPlane)
+{
+	static const bool avx2 = hasAVX2();
+	size_t stride = (size_t)width * 4;
+	int chromaWidth = (width + 1) / 2;
+	for (int pair = firstPair; pair < firstPair + pairs; pair++) {
+		int y0 = 2 * pair, y1 = std::min(y0 + 1, height - 1);
+		// GL rows are bottom-up
+		const unsigned char* top = rgba + (size_t)(height - 1 - y0) * stride;
+		const unsigned char* bottom = rgba + (size_t)(height - 1 - y1) * stride;
+		unsigned char* yTop = yPlane + (size_t)y0 * width;
+		unsigned char* yBottom = yPlane + (size_t)y1 * width;
+		unsigned char* u = uPlane + (size_t)pair * chromaWidth;
+		unsigned char* v = vPlane + (size_t)pair * chromaWidth;
+
+		int x = 0;
+#ifdef SIMD_X86
+		if (avx2)
+			x = convertPairAVX2(top, bottom, width, yTop, yBottom, u, v);
+#endif
+		for (; x < width; x += 2) {
+			int x1 = std::min(x + 1, width - 1);
+			const unsigned char* p[4] = { top + x * 4, top + x1 * 4, bottom + x * 4, bottom + x1 * 4 };
+			yTop[x] = lumaOf(p[0]);
+			yTop[x1] = lumaOf(p[1]);
+			yBottom[x] = lumaOf(p[2]);
+			yBottom[x1] = lumaOf(p[3]);
+			int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+			int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+			int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+			u[x / 2] = chromaU(r, g, b);
+			v[x / 2] = chromaV(r, g, b);
+		}
+	}
+}
+
+VideoStream::VideoStream(const char * path, VideoFormat format, int fps, int threads)
+	: framesWritten(0), file(NULL), ownsFile(false), format(format), fps(fps), width(0), height(0), pool(threads)
+{
+	if (strcmp(path, "-") == 0) {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		file = stdout;
+	}
+	else {
+		file = fopen(path, "wb");
+		ownsFile = true;
+		if (!file)
+			std::cout << "ERROR::VIDEO::OPEN_FAILED " << path << std::endl;
+	}
+}
+
+VideoStream::~VideoStream()
+{
+	finish();
+}
+
+bool VideoStream::consume(const unsigned char * rgba, int width, int height, int frame)
+{
+	if (!file)
+		return false;
+	if (framesWritten == 0) {
+		this->width = width;
+		this->height = height;
+		if (format == VIDEO_Y4M) {
+			// C420jpeg: chroma sited between the 2x2 pixels it averages
+			fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n", width, height, fps);
+			int chroma = ((width + 1) / 2) * ((height + 1) / 2);
+			frameBuffer.resize(6 + (size_t)width * height + 2 * (size_t)chroma);
+			memcpy(&frameBuffer[0], "FRAME\n", 6);
+		}
+	}
+	else if (width != this->width || height != this->height) {
+		std::cout << "ERROR::VIDEO::SIZE_CHANGED frame " << frame << std::endl;
+		return false;
+	}
+
+	bool ok = true;
+	size_t stride = (size_t)width * 4;
+	if (format == VIDEO_RGBA) {
+		// Straight from the mapped buffer, flipped to top row first
+		for (int y = height - 1; y >= 0 && ok; y--)
+			ok = fwrite(rgba + (size_t)y * stride, 1, stride, file) == stride;
+	}
+	else {
+		unsigned char* yPlane = &frameBuffer[6];
+		unsigned char* uPlane = yPlane + (size_t)width * height;
+		unsigned char* vPlane = uPlane + (size_t)((width + 1) / 2) * ((height + 1) / 2);
+		int pairs = (height + 1) / 2;
+		int bands = std::min(pairs, 4 * (pool.size() + 1));
+		pool.parallelFor(bands, [&](int band) {
+			int first = (int)((long long)pairs * band / bands), last = (int)((long long)pairs * (band + 1) / bands);
+			convertToYUV420(rgba, width, height, first, last - first, yPlane, uPlane, vPlane);
+		});
+		ok = fwrite(&frameBuffer[0], 1, frameBuffer.size(), file) == frameBuffer.size();
+	}
+	if (!ok) {
+		// A closed pipe ends up here too
+		std::cout << "ERROR::VIDEO::WRITE_FAILED frame " << frame << std::endl;
+		return false;
+	}
+	framesWritten++;
+	return true;
+}
+
+bool VideoStream::finish()
+{
+	if (!file)
+		return false;
+	bool ok = fflush(file) == 0;
+	if (ownsFile) {
+		ok = fclose(file) == 0 && ok;
+		file = NULL;
+	}
+	return ok;
+}
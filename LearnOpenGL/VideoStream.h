@@ -0,0 +1,48 @@
+#ifndef VIDEOSTREAM_H
+#define VIDEOSTREAM_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "FrameCapture.h"
+#include "ThreadPool.h"
+
+enum VideoFormat {
+	VIDEO_Y4M,  // YUV4MPEG2, 4:2:0 BT.601 limited range, what ffmpeg/x264 read from a pipe
+	VIDEO_RGBA  // headerless 8-bit RGBA frames, top row first (-f rawvideo -pix_fmt rgba)
+};
+
+// FrameSink streaming every frame to a file or, for path "-", stdout. Conversion
+// reads straight from FrameCapture's mapped buffer, split over a thread pool by
+// rows, with an AVX2 RGB -> YUV 4:2:0 path.
+class VideoStream : public FrameSink
+{
+public:
+	int framesWritten;
+
+	VideoStream(const char* path, VideoFormat format, int fps, int threads = 0);
+	~VideoStream();
+
+	bool ok() const { return file != NULL; }
+	bool consume(const unsigned char* rgba, int width, int height, int frame);
+	bool finish();
+
+private:
+	FILE* file;
+	bool ownsFile;
+	VideoFormat format;
+	int fps;
+	int width, height;
+	ThreadPool pool;
+	// One Y4M frame: "FRAME\n" then the Y, U and V planes
+	std::vector<unsigned char> frameBuffer;
+};
+
+// Converts bottom-up RGBA rows [row, row + 2 * pairs) (top-down numbering) of a
+// width x height image to the Y, U, V planes of a top-down 4:2:0 frame. Odd edges
+// reuse the last column/row for chroma.
+void convertToYUV420(const unsigned char* rgba, int width, int height, int firstPair, int pairs,
+	unsigned char* yPlane, unsigned char* uPlane, unsigned char* vPlane);
+
+#endif
@@ -0,0 +1,67 @@
+// Helpers shared by the Sierpinski shaders, pulled in with #include "common.glsl"
+
+// HSV -> RGB for s = v = 1, h in degrees
+vec3 hueColor(float h)
+{
+    return clamp(abs(mod(h / 60.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+}
+
+// Same spin around the y axis main() builds with glm::rotate
+mat4 spinY(float angle)
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    return mat4(c, 0.0, -s, 0.0,
+                0.0, 1.0, 0.0, 0.0,
+                s, 0.0, c, 0.0,
+                0.0, 0.0, 0.0, 1.0);
+}
+
+// Corner of the triangle drawn by vertex vertexId, with no vertex buffer at all.
+// Triangles are numbered level by level: level L holds 3^L of them, and the base-3
+// digits of a triangle's index within its level pick the sub-triangle to descend
+// into exactly as drawTris() recurses (0: A, 1: B, 2: C).
+vec2 sierpinskiVertex(int vertexId, vec2 a, vec2 b, vec2 c)
+{
+    int tri = vertexId / 3;
+    int corner = vertexId - tri * 3;
+
+    int first = 0;
+    int count = 1;
+    int level = 0;
+    while (tri >= first + count) {
+        first += count;
+        count *= 3;
+        level++;
+    }
+
+    int index = tri - first;
+    for (int l = 0; l < level; l++) {
+        count /= 3;
+        int digit = index / count;
+        index -= digit * count;
+        vec2 ab = (a + b) * 0.5;
+        vec2 bc = (b + c) * 0.5;
+        vec2 ac = (a + c) * 0.5;
+        if (digit == 0) {
+            b = ab;
+            c = ac;
+        }
+        else if (digit == 1) {
+            a = b;
+            b = ab;
+            c = bc;
+        }
+        else {
+            a = c;
+            b = ac;
+            c = bc;
+        }
+    }
+
+    if (corner == 0)
+        return (a + b) * 0.5;
+    if (corner == 1)
+        return (b + c) * 0.5;
+    return (a + c) * 0.5;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Shader build step: flattens #include "file" directives and embeds the results in
+# ShaderSources.h as constexpr strings, so the app never reads GLSL from disk.
+# Rerun after editing any .vert/.frag/.glsl file:
+#   python embed_shaders.py
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SHADERS = [
+	('SHADER_VERT_SOURCE', 'shader.vert'),
+	('SHADER_FRAG_SOURCE', 'shader.frag'),
+	('SIERPINSKI_FRAG_SOURCE', 'sierpinski.frag'),
+]
+INCLUDE = re.compile(r'^\s*#\s*include\s+"([^"]+)"\s*$')
+
+
+def flatten(path, seen):
+	if path in seen:
+		sys.exit('embed_shaders: include cycle through ' + path)
+	seen = seen | {path}
+	lines = []
+	with open(path) as f:
+		for line in f.read().splitlines():
+			match = INCLUDE.match(line)
+			if match:
+				lines.extend(flatten(os.path.join(os.path.dirname(path), match.group(1)), seen))
+			else:
+				lines.append(line)
+	return lines
+
+
+def main():
+	out = [
+		'// Generated by embed_shaders.py, do not edit. Edit the .vert/.frag/.glsl files and rerun it.',
+		'#ifndef SHADERSOURCES_H',
+		'#define SHADERSOURCES_H',
+		'',
+	]
+	for name, filename in SHADERS:
+		source = '\n'.join(flatten(os.path.join(HERE, filename), set()))
+		if ')GLSL"' in source:
+			sys.exit('embed_shaders: %s contains the raw string delimiter' % filename)
+		out.append('// %s' % filename)
+		out.append('constexpr const char* %s = R"GLSL(%s\n)GLSL";' % (name, source))
+		out.append('')
+	out.append('#endif')
+	target = os.path.join(HERE, 'ShaderSources.h')
+	text = '\n'.join(out)
+	if not os.path.exists(target) or open(target).read() != text:
+		with open(target, 'w') as f:
+			f.write(text)
+
+
+if __name__ == '__main__':
+	main()
@@ -1,187 +1,496 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <vector>
+#include <sstream>
+#include <string>
+#include <thread>
 
 #include "stb_image.h" // All credit goes to Sean Barrett
 #include "Shader.h"
-
-struct ColorVec3 {
-	float r;
-	float g;
-	float b;
-	ColorVec3(float r0, float g0, float b0) {
-		r = r0;
-		g = g0;
-		b = b0;
+#include "ShaderCache.h"
+#include "GLExt.h"
+#include "ShaderReloader.h"
+#include "ShaderLibrary.h"
+#include "Renderer.h"
+#include "MeshRegenerator.h"
+#include "MeshStream.h"
+#include "Headless.h"
+#include "SoftRaster.h"
+#include "AnalyticRaster.h"
+#include "TiledExport.h"
+#include "FrameCapture.h"
+#include "VideoStream.h"
+#include "FrameProfiler.h"
+#include "Shootout.h"
+#include "AppConfig.h"
+#include "GLAccounting.h"
+#include "GLTrace.h"
+#include "Sierpinski.h"
+#include "StartupTimer.h"
+#include "Trace.h"
+
+// What main has started by the time renderLoop takes over
+struct Startup {
+	StartupTimer timer;
+	// Building mesh while joinable, see OVERLAPPED INIT
+	std::thread meshWorker;
+	RendererMesh mesh;
+	double meshMs;
+
+	~Startup() {
+		if (meshWorker.joinable())
+			meshWorker.join();
 	}
 };
 
 void framebuffer_size_callback(GLFWwindow * window, int width, int height);
-void processInput(GLFWwindow * window);
-void drawTris(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, std::vector<float> &vertices);
-void drawTri(glm::vec2 A, glm::vec2 B, glm::vec2 C, std::vector<float> &vertex_arr);
-glm::vec2 mid(glm::vec2 A, glm::vec2 B);
-ColorVec3 getHSVColor(float h, float s, float v);
+int processInput(GLFWwindow * window);
+void renderLoop(GLFWwindow * window, const AppConfig &config, Startup &startup);
+
+const int SCR_WIDTH = 800;
+const int SCR_HEIGHT = 600;
+
+// Defaults, the command line and config files override them (see AppConfig.h).
+// ANIM_CPU builds the hue and rotation on the CPU and uploads colorOver/transform every frame.
+// ANIM_GPU uploads a single time uniform and lets shader.vert derive both.
+enum AnimMode { ANIM_CPU, ANIM_GPU };
+const AnimMode ANIM_MODE = ANIM_GPU;
+// DRAW_MESH uploads the drawTris() triangles, DRAW_ANALYTIC draws the base triangle
+// once and lets sierpinski.frag decide every pixel, so DEPTH costs next to nothing.
+enum DrawMode { DRAW_MESH, DRAW_ANALYTIC };
+const DrawMode DRAW_MODE = DRAW_MESH;
+const int DEPTH = 5;
+
+static unsigned int shaderVariant(const AppConfig &config)
+{
+	return findRenderStrategy(config.strategy.c_str())->stream | (config.gpuAnim ? SHADER_GPU_ANIM | SHADER_COLOR_HUE : SHADER_COLOR_UNIFORM);
+}
 
-const int SCR_WID = 600;
-const int SCR_HT = 800;
+// Whether renderLoop streams the mesh in. Not with the hardware counters, which
+// count generate() and upload() on the main thread.
+static bool streamsMesh(const AppConfig &config)
+{
+	return config.streamMesh && !config.counters
+		&& MeshStream::supports(shaderVariant(config), findRenderStrategy(config.strategy.c_str())->indexed);
+}
 
-int main()
+int main(int argc, char** argv)
 {
+	AppConfig config;
+	config.width = SCR_WIDTH;
+	config.height = SCR_HEIGHT;
+	config.depth = DEPTH;
+	config.strategy = DRAW_MODE == DRAW_ANALYTIC ? "impostor" : "vbo";
+	config.gpuAnim = ANIM_MODE == ANIM_GPU;
+	config.frames = 0;
+	config.vsync = true;
+	config.timeStep = 0.0f;
+	config.counters = false;
+	config.glCalls = false;
+#ifdef NDEBUG
+	config.stateCache = true;
+#else
+	config.stateCache = false;
+#endif
+	config.benchmark = false;
+	config.overlapInit = true;
+	config.streamMesh = false;
+	unsigned int variant = shaderVariant(config);
+	Startup startup;
+
+	// Sierpinski --headless|--soft|--analytic [frames] [output prefix]
+	if (argc > 1 && (strcmp(argv[1], "--headless") == 0 || strcmp(argv[1], "--soft") == 0 || strcmp(argv[1], "--analytic") == 0)) {
+		HeadlessOptions options;
+		options.frames = argc > 2 ? atoi(argv[2]) : 60;
+		options.width = SCR_WIDTH;
+		options.height = SCR_HEIGHT;
+		options.depth = DEPTH;
+		options.variant = variant;
+		options.timeStep = 1.0f / 60.0f;
+		options.outputPrefix = argc > 3 ? argv[3] : "frame_";
+		options.videoPath = NULL;
+		options.videoFormat = VIDEO_Y4M;
+		if (strcmp(argv[1], "--soft") == 0)
+			return runSoftRaster(options);
+		if (strcmp(argv[1], "--analytic") == 0)
+			return runAnalyticRaster(options);
+		return runHeadless(options);
+	}
+
+	// Sierpinski --record frames [output.y4m|-] [y4m|rgba] [width height] renders offscreen
+	// at a fixed 60 fps timestep and streams the frames as one video, e.g.
+	//   Sierpinski --record 600 - | ffmpeg -i - sierpinski.mp4
+	//   Sierpinski --record 600 - rgba | ffmpeg -f rawvideo -pix_fmt rgba -s 800x600 -r 60 -i - sierpinski.mp4
+	if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+		HeadlessOptions options;
+		options.frames = atoi(argv[2]);
+		options.width = argc > 6 ? atoi(argv[5]) : SCR_WIDTH;
+		options.height = argc > 6 ? atoi(argv[6]) : SCR_HEIGHT;
+		options.depth = DEPTH;
+		options.variant = variant;
+		options.timeStep = 1.0f / 60.0f;
+		options.outputPrefix = NULL;
+		options.videoPath = argc > 3 ? argv[3] : "sierpinski.y4m";
+		options.videoFormat = argc > 4 && strcmp(argv[4], "rgba") == 0 ? VIDEO_RGBA : VIDEO_Y4M;
+		// stdout carries the video, so the log goes to stderr
+		if (strcmp(options.videoPath, "-") == 0)
+			std::cout.rdbuf(std::cerr.rdbuf());
+		return runHeadless(options);
+	}
+
+	// Sierpinski --shootout [depth] [width height] [frames] [baseline.json] compares every
+	// render strategy offscreen, writes shootout.json and fails on a regression against
+	// the baseline
+	if (argc > 1 && strcmp(argv[1], "--shootout") == 0) {
+		ShootoutOptions options;
+		options.depth = argc > 2 ? atoi(argv[2]) : DEPTH;
+		options.width = argc > 4 ? atoi(argv[3]) : SCR_WIDTH;
+		options.height = argc > 4 ? atoi(argv[4]) : SCR_HEIGHT;
+		options.frames = argc > 5 ? atoi(argv[5]) : 120;
+		options.warmupFrames = 10;
+		options.runs = 3;
+		options.jsonPath = "shootout.json";
+		options.baselinePath = argc > 6 ? argv[6] : NULL;
+		options.tolerance = 0.1;
+		return runShootout(options);
+	}
+
+	// Sierpinski --export width height [depth] [output.tif|.png], resumes an interrupted export
+	if (argc > 3 && strcmp(argv[1], "--export") == 0) {
+		ExportOptions options;
+		options.width = atoi(argv[2]);
+		options.height = atoi(argv[3]);
+		options.depth = argc > 4 ? atoi(argv[4]) : DEPTH;
+		options.path = argc > 5 ? argv[5] : "sierpinski.tif";
+		options.time = 0.0f;
+		return runExport(options);
+	}
+
+	// Otherwise the window, set up by --key value options, e.g.
+	//   Sierpinski --config nightly.cfg --strategy instanced --benchmark results.json
+	//   Sierpinski --capture shot_ --frames 120 --timestep 0.0166667
+	//   Sierpinski --profile
+	if (!parseArguments(argc, argv, 1, config))
+		return 1;
+	if (!config.tracePath.empty()) {
+		TRACE_THREAD_NAME("main");
+		traceStart();
+	}
+	startup.timer.mark("config");
+
+	// OVERLAPPED INIT //
+	// The mesh needs no GL, so a worker builds it while GLFW, the window, the context
+	// and the shaders come up. On a single hardware thread it would only compete
+	// with them. The hardware counters only count their own thread, with them on it
+	// is built where they can see it. A streamed mesh is built once there is a
+	// buffer to stream it into.
+	bool overlap = config.overlapInit && !config.counters && std::thread::hardware_concurrency() > 1;
+	if (overlap && !streamsMesh(config)) {
+		startup.meshWorker = std::thread([&config, &startup]() {
+			TRACE_THREAD_NAME("mesh");
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Renderer::buildMesh(shaderVariant(config), config.depth, findRenderStrategy(config.strategy.c_str())->indexed,
+				Renderer::BASE_A, Renderer::BASE_B, Renderer::BASE_C, startup.mesh);
+			startup.meshMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		});
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	//glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	startup.timer.mark("glfw init");
 
-	GLFWwindow* window = glfwCreateWindow(SCR_HT, SCR_WID, "Sierpinski's Triangle", NULL, NULL);
+	GLFWwindow* window = glfwCreateWindow(config.width, config.height, "Sierpinski's Triangle", NULL, NULL);
 	if (window == NULL) {
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	startup.timer.mark("window");
 
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+	// Overlapped, only the entry points the app calls are looked up
+	if (!(overlap ? loadGLCalls((GLADloadproc)glfwGetProcAddress) : gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))) {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	startup.timer.mark("gl loader");
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	installGLAccounting(config.glCalls, config.stateCache);
+
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	// Before anything is created, the replay has to create it too
+	if (!config.glTracePath.empty() && !startGLTrace(config.glTracePath.c_str(), width, height)) {
+		glfwTerminate();
+		return 1;
+	}
 
-	glViewport(0, 0, SCR_HT, SCR_WID);
-	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	// Off, a benchmark measures the frames and not the display's refresh rate
+	glfwSwapInterval(config.vsync ? 1 : 0);
 
-	// SHADERS
-	Shader ourShader("shader.vert", "shader.frag");
-
-	unsigned int VBO, VAO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	// bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-	glBindVertexArray(VAO);
+	glViewport(0, 0, width, height);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+	startup.timer.mark("extensions");
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	renderLoop(window, config, startup);
+	stopGLTrace();
+	// After renderLoop, so every thread pool has been joined
+	if (!config.tracePath.empty())
+		traceWrite(config.tracePath.c_str());
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+	glfwTerminate();
+	return 0;
+}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+void renderLoop(GLFWwindow * window, const AppConfig &config, Startup &startup)
+{
+	// Everything holding GL objects lives in here, so it is gone before glfwTerminate
+	unsigned int variant = shaderVariant(config);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// SHADERS
+	std::chrono::steady_clock::time_point shaderStart = std::chrono::steady_clock::now();
+	ShaderCache shaderCache("shader_cache");
+	ShaderLibrary shaders(&shaderCache);
+	Shader &ourShader = shaders.get(variant);
+	std::cout << "Shader startup: "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count() << " ms ("
+		<< (!shaderCache.enabled() ? "no program binary support" : ourShader.fromCache ? "warm cache" : "cold cache") << ")" << std::endl;
+	startup.timer.mark("shaders");
+	// Edit shader.vert/shader.frag (or sierpinski.frag) while running to see the changes live.
+	// Started after the first frame, it may create a context of its own.
+	const char* fragmentPath = variant & SHADER_ANALYTIC ? "sierpinski.frag" : "shader.frag";
+	ShaderReloader* reloader = NULL;
 
 	//uncomment this call to draw in wireframe polygons.
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	// Tell openGl which texture unit each sample belongs to
-	ourShader.use();
-
 	// render loop
 	// -----------
-	std::vector<float> vertices;
-	glm::vec2 pA(0.0f, 0.5f), pB(0.5f, -0.5f), pC(-0.5f, -0.5f); // Original Points For Triangle
-	drawTris(pA, pB, pC, 5, vertices); // Populatue vertices vector with sierpinskis algorith,
-	
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-	while (!glfwWindowShouldClose(window)) {
+	PerfCounters* counters = config.counters ? new PerfCounters() : NULL;
+	if (counters && !counters->anyAvailable())
+		std::cout << "ERROR::PERF::NO_COUNTERS (perf_event_open failed, see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+	PerfSample frameCounters;
+	const RendererMesh* mesh = NULL;
+	if (startup.meshWorker.joinable()) {
+		startup.meshWorker.join();
+		startup.timer.mark("wait for mesh");
+		mesh = &startup.mesh;
+	}
+	// Streamed, the renderer starts out empty and MeshStream fills it in
+	RendererMesh empty = RendererMesh();
+	bool streaming = streamsMesh(config);
+	Renderer renderer(shaders, variant, config.depth, findRenderStrategy(config.strategy.c_str())->indexed, counters, streaming ? &empty : mesh);
+	MeshStream* meshStream = streaming ? new MeshStream(renderer) : NULL;
+	// Its copy is in the buffers now
+	startup.mesh = RendererMesh();
+	startup.timer.mark(streaming ? "start streaming" : mesh ? "upload" : "generate and upload");
+	renderer.bind();
+	// UP/DOWN change the depth. Meshes are rebuilt in the background, created on the
+	// first key press with a hidden window sharing objects with ours to upload from.
+	MeshRegenerator* regenerator = NULL;
+	GLFWwindow* uploadWindow = NULL;
+	bool profiling = !config.profilePrefix.empty();
+	PngSequence* sequence = !config.capturePrefix.empty() ? new PngSequence(config.capturePrefix.c_str()) : NULL;
+	FrameCapture* capture = sequence ? new FrameCapture(sequence) : NULL;
+	// A benchmark takes its percentiles from the profiler, without the overlay or CSV
+	FrameProfiler* profiler = NULL;
+	if (profiling)
+		profiler = new FrameProfiler((config.profilePrefix + ".csv").c_str());
+	else if (config.benchmark)
+		profiler = new FrameProfiler();
+
+	// CPU time spent per frame, measured from input to draw submit (swap/vsync excluded)
+	std::chrono::steady_clock::duration cpuTime(0);
+	long long frames = 0;
+	std::chrono::steady_clock::time_point loopStart = std::chrono::steady_clock::now();
+	GLCallStats glCallsBefore = glCallStats();
+	while (!glfwWindowShouldClose(window) && (config.frames == 0 || frames < config.frames)) {
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		PerfScope frameScope(counters, frameCounters);
+		TRACE_SCOPE_ARG("frame", "frame", frames);
+		if (profiler)
+			profiler->beginFrame();
+
+		// SHADER HOT RELOAD //
+		if (reloader && reloader->update())
+			renderer.bind();
+
+		// MESH STREAMING //
+		if (meshStream && meshStream->poll(MeshStream::FRAME_BUDGET_MS)) {
+			std::cout << "Streamed the mesh in " << meshStream->chunkCount() << " chunks: generated in " << meshStream->generateMs()
+				<< " ms, all uploaded at " << meshStream->totalMs() << " ms (" << meshStream->uploadMs() << " ms of uploads)" << std::endl;
+			delete meshStream;
+			meshStream = NULL;
+		}
+
+		// DEPTH CHANGE //
+		if (regenerator && regenerator->poll()) {
+			renderer.bind();
+			std::cout << "Depth " << renderer.depth << " (built in " << regenerator->lastBuildMs() << " ms, "
+				<< regenerator->cancelled() << " builds abandoned so far)" << std::endl;
+		}
+
 		// INPUT //
-		processInput(window);
+		{
+			ProfileScope scope(profiler, PROFILE_INPUT);
+			TRACE_SCOPE("input");
+			int step = processInput(window);
+			if (step != 0 && (variant & SHADER_ANALYTIC)) {
+				// Nothing to build, the depth is a uniform
+				int depth = renderer.depth + step;
+				if (depth >= 0 && depth <= MAX_ANALYTIC_DEPTH) {
+					renderer.depth = depth;
+					renderer.bind();
+				}
+			}
+			else if (step != 0 && !meshStream) {
+				if (!regenerator) {
+					// A GL trace only records this thread, so the mesh is uploaded here while it runs
+					if (config.glTracePath.empty()) {
+						glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+						uploadWindow = glfwCreateWindow(1, 1, "", NULL, window);
+						glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+						if (uploadWindow == NULL)
+							std::cout << "ERROR::MESH_REGENERATOR::CONTEXT_CREATION_FAILED, uploading on the render thread" << std::endl;
+					}
+					// Made current on the worker, it must not be current anywhere else
+					regenerator = new MeshRegenerator(renderer, [uploadWindow](bool acquire) {
+						if (uploadWindow == NULL)
+							return false;
+						glfwMakeContextCurrent(acquire ? uploadWindow : NULL);
+						return true;
+					});
+				}
+				int depth = regenerator->requestedDepth() + step;
+				if (depth >= 0 && depth <= MAX_MESH_DEPTH)
+					regenerator->request(depth);
+			}
+		}
 
 		// RENDERING //
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		ourShader.use();
-		float time = (float)glfwGetTime();
-		float h = (sin(time) / 2.0f) + 0.5f;
-		h = 360.0f * h;
-		ColorVec3 color = getHSVColor(h, 1.0f, 1.0f); // Generate from degree with HSV
-		glUniform3f(glGetUniformLocation(ourShader.ID, "colorOver"), color.r, color.g, color.b);
-		glm::mat4 trans = glm::mat4(1.0f);
-		trans = glm::rotate(trans, time, glm::vec3(0.0, 1.0, 0.0));
-		glUniformMatrix4fv(glGetUniformLocation(ourShader.ID, "transform"), 1, GL_FALSE, glm::value_ptr(trans));
-
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+		{
+			ProfileScope scope(profiler, PROFILE_GPU_CLEAR);
+			renderer.clear();
+		}
+		{
+			ProfileScope scope(profiler, PROFILE_UNIFORMS);
+			// A fixed timestep draws the same frames however fast they are drawn
+			renderer.setUniforms(config.timeStep > 0.0f ? frames * config.timeStep : (float)glfwGetTime());
+		}
+		{
+			ProfileScope cpu(profiler, PROFILE_SUBMIT);
+			ProfileScope gpu(profiler, PROFILE_GPU_DRAW);
+			renderer.submit();
+		}
+		if (capture) {
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			capture->capture(width, height);
+		}
+		cpuTime += std::chrono::steady_clock::now() - frameStart;
+		frames++;
+		if (profiling) {
+			// After the capture, so recordings stay clean
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			profiler->drawOverlay(width, height);
+			if (frames % 30 == 0)
+				glfwSetWindowTitle(window, ("Sierpinski's Triangle  " + profiler->summary()).c_str());
+		}
 
 		// CHECK/CALL EVENTS AND BUFFER SWAP //
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		{
+			ProfileScope scope(profiler, PROFILE_SWAP);
+			TRACE_SCOPE("swap");
+			glfwSwapBuffers(window);
+		}
+		glTraceFrame();
+		{
+			TRACE_SCOPE("poll events");
+			glfwPollEvents();
+		}
+		if (profiler)
+			profiler->endFrame();
+		if (frames == 1) {
+			startup.timer.mark("first frame");
+			std::cout << startup.timer.report();
+			if (mesh)
+				std::cout << " (mesh built in " << startup.meshMs << " ms on a worker)";
+			std::cout << std::endl;
+			// A GL trace only records this thread, so reloads are built here while it runs
+			GLFWwindow* shareWith = config.glTracePath.empty() ? window : NULL;
+			reloader = new ShaderReloader(ourShader, "shader.vert", fragmentPath, shareWith, ShaderLibrary::defines(variant));
+		}
 	}
 
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loopStart).count();
 
-
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-
-	glfwTerminate();
-	return 0;
-}
-
-void drawTri(glm::vec2 A, glm::vec2 B, glm::vec2 C, std::vector<float> &vertex_arr)
-{
-	//std::cout << A.x << " " << A.y << std::endl;
-	//std::cout << B.x << " " << B.y << std::endl;
-	//std::cout << C.x << " " << C.y << std::endl;
-	float tri[] = {
-		// positions    
-		 A.x, A.y, 0.0f, 1.f, 0.5f, 0.0f,
-		 B.x, B.y, 0.0f, 1.f, 0.5f, 0.0f,
-		 C.x, C.y, 0.0f, 1.f, 0.5f, 0.0f,
-	};
-	for (int i = 0; i < 18; i++) {
-		vertex_arr.push_back(tri[i]);
+	if (config.glCalls)
+		std::cout << formatGLCalls(glCallStats().since(glCallsBefore), frames) << std::endl;
+	if (frames > 0) {
+		double us = std::chrono::duration<double, std::micro>(cpuTime).count() / frames;
+		std::cout << "CPU time per frame (" << (config.gpuAnim ? "gpu" : "cpu") << " animation): "
+			<< us << " us over " << frames << " frames" << std::endl;
 	}
-
-}
-
-void drawTris(glm::vec2 A, glm::vec2 B, glm::vec2 C, int n, std::vector<float> &vertices) {
-	// Sierpinski's Algorithm
-	drawTri(mid(A, B) , mid(B, C), mid(A, C), vertices);
-	if (n > 0) {
-		drawTris(A, mid(A, B), mid(A, C), n - 1, vertices);
-		drawTris(B, mid(A, B), mid(B, C), n - 1, vertices);
-		drawTris(C, mid(A, C), mid(B, C), n - 1, vertices);
+	if (capture) {
+		capture->finish();
+		std::cout << "Captured " << capture->framesCaptured << " frames, " << capture->stalls << " capture stalls, "
+			<< capture->failures() << " failed" << std::endl;
+		delete capture;
+		delete sequence;
+	}
+	if (profiler)
+		profiler->finish();
+	if (profiling) {
+		std::string jsonPath = config.profilePrefix + ".json";
+		std::cout << "Profiled " << profiler->frames << " frames, frame p50/p95/p99 "
+			<< profiler->histograms[PROFILE_FRAME].percentile(0.5) << "/" << profiler->histograms[PROFILE_FRAME].percentile(0.95) << "/"
+			<< profiler->histograms[PROFILE_FRAME].percentile(0.99) << " ms, " << profiler->gpuDropped << " GPU samples dropped" << std::endl;
+		if (profiler->writeJSON(jsonPath.c_str()))
+			std::cout << "Wrote " << jsonPath << " and " << config.profilePrefix << ".csv" << std::endl;
+	}
+	if (config.benchmark && frames > 0) {
+		const TimingHistogram &frame = profiler->histograms[PROFILE_FRAME];
+		double fps = frames / wallSeconds;
+		double trianglesPerSecond = (double)triangleCount(config.depth) * fps;
+		std::cout << "Benchmark " << config.strategy << " depth " << config.depth << " " << config.width << "x" << config.height
+			<< ": " << frames << " frames in " << wallSeconds << " s, " << fps << " fps, " << trianglesPerSecond << " triangles/s, frame p50/p95/p99 "
+			<< frame.percentile(0.5) << "/" << frame.percentile(0.95) << "/" << frame.percentile(0.99) << " ms" << std::endl;
+		std::ostringstream header;
+		header << "  \"strategy\": \"" << config.strategy << "\",\n"
+			<< "  \"depth\": " << config.depth << ",\n"
+			<< "  \"width\": " << config.width << ",\n"
+			<< "  \"height\": " << config.height << ",\n"
+			<< "  \"anim\": \"" << (config.gpuAnim ? "gpu" : "cpu") << "\",\n"
+			<< "  \"vsync\": " << (config.vsync ? "true" : "false") << ",\n"
+			<< "  \"timestep\": " << config.timeStep << ",\n"
+			<< "  \"wall_s\": " << wallSeconds << ",\n"
+			<< "  \"fps\": " << fps << ",\n"
+			<< "  \"triangles_per_s\": " << trianglesPerSecond << ",\n";
+		if (profiler->writeJSON(config.benchmarkPath.c_str(), header.str()))
+			std::cout << "Wrote " << config.benchmarkPath << std::endl;
+	}
+	delete profiler;
+	if (counters) {
+		double triangles = (double)triangleCount(config.depth);
+		std::cout << formatPerf("generation", renderer.generationCounters, triangles) << std::endl
+			<< formatPerf("upload", renderer.uploadCounters, triangles) << std::endl
+			<< formatPerf("frames", frameCounters, triangles * frames) << std::endl;
+		delete counters;
 	}
-}
-
-glm::vec2 mid(glm::vec2 A, glm::vec2 B)
-{
-	float x = (A.x + B.x) / 2;
-	float y = (A.y + B.y) / 2;
-	return glm::vec2(x, y);
-}
 
-ColorVec3 getHSVColor(float h, float s, float v) {
-	// h [0, 360] s/v [0.0. 1.0];
-	int i = (int)floor(h / 60.0f) % 6;
-	float f = h / 60.0f - floor(h / 60.0f);
-	float p = v * (float)(1 - s);
-	float q = v * (float)(1 - s * f);
-	float t = v * (float)(1 - (1 - f) * s);
-	ColorVec3 color(0.0f, 0.0f, 0.0f);
-	switch (i) {
-		case 0: color = ColorVec3(v, t, p);
-			break;
-		case 1: color = ColorVec3(q, v, p);
-			break;
-		case 2: color = ColorVec3(p, v, t);
-			break;
-		case 3: color = ColorVec3(p, q, v);
-			break;
-		case 4: color = ColorVec3(t, p, v);
-			break;
-		case 5: color = ColorVec3(v, p, q);
-			break;
-		default: color = ColorVec3(0.f, 0.f, 0.f);
-	}
-	return color;
+	delete reloader;
+	delete meshStream;
+	delete regenerator;
+	if (uploadWindow)
+		glfwDestroyWindow(uploadWindow);
 }
 
 void framebuffer_size_callback(GLFWwindow * window, int width, int height)
@@ -189,8 +498,20 @@ void framebuffer_size_callback(GLFWwindow * window, int width, int height)
 	glViewport(0, 0, width, height);
 }
 
-void processInput(GLFWwindow * window)
+// Returns +1 when UP was just pressed, -1 for DOWN
+int processInput(GLFWwindow * window)
 {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
+
+	static int lastUp = GLFW_RELEASE, lastDown = GLFW_RELEASE;
+	int up = glfwGetKey(window, GLFW_KEY_UP), down = glfwGetKey(window, GLFW_KEY_DOWN);
+	int step = 0;
+	if (up == GLFW_PRESS && lastUp != GLFW_PRESS)
+		step++;
+	if (down == GLFW_PRESS && lastDown != GLFW_PRESS)
+		step--;
+	lastUp = up;
+	lastDown = down;
+	return step;
 }
@@ -1,11 +1,33 @@
 #version 330 core
+// Permutations: exactly one of COLOR_UNIFORM (colorOver), COLOR_HUE (the hue a
+// GPU_ANIM vertex stage cycles from time) or COLOR_VERTEX (the vertex stage's colour),
+// plus SEPARABLE as in shader.vert.
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+#define VARYING(n) layout (location = n)
+#else
+#define VARYING(n)
+#endif
+
+#include "common.glsl"
+
 out vec4 FragColor;
 
-in vec3 ourColor;
+VARYING(0) flat in vec3 ourColor;
 
+#if defined(COLOR_UNIFORM)
 uniform vec3 colorOver;
+#elif defined(COLOR_HUE)
+VARYING(2) flat in vec3 ourHue;
+#endif
 
 void main()
 {
+#if defined(COLOR_UNIFORM)
     FragColor = vec4(colorOver, 1.0f);
+#elif defined(COLOR_HUE)
+    FragColor = vec4(ourHue, 1.0f);
+#else
+    FragColor = vec4(ourColor, 1.0f);
+#endif
 }
\ No newline at end of file
@@ -1,13 +1,83 @@
 #version 330 core
+// Permutations, defined by ShaderLibrary right after the #version line:
+//   exactly one of STREAM_POS_COLOR, STREAM_POS2, STREAM_VERTEX_ID, STREAM_INSTANCED
+//   picks the vertex source, or ANALYTIC draws just the base triangle for sierpinski.frag,
+//   GPU_ANIM derives the spin from time instead of transform, and the hue COLOR_HUE
+//   fragment stages use,
+//   SEPARABLE builds the stage for a program pipeline.
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+out gl_PerVertex { vec4 gl_Position; };
+#define VARYING(n) layout (location = n)
+#else
+#define VARYING(n)
+#endif
+
+#include "common.glsl"
+
+#if defined(STREAM_POS_COLOR)
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+#elif defined(STREAM_POS2)
+layout (location = 0) in vec2 aPos;
+#elif defined(STREAM_INSTANCED)
+layout (location = 0) in vec3 aInstance; // xy offset, z scale of the base triangle
+#endif
+
+VARYING(0) flat out vec3 ourColor;
+#ifdef GPU_ANIM
+// Once per vertex rather than per fragment, it is the same for the whole draw
+VARYING(2) flat out vec3 ourHue;
+#endif
+#ifdef ANALYTIC
+VARYING(1) out vec2 basisPos;
 
-out vec3 ourColor;
+// How much the base triangle is grown about its centre to leave room for the
+// antialiased edges
+const float ANALYTIC_MARGIN = 1.05;
+#endif
 
+#ifdef GPU_ANIM
+uniform float time;
+#else
 uniform mat4 transform;
+#endif
+
+#if defined(STREAM_VERTEX_ID) || defined(STREAM_INSTANCED) || defined(ANALYTIC)
+// Base triangle
+uniform vec2 pA;
+uniform vec2 pB;
+uniform vec2 pC;
+#endif
 
 void main()
 {
-    gl_Position = transform * vec4(aPos, 1.0); 
+#if defined(ANALYTIC)
+    vec2 corner = gl_VertexID == 0 ? vec2(0.0, 0.0) : gl_VertexID == 1 ? vec2(1.0, 0.0) : vec2(0.0, 1.0);
+    basisPos = (corner - 1.0 / 3.0) * ANALYTIC_MARGIN + 1.0 / 3.0;
+    vec4 position = vec4(pA + basisPos.x * (pB - pA) + basisPos.y * (pC - pA), 0.0, 1.0);
+#elif defined(STREAM_VERTEX_ID)
+    vec4 position = vec4(sierpinskiVertex(gl_VertexID, pA, pB, pC), 0.0, 1.0);
+#elif defined(STREAM_INSTANCED)
+    // Every drawn triangle is the base's midpoint triangle, scaled and moved
+    vec2 corner = gl_VertexID == 0 ? (pA + pB) * 0.5 : gl_VertexID == 1 ? (pB + pC) * 0.5 : (pA + pC) * 0.5;
+    vec4 position = vec4(corner * aInstance.z + aInstance.xy, 0.0, 1.0);
+#elif defined(STREAM_POS2)
+    vec4 position = vec4(aPos, 0.0, 1.0);
+#else
+    vec4 position = vec4(aPos, 1.0);
+#endif
+
+#ifdef GPU_ANIM
+    gl_Position = spinY(time) * position;
+    ourHue = hueColor(360.0 * (sin(time) / 2.0 + 0.5));
+#else
+    gl_Position = transform * position;
+#endif
+
+#ifdef STREAM_POS_COLOR
     ourColor = aColor;
+#else
+    ourColor = vec3(1.0, 0.5, 0.0); // what drawTri() writes into every vertex
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#version 330 core
+// Analytic counterpart of shader.frag for SHADER_ANALYTIC: the vertex stage draws only
+// the base triangle and every fragment works out whether it is in one of the middle
+// triangles drawTris() would generate, by running the recursion backwards from its
+// position in the base's basis (origin pA, axes pB - pA and pC - pA). Cost is per
+// pixel and per level, and the loop stops once a level is smaller than a pixel, so
+// any depth costs about the same. Edges get coverage from the distance to them in
+// pixels, written as alpha for blending over the clear colour.
+// Permutations: the colour modes of shader.frag, plus SEPARABLE.
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+#define VARYING(n) layout (location = n)
+#else
+#define VARYING(n)
+#endif
+
+#include "common.glsl"
+
+out vec4 FragColor;
+
+VARYING(0) flat in vec3 ourColor;
+VARYING(1) in vec2 basisPos;
+
+uniform int depth;
+
+#if defined(COLOR_UNIFORM)
+uniform vec3 colorOver;
+#elif defined(COLOR_HUE)
+VARYING(2) flat in vec3 ourHue;
+#endif
+
+// Signed distance in pixels from p to the middle triangle of the unit triangle
+// (0, 0), (1, 0), (0, 1), positive inside. g holds how much s, t and s + t change
+// per pixel.
+float middleDistance(vec2 p, vec3 g)
+{
+    return min(min((0.5 - p.x) / g.x, (0.5 - p.y) / g.y), (p.x + p.y - 0.5) / g.z);
+}
+
+float coverage()
+{
+    vec2 ds = vec2(dFdx(basisPos.x), dFdy(basisPos.x));
+    vec2 dt = vec2(dFdx(basisPos.y), dFdy(basisPos.y));
+    vec3 g = max(vec3(length(ds), length(dt), length(ds + dt)), vec3(1e-8));
+
+    // The primitive is a little bigger than the base triangle so its edges can fade out
+    vec2 p = basisPos;
+    float base = clamp(min(min(p.x / g.x, p.y / g.y), (1.0 - p.x - p.y) / g.z) + 0.5, 0.0, 1.0);
+    if (base <= 0.0)
+        return 0.0;
+
+    float covered = 0.0;
+    for (int level = 0; level <= depth; level++) {
+        // Under a pixel per sub-triangle the remaining levels fill this fraction of it
+        if (max(g.x, max(g.y, g.z)) > 1.0) {
+            covered = max(covered, 1.0 - pow(0.75, float(depth - level + 1)));
+            break;
+        }
+        covered = max(covered, clamp(middleDistance(p, g) + 0.5, 0.0, 1.0));
+        if (covered >= 1.0)
+            break;
+        // Into the corner sub-triangle holding p, undoing the halving drawTris() recurses with
+        if (p.x > 0.5)
+            p = vec2(2.0 * p.x - 1.0, 2.0 * p.y);
+        else if (p.y > 0.5)
+            p = vec2(2.0 * p.x, 2.0 * p.y - 1.0);
+        else
+            p *= 2.0;
+        g *= 2.0;
+    }
+    return min(covered, base);
+}
+
+void main()
+{
+#if defined(COLOR_UNIFORM)
+    vec3 color = colorOver;
+#elif defined(COLOR_HUE)
+    vec3 color = ourHue;
+#else
+    vec3 color = ourColor;
+#endif
+    FragColor = vec4(color, coverage());
+}
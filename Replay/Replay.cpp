@@ -0,0 +1,21 @@
+// Replays a GL trace recorded with Sierpinski --gltrace on the headless EGL context,
+// as fast as the driver goes, and prints setup time and frame time percentiles
+// (GLTrace.h). Built by the CMakeLists.txt at the top of the repo:
+//
+//   build/sierpinski_replay frames.gltrace
+//
+// The same trace replayed under two Mesa builds, e.g. with LD_LIBRARY_PATH pointing
+// at each, times both drivers on exactly the same commands.
+
+#include <iostream>
+
+#include "GLTrace.h"
+
+int main(int argc, char** argv)
+{
+	if (argc != 2) {
+		std::cout << "usage: sierpinski_replay TRACE" << std::endl;
+		return 1;
+	}
+	return runGLReplay(argv[1]);
+}